@@ -0,0 +1,351 @@
+#include "asset_loader.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "aixlog.hpp"
+#include "hash.h"
+#include "mapped_file.h"
+#include "mip_generator.h"
+#include "stb_image.h"
+#include "texture_file.h"
+
+void AssetLoader::create(uint32_t threadCount) {
+	if (!m_workers.empty()) return;
+
+	if (threadCount == 0) {
+		// leave one core to the GL thread
+		threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	}
+
+	m_quit = false;
+	for (uint32_t i = 0; i < threadCount; i++) {
+		m_workers.emplace_back(&AssetLoader::workerLoop, this);
+	}
+
+	m_pixelRing.create();
+	s3tcSupported(); // the workers pick compressed formats by it
+}
+
+void AssetLoader::destroy() {
+	stopWorkers();
+	if (m_pixelRing.valid()) m_pixelRing.destroy();
+}
+
+void AssetLoader::stopWorkers() {
+	{
+		std::lock_guard<std::mutex> lock{ m_jobMutex };
+		m_quit = true;
+		m_jobs.clear();
+	}
+	m_jobSignal.notify_all();
+
+	for (auto& t : m_workers) t.join();
+	m_workers.clear();
+
+	std::lock_guard<std::mutex> lock{ m_uploadMutex };
+	m_uploads.clear();
+	m_pending = 0; // the dropped jobs will never finish
+}
+
+AssetHandle<Mesh> AssetLoader::loadMesh(const std::string& fileName, uint32_t flags, VertexFormat format) {
+	return queueMesh(&Mesh::loadData, fileName, flags, format);
+}
+
+AssetHandle<Mesh> AssetLoader::importMesh(const std::string& fileName, uint32_t flags, VertexFormat format) {
+	return queueMesh(&Mesh::importData, fileName, flags, format);
+}
+
+AssetHandle<Mesh> AssetLoader::queueMesh(
+	bool (*loader)(const std::string&, MeshData&, uint32_t),
+	const std::string& fileName, uint32_t flags, VertexFormat format
+) {
+	auto handle = std::make_shared<Asset<Mesh>>();
+	m_pending++;
+
+	enqueue([this, handle, loader, fileName, flags, format]() {
+		auto data = std::make_shared<MeshData>();
+		if (!loader(fileName, *data, flags)) {
+			handle->finish(AssetState::Failed);
+			m_pending--;
+			return;
+		}
+		handle->m_contentHash = data->sourceHash;
+
+		enqueueUpload([this, handle, data, format]() {
+			handle->m_value.create(std::move(*data), format);
+			handle->finish(AssetState::Ready);
+			m_pending--;
+			return true;
+		});
+	});
+	return handle;
+}
+
+static bool decodeImage(const std::string& fileName, const MappedFile& src, TextureUsage usage, uint32_t flags, ImageData& out) {
+	int w, h, comp;
+	stbi_uc* pixels = stbi_load_from_memory(
+		reinterpret_cast<const stbi_uc*>(src.data()), int(src.size()),
+		&w, &h, &comp, 4
+	);
+	if (!pixels) {
+		LOG(ERROR) << "Failed to load " << fileName << ": " << stbi_failure_reason() << "\n";
+		return false;
+	}
+
+	out.format = TextureFormat::RGBA;
+	if (flags & TextureMipmaps) {
+		// colour maps are stored in sRGB, the rest is data
+		bool srgb = usage == TextureUsage::Diffuse || usage == TextureUsage::Emission;
+		MipFilter filter = (flags & TextureBoxMips) ? MipFilter::Box : MipFilter::Kaiser;
+		// already on a loader worker, so filter on this thread only
+		for (auto& level : generateMipChain(pixels, w, h, filter, srgb, out.pixels, 1)) {
+			PixelRegion r{};
+			r.offset = level.offset;
+			r.width = level.width;
+			r.height = level.height;
+			r.level = uint32_t(out.levels.size());
+			out.levels.push_back(r);
+		}
+	} else {
+		PixelRegion r{};
+		r.width = uint32_t(w);
+		r.height = uint32_t(h);
+		out.levels.push_back(r);
+		out.pixels.assign(pixels, pixels + size_t(w) * h * 4);
+	}
+	stbi_image_free(pixels);
+	return true;
+}
+
+// Replaces the RGBA8 levels with their block compressed version.
+static void compressLevels(TextureUsage usage, uint32_t flags, ImageData& image) {
+	const PixelRegion& base = image.levels[0];
+	bool alpha = hasAlpha(image.pixels.data(), base.width, base.height);
+	TextureFormat format = compressedFormatFor(usage, alpha, (flags & TextureHighQuality) != 0);
+	if (!isCompressed(format)) return;
+
+	std::vector<PixelRegion> levels = image.levels;
+	size_t total = 0;
+	for (auto& r : levels) {
+		r.offset = total;
+		r.format = format;
+		total += compressedSize(format, r.width, r.height);
+	}
+
+	std::vector<uint8_t> blocks(total);
+	for (size_t i = 0; i < levels.size(); i++) {
+		const PixelRegion& src = image.levels[i];
+		compressImage(image.pixels.data() + src.offset, src.width, src.height, format, blocks.data() + levels[i].offset, 1);
+	}
+
+	image.format = format;
+	image.pixels = std::move(blocks);
+	image.levels = std::move(levels);
+}
+
+static bool readTextureFile(const std::string& cacheName, uint64_t hash, uint32_t key, ImageData& out) {
+	TextureFile file;
+	if (!file.open(cacheName, hash, key)) return false;
+	if (!textureFormatSupported(file.format())) return false;
+
+	// each level has to be exactly as large as the upload will read
+	for (size_t i = 0; i < file.levelCount(); i++) {
+		if (i >= 32) return false;
+		const TextureFileLevel& level = file.levels()[i];
+		uint32_t w = std::max(file.width() >> i, 1u), h = std::max(file.height() >> i, 1u);
+		size_t expected = isCompressed(file.format()) ? compressedSize(file.format(), w, h) : size_t(w) * h * 4;
+		if (level.width != w || level.height != h || level.size != expected) return false;
+	}
+
+	out.format = file.format();
+	out.pixels.assign(file.data(), file.data() + file.dataSize());
+	for (size_t i = 0; i < file.levelCount(); i++) {
+		const TextureFileLevel& level = file.levels()[i];
+		PixelRegion r{};
+		r.offset = size_t(level.offset);
+		r.format = out.format;
+		r.width = level.width;
+		r.height = level.height;
+		r.level = uint32_t(i);
+		out.levels.push_back(r);
+	}
+	return true;
+}
+
+static void writeTextureFile(const std::string& cacheName, uint64_t hash, uint32_t key, const ImageData& image) {
+	std::vector<TextureFileLevel> levels;
+	for (size_t i = 0; i < image.levels.size(); i++) {
+		const PixelRegion& r = image.levels[i];
+		levels.push_back(TextureFileLevel{ r.offset, image.levelSize(i), r.width, r.height });
+	}
+	const PixelRegion& base = image.levels[0];
+	TextureFile::write(
+		cacheName, hash, key, image.format, base.width, base.height,
+		levels.data(), levels.size(), image.pixels.data(), image.pixels.size()
+	);
+}
+
+static bool loadImage(const std::string& fileName, TextureUsage usage, uint32_t flags, ImageData& out, uint64_t& hash) {
+	MappedFile src;
+	if (!src.open(fileName)) {
+		LOG(ERROR) << "Failed to open " << fileName << "\n";
+		return false;
+	}
+
+	hash = hashBytes(src.data(), src.size());
+	uint32_t key = flags | (uint32_t(usage) << 16);
+	std::string cacheName = fileName + ".rtex";
+	if ((flags & TextureUseCache) && readTextureFile(cacheName, hash, key, out)) return true;
+
+	if (!decodeImage(fileName, src, usage, flags, out)) return false;
+	if (flags & TextureCompress) compressLevels(usage, flags, out);
+	if (flags & TextureUseCache) writeTextureFile(cacheName, hash, key, out);
+	return true;
+}
+
+static void finishTexture(Texture& tex, uint32_t levels) {
+	tex.setWrap(TextureWrap::Repeat, TextureWrap::Repeat);
+	if (levels > 1) tex.setFilter(TextureFilter::LinearMipLinear, TextureFilter::Linear);
+	else tex.setFilter(TextureFilter::Linear, TextureFilter::Linear);
+}
+
+AssetHandle<Texture> AssetLoader::loadTexture(const std::string& fileName, TextureUsage usage, uint32_t flags) {
+	auto handle = std::make_shared<Asset<Texture>>();
+	m_pending++;
+
+	enqueue([this, handle, fileName, usage, flags]() {
+		auto image = std::make_shared<ImageData>();
+		if (!loadImage(fileName, usage, flags, *image, handle->m_contentHash)) {
+			handle->finish(AssetState::Failed);
+			m_pending--;
+			return;
+		}
+
+		if ((flags & TextureStreamed) && m_streamer) {
+			enqueueUpload([this, handle, image]() {
+				Texture& tex = handle->m_value;
+				m_streamer->add(tex, image);
+				finishTexture(tex, uint32_t(image->levels.size()));
+
+				handle->finish(AssetState::Ready);
+				m_pending--;
+				return true;
+			});
+			return;
+		}
+
+		if (!m_usePixelRing || !m_pixelRing.valid()) {
+			enqueueUpload([this, handle, image]() {
+				Texture& tex = handle->m_value;
+				const PixelRegion& base = image->levels[0];
+				tex.create(TextureTarget::Texture2D);
+				tex.bind();
+				tex.allocate(image->format, base.width, base.height, uint32_t(image->levels.size()));
+				for (auto& r : image->levels) {
+					tex.updateRegion(r.format, image->pixels.data() + r.offset, r.x, r.y, r.width, r.height, r.level);
+				}
+				finishTexture(tex, uint32_t(image->levels.size()));
+
+				m_stats.textureBytes += image->pixels.size();
+				handle->finish(AssetState::Ready);
+				m_pending--;
+				return true;
+			});
+			return;
+		}
+
+		// map a ring slot on the GL thread, fill it here, upload on the GL thread again
+		enqueueUpload([this, handle, image]() {
+			auto staging = std::make_shared<PixelStaging>(m_pixelRing.acquire(image->pixels.size()));
+			if (!staging->valid()) return false;
+
+			enqueue([this, handle, image, staging]() {
+				std::copy(image->pixels.begin(), image->pixels.end(), staging->data);
+
+				enqueueUpload([this, handle, image, staging]() {
+					Texture& tex = handle->m_value;
+					const PixelRegion& base = image->levels[0];
+					tex.create(TextureTarget::Texture2D);
+					tex.bind();
+					tex.allocate(image->format, base.width, base.height, uint32_t(image->levels.size()));
+					m_pixelRing.upload(*staging, image->levels.data(), image->levels.size(), tex);
+					finishTexture(tex, uint32_t(image->levels.size()));
+
+					m_stats.textureBytes += image->pixels.size();
+					handle->finish(AssetState::Ready);
+					m_pending--;
+					return true;
+				});
+			});
+			return true;
+		});
+	});
+	return handle;
+}
+
+size_t AssetLoader::processUploads(double budgetMs) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	size_t count = 0;
+	while (true) {
+		std::function<bool()> upload;
+		{
+			std::lock_guard<std::mutex> lock{ m_uploadMutex };
+			if (m_uploads.empty()) break;
+			upload = std::move(m_uploads.front());
+			m_uploads.pop_front();
+		}
+
+		if (!upload()) {
+			// out of staging memory, try again next frame
+			std::lock_guard<std::mutex> lock{ m_uploadMutex };
+			m_uploads.push_back(std::move(upload));
+			break;
+		}
+		count++;
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (elapsed.count() >= budgetMs) break;
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_stats.uploads += uint32_t(count);
+	m_stats.uploadMs += elapsed.count();
+	m_stats.maxFrameMs = std::max(m_stats.maxFrameMs, elapsed.count());
+	return count;
+}
+
+void AssetLoader::enqueue(std::function<void()> job) {
+	if (m_workers.empty()) {
+		// no pool, load in place
+		job();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ m_jobMutex };
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobSignal.notify_one();
+}
+
+void AssetLoader::enqueueUpload(std::function<bool()> upload) {
+	std::lock_guard<std::mutex> lock{ m_uploadMutex };
+	m_uploads.push_back(std::move(upload));
+}
+
+void AssetLoader::workerLoop() {
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock{ m_jobMutex };
+			m_jobSignal.wait(lock, [this]() { return m_quit || !m_jobs.empty(); });
+			if (m_quit) return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		job();
+	}
+}
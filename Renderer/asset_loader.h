@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mesh.h"
+#include "texture.h"
+#include "texture_compressor.h"
+#include "pixel_upload_ring.h"
+#include "texture_streamer.h"
+
+enum class AssetState {
+	Pending = 0,
+	Ready,
+	Failed
+};
+
+// Shared between the caller, the workers and the GL thread. The value can
+// only be used once the state is Ready.
+template <typename T>
+class Asset {
+	friend class AssetLoader;
+	friend class ResourceManager;
+public:
+	AssetState state() const { return m_state.load(std::memory_order_acquire); }
+	bool ready() const { return state() == AssetState::Ready; }
+	bool failed() const { return state() == AssetState::Failed; }
+
+	T& get() { return m_value; }
+	T* operator->() { return &m_value; }
+
+	// Hash of the source bytes, set before the asset finishes. 0 when unknown.
+	uint64_t contentHash() const { return m_contentHash; }
+
+private:
+	T m_value{};
+	std::atomic<AssetState> m_state{ AssetState::Pending };
+	uint64_t m_contentHash{ 0 };
+
+	void finish(AssetState state) { m_state.store(state, std::memory_order_release); }
+};
+
+template <typename T>
+using AssetHandle = std::shared_ptr<Asset<T>>;
+
+struct AssetUploadStats {
+	uint32_t uploads{ 0 };
+	uint64_t textureBytes{ 0 };
+	double uploadMs{ 0.0 }; // GL thread time in processUploads
+	double maxFrameMs{ 0.0 }; // worst single processUploads call
+};
+
+// File I/O, parsing and decoding run on a pool of worker threads, GL objects
+// are created on the GL thread by processUploads.
+class AssetLoader {
+public:
+	AssetLoader() = default;
+	~AssetLoader() { stopWorkers(); }
+
+	// GL thread, the pixel upload ring is created here.
+	void create(uint32_t threadCount = 0); // 0 = hardware concurrency - 1
+	void destroy();
+
+	// Textures go through the PBO ring by default, otherwise straight from client memory.
+	void setUsePixelRing(bool use) { m_usePixelRing = use; }
+
+	// Receives the textures loaded with TextureStreamed, which start with only their tail resident.
+	void setTextureStreamer(TextureStreamer* streamer) { m_streamer = streamer; }
+	TextureStreamer* textureStreamer() const { return m_streamer; }
+
+	AssetHandle<Mesh> loadMesh(const std::string& fileName, uint32_t flags = MeshDefaultFlags, VertexFormat format = VertexFormat::Full);
+	AssetHandle<Mesh> importMesh(const std::string& fileName, uint32_t flags = MeshDefaultFlags, VertexFormat format = VertexFormat::Full);
+	AssetHandle<Texture> loadTexture(const std::string& fileName, TextureUsage usage = TextureUsage::Diffuse, uint32_t flags = TextureDefaultFlags);
+
+	// GL thread only. Runs queued uploads until budgetMs is spent, at least one
+	// per call so that a large asset cannot stall the queue. Returns how many ran.
+	size_t processUploads(double budgetMs = 2.0);
+
+	// Assets requested but not uploaded yet.
+	size_t pendingCount() const { return m_pending.load(); }
+
+	const AssetUploadStats& stats() const { return m_stats; }
+	const PixelUploadStats& pixelStats() const { return m_pixelRing.stats(); }
+	void resetStats() { m_stats = AssetUploadStats{}; m_pixelRing.resetStats(); }
+
+private:
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()>> m_jobs;
+	std::mutex m_jobMutex;
+	std::condition_variable m_jobSignal;
+	bool m_quit{ false };
+
+	// an upload returning false could not run yet and is retried next call
+	std::deque<std::function<bool()>> m_uploads;
+	std::mutex m_uploadMutex;
+
+	std::atomic<size_t> m_pending{ 0 };
+
+	PixelUploadRing m_pixelRing{};
+	bool m_usePixelRing{ true };
+	TextureStreamer* m_streamer{ nullptr };
+	AssetUploadStats m_stats{};
+
+	AssetHandle<Mesh> queueMesh(
+		bool (*loader)(const std::string&, MeshData&, uint32_t),
+		const std::string& fileName, uint32_t flags, VertexFormat format
+	);
+
+	void stopWorkers();
+	void enqueue(std::function<void()> job);
+	void enqueueUpload(std::function<bool()> upload);
+	void workerLoop();
+};
@@ -3,6 +3,7 @@
 #include <cstdint>
 
 #include "glad.h"
+#include "gl_state.h"
 #include "linalg.h"
 #include "data_type.h"
 
@@ -12,7 +13,8 @@ enum class BufferType {
 	ArrayBuffer = GL_ARRAY_BUFFER,
 	ElementBuffer = GL_ELEMENT_ARRAY_BUFFER,
 	UniformBuffer = GL_UNIFORM_BUFFER,
-	ShaderStorageBuffer = GL_SHADER_STORAGE_BUFFER
+	ShaderStorageBuffer = GL_SHADER_STORAGE_BUFFER,
+	PixelUnpackBuffer = GL_PIXEL_UNPACK_BUFFER
 };
 
 enum class BufferUsage {
@@ -34,7 +36,8 @@ public:
 
 	void create(BufferType type, BufferUsage usage, size_t initialSize = 0);
 
-	void setLayout(BufferLayoutEntry* layout, size_t layoutSize, size_t stride, size_t indexStart = 0);
+	// offset is where the first element starts in the buffer, in bytes.
+	void setLayout(BufferLayoutEntry* layout, size_t layoutSize, size_t stride, size_t indexStart = 0, size_t offset = 0);
 
 	template <typename V>
 	void update(V* data, size_t n, size_t offset = 0) {
@@ -42,7 +45,8 @@ public:
 		size_t off = offset * sizeof(V);
 
 		bind();
-		if (sz > m_prevSize) {
+		if (sz > m_prevSize || (off == 0 && sz == m_prevSize)) {
+			// new storage when all of it is replaced, instead of waiting for the GPU to let go of the old
 			m_prevSize = sz;
 			glBufferData((GLenum)m_type, sz, data, (GLenum)m_usage);
 		} else {
@@ -50,17 +54,37 @@ public:
 		}
 	}
 
+	// For writing, the range's previous contents are discarded.
 	template <typename T>
 	T* map(size_t offset = 0, size_t length = 0) {
 		length = length == 0 ? sizeof(T) : length;
 		bind();
-		return (T*)glMapBufferRange((GLenum)m_type, offset, length, GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+		return (T*)glMapBufferRange((GLenum)m_type, offset, length, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	}
+	void* mapRange(size_t offset, size_t length, GLbitfield access) {
+		bind();
+		return glMapBufferRange((GLenum)m_type, offset, length, access);
 	}
 	void unmap() { glUnmapBuffer((GLenum)m_type); }
-	void bind() { glBindBuffer((GLenum)m_type, m_object); }
-	void unbind() { glBindBuffer((GLenum)m_type, 0); }
 
-	void destroy() { if (valid()) { glDeleteBuffers(1, &m_object); m_object = 0; } }
+	// Reallocates the storage (contents are undefined afterwards).
+	void allocate(size_t size) {
+		bind();
+		glBufferData((GLenum)m_type, size, nullptr, (GLenum)m_usage);
+		m_prevSize = size;
+	}
+	// Immutable storage (GL 4.4), for persistent mapping. allocate and update
+	// cannot resize it anymore.
+	void storage(size_t size, GLbitfield flags) {
+		bind();
+		glBufferStorage((GLenum)m_type, size, nullptr, flags);
+		m_prevSize = size;
+	}
+	size_t size() const { return m_prevSize; }
+	void bind() { glState().bindBuffer((GLenum)m_type, m_object); }
+	void unbind() { glState().bindBuffer((GLenum)m_type, 0); }
+
+	void destroy() { if (valid()) { glDeleteBuffers(1, &m_object); glState().deleted(GL_BUFFER, m_object); m_object = 0; } }
 	bool valid() const { return m_object > 0; }
 
 	void attributeDivisor(uint32_t index, uint32_t divisor) { glVertexAttribDivisor(index, divisor); }
@@ -79,10 +103,10 @@ class VertexArray {
 public:
 	void create() { glGenVertexArrays(1, &m_object); }
 
-	void bind() { glBindVertexArray(m_object); }
-	void unbind() { glBindVertexArray(0); }
+	void bind() { glState().bindVertexArray(m_object); }
+	void unbind() { glState().bindVertexArray(0); }
 
-	void destroy() { if (valid()) { glDeleteVertexArrays(1, &m_object); m_object = 0; } }
+	void destroy() { if (valid()) { glDeleteVertexArrays(1, &m_object); glState().deleted(GL_VERTEX_ARRAY, m_object); m_object = 0; } }
 	bool valid() const { return m_object > 0; }
 
 private:
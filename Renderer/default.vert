@@ -1,19 +1,23 @@
 R""(#version 330 core
 
-layout (location = 0) in vec3 vPosition;
-layout (location = 1) in vec3 vNormal;
-layout (location = 2) in vec3 vTangent;
-layout (location = 3) in vec2 vTexCoord;
+// vertex inputs come from the vertex format prelude (vertex_input.glsl),
+// INSTANCED and HAS_BONES from the shader variant
 
-layout (location = 4) in vec4 vWeights;
-layout (location = 5) in ivec4 vJointIDs;
+#ifdef INSTANCED
+layout (location = 6) in mat4 iModel;
+layout (location = 10) in vec4 iTexCoordTransform;
+layout (location = 11) in vec4 iColor;
+layout (location = 12) in float iEmission;
+#else
+uniform mat4 uModel;
+#endif
 
+#ifdef HAS_BONES
 layout (std140) uniform Bones {
 	mat4 transform[64];
 } uBones;
-uniform bool uHasBones = false;
+#endif
 
-uniform mat4 uModel;
 uniform mat4 uView;
 uniform mat4 uProjection;
 
@@ -29,49 +33,66 @@ out DATA {
 } VS;
 
 void main() {
+	vec3 position = vertexPosition();
+	vec3 normal = vertexNormal();
+	vec4 tangent = vertexTangent();
+
+#ifdef HAS_BONES
 	vec4 posSkinned = vec4(0.0);
-    vec4 nrmSkinned = vec4(0.0);
+	vec4 nrmSkinned = vec4(0.0);
 	vec4 tgtSkinned = vec4(0.0);
 
-	if (uHasBones) {
-		for (int i = 0; i < 4; i++) {
-			float w = vWeights[i];
-			int id = vJointIDs[i];
-			if (id < 0 || w <= 0.0) continue;
-
-			mat4 bone = uBones.transform[id];
-
-			vec4 pos = bone * vec4(vPosition, 1.0);
-			posSkinned += pos * w;
-			
-			vec4 nrm = bone * vec4(vNormal, 0.0);
-			nrmSkinned += nrm * w;
-
-			vec4 tgt = bone * vec4(vTangent, 0.0);
-			tgtSkinned += tgt * w;
-		}
-	} else {
-		posSkinned = vec4(vPosition, 1.0);
-		nrmSkinned = vec4(vNormal, 0.0);
-		tgtSkinned = vec4(vTangent, 0.0);
+	vec4 weights = vertexWeights();
+	ivec4 joints = vertexJointIDs();
+	for (int i = 0; i < 4; i++) {
+		float w = weights[i];
+		int id = joints[i];
+		if (id < 0 || w <= 0.0) continue;
+
+		mat4 bone = uBones.transform[id];
+
+		vec4 pos = bone * vec4(position, 1.0);
+		posSkinned += pos * w;
+
+		vec4 nrm = bone * vec4(normal, 0.0);
+		nrmSkinned += nrm * w;
+
+		vec4 tgt = bone * vec4(tangent.xyz, 0.0);
+		tgtSkinned += tgt * w;
 	}
-	
-	vec4 fpos = uModel * posSkinned;
+#else
+	vec4 posSkinned = vec4(position, 1.0);
+	vec4 nrmSkinned = vec4(normal, 0.0);
+	vec4 tgtSkinned = vec4(tangent.xyz, 0.0);
+#endif
+
+#ifdef INSTANCED
+	mat4 model = iModel;
+	VS.uv = iTexCoordTransform.xy + vertexTexCoord() * iTexCoordTransform.zw;
+	VS.color = iColor;
+	VS.emission = iEmission;
+#else
+	mat4 model = uModel;
+	VS.uv = vertexTexCoord();
+	VS.color = vec4(1.0);
+	VS.emission = 0.0f;
+#endif
+
+	vec4 fpos = model * posSkinned;
 	gl_Position = uProjection * uView * fpos;
 
-	mat3 nmat = mat3(transpose(inverse(uModel)));
+	mat3 nmat = mat3(transpose(inverse(model)));
 
 	VS.position = fpos.xyz;
-	VS.uv = vTexCoord;
-	VS.color = vec4(1.0);
-	VS.emission = 0.0f;
 	VS.normal = nmat * nrmSkinned.xyz;
 	VS.eye = -uView[3].xyz * mat3(uView);
 
 	VS.tangent = normalize(nmat * tgtSkinned.xyz);
 	VS.tangent = normalize(VS.tangent - dot(VS.tangent, VS.normal) * VS.normal);
 
-	vec3 b = cross(VS.tangent, VS.normal);
+	// images are stored top row first, so +v runs down the image and the
+	// bitangent is cross(T, N) rather than MikkTSpace's cross(N, T)
+	vec3 b = cross(VS.tangent, VS.normal) * tangent.w;
 	VS.tbn = mat3(VS.tangent, b, VS.normal);
 }
-)""
\ No newline at end of file
+)""
@@ -0,0 +1,282 @@
+#include "effect_parser.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "mapped_file.h"
+
+// Nested deeper than this is taken for an include cycle gone wrong.
+constexpr int MaxIncludeDepth = 32;
+
+const std::string* ShaderIncludeCache::find(const std::string& name) {
+	auto pos = m_sources.find(name);
+	if (pos != m_sources.end()) return &pos->second;
+
+	MappedFile file;
+	if (!file.open(name)) return nullptr;
+	return &(m_sources[name] = std::string(file.data(), file.size()));
+}
+
+ShaderIncludeCache& shaderIncludes() {
+	static ShaderIncludeCache cache;
+	return cache;
+}
+
+static bool equalsNoCase(std::string_view a, std::string_view b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+		return ::tolower(uint8_t(x)) == ::tolower(uint8_t(y));
+	});
+}
+
+static bool stageType(std::string_view region, ShaderType& type) {
+	static const std::pair<std::string_view, ShaderType> regions[] = {
+		{ "vertex_shader", ShaderType::VertexShader },
+		{ "fragment_shader", ShaderType::FragmentShader },
+		{ "geometry_shader", ShaderType::GeometryShader },
+		{ "compute_shader", ShaderType::ComputeShader }
+	};
+	for (auto& [name, t] : regions) {
+		if (equalsNoCase(region, name)) {
+			type = t;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool isIdentifier(char c) {
+	return ::isalnum(uint8_t(c)) || c == '_';
+}
+
+// What follows the '#' of a preprocessor line, empty if it is not one.
+static std::string_view directive(std::string_view line) {
+	size_t p = line.find_first_not_of(" \t\r");
+	if (p == std::string_view::npos || line[p] != '#') return {};
+	p = line.find_first_not_of(" \t", p + 1);
+	return p == std::string_view::npos ? std::string_view{} : line.substr(p);
+}
+
+class EffectParser {
+public:
+	EffectParser(std::string_view source, std::string_view name, ShaderIncludeCache& includes, Effect& out)
+		: m_src(source), m_includes(includes), m_out(out) {
+		m_out.stages.clear();
+		m_out.files.assign(1, std::string(name));
+	}
+
+	bool parse() {
+		std::string_view region;
+		while (skipSpace()) {
+			char c = m_src[m_pos];
+			if (isIdentifier(c)) {
+				size_t start = m_pos;
+				while (m_pos < m_src.size() && isIdentifier(m_src[m_pos])) m_pos++;
+				region = m_src.substr(start, m_pos - start);
+			} else if (c == '{') {
+				uint32_t line = m_line;
+				std::string_view body;
+				if (!block(body)) return false;
+
+				ShaderType type;
+				if (!stageType(region, type)) {
+					LOG(WARNING) << m_out.files[0] << "(" << line << "): unknown shader region \"" << region << "\"\n";
+				} else {
+					EffectStage& stage = m_out.stages.emplace_back();
+					stage.type = type;
+					stage.source.reserve(body.size() + 64);
+					m_included.clear();
+					if (!expand(body, 0, line, 0, stage.source)) return false;
+				}
+				region = {};
+			} else {
+				m_pos++;
+			}
+		}
+		return true;
+	}
+
+private:
+	std::string_view m_src;
+	size_t m_pos{ 0 };
+	uint32_t m_line{ 1 };
+
+	ShaderIncludeCache& m_includes;
+	Effect& m_out;
+	std::vector<uint32_t> m_included; // files already expanded into the current stage
+
+	void advance() {
+		if (m_src[m_pos++] == '\n') m_line++;
+	}
+
+	// Skips a comment starting at m_pos, if there is one.
+	bool comment() {
+		if (m_src.compare(m_pos, 2, "//") == 0) {
+			while (m_pos < m_src.size() && m_src[m_pos] != '\n') m_pos++;
+			return true;
+		}
+		if (m_src.compare(m_pos, 2, "/*") == 0) {
+			m_pos += 2;
+			while (m_pos < m_src.size() && m_src.compare(m_pos, 2, "*/") != 0) advance();
+			m_pos = std::min(m_pos + 2, m_src.size());
+			return true;
+		}
+		return false;
+	}
+
+	// Whitespace and comments between regions, false at the end.
+	bool skipSpace() {
+		while (m_pos < m_src.size()) {
+			if (::isspace(uint8_t(m_src[m_pos]))) advance();
+			else if (!comment()) return true;
+		}
+		return false;
+	}
+
+	// Everything between a '{' and its matching '}', braces in comments do not count.
+	bool block(std::string_view& body) {
+		uint32_t line = m_line;
+		size_t start = ++m_pos;
+		int depth = 1;
+		while (m_pos < m_src.size()) {
+			char c = m_src[m_pos];
+			if (c == '/' && comment()) continue;
+			if (c == '{') {
+				depth++;
+			} else if (c == '}' && --depth == 0) {
+				body = m_src.substr(start, m_pos - start);
+				m_pos++;
+				return true;
+			}
+			advance();
+		}
+		LOG(ERROR) << m_out.files[0] << "(" << line << "): unterminated shader region\n";
+		return false;
+	}
+
+	uint32_t fileIndex(std::string_view name) {
+		for (size_t i = 1; i < m_out.files.size(); i++) {
+			if (m_out.files[i] == name) return uint32_t(i);
+		}
+		m_out.files.emplace_back(name);
+		return uint32_t(m_out.files.size() - 1);
+	}
+
+	static void lineDirective(std::string& out, uint32_t line, uint32_t file) {
+		out += "#line ";
+		out += std::to_string(line);
+		out += ' ';
+		out += std::to_string(file);
+		out += '\n';
+	}
+
+	// Copies text in runs, breaking them only at #include lines and, in the
+	// stage itself, right after #version where its first #line has to go.
+	// Lines are only looked at where there is a '#'.
+	bool expand(std::string_view text, uint32_t file, uint32_t line, int depth, std::string& out) {
+		bool lineSet = depth > 0;
+		if (!lineSet && text.find("#version") == std::string_view::npos) {
+			lineDirective(out, line, file);
+			lineSet = true;
+		}
+
+		size_t run = 0, p = 0, counted = 0;
+		while ((p = text.find('#', p)) != std::string_view::npos) {
+			size_t start = text.rfind('\n', p);
+			start = start == std::string_view::npos ? 0 : start + 1;
+			if (text.find_first_not_of(" \t\r", start) != p) {
+				p++;
+				continue;
+			}
+
+			line += uint32_t(std::count(text.begin() + counted, text.begin() + start, '\n'));
+			counted = start;
+
+			size_t eol = text.find('\n', p);
+			size_t next = eol == std::string_view::npos ? text.size() : eol + 1;
+			std::string_view d = directive(text.substr(start, next - start));
+
+			if (!lineSet && d.compare(0, 7, "version") == 0) {
+				out.append(text.substr(run, next - run));
+				if (eol == std::string_view::npos) out += '\n';
+				lineDirective(out, line + 1, file);
+				lineSet = true;
+				run = next;
+			} else if (d.compare(0, 7, "include") == 0) {
+				out.append(text.substr(run, start - run));
+				if (!include(d.substr(7), file, line, depth, out)) return false;
+				lineDirective(out, line + 1, file);
+				run = next;
+			}
+			p = next;
+		}
+		out.append(text.substr(run));
+		if (!out.empty() && out.back() != '\n') out += '\n';
+		return true;
+	}
+
+	bool include(std::string_view arg, uint32_t file, uint32_t line, int depth, std::string& out) {
+		size_t open = arg.find_first_of("\"<");
+		size_t close = open == std::string_view::npos ? open : arg.find(arg[open] == '<' ? '>' : '"', open + 1);
+		if (close == std::string_view::npos) {
+			LOG(ERROR) << m_out.files[file] << "(" << line << "): malformed #include\n";
+			return false;
+		}
+
+		std::string name(arg.substr(open + 1, close - open - 1));
+		if (depth >= MaxIncludeDepth) {
+			LOG(ERROR) << m_out.files[file] << "(" << line << "): includes nested too deep at \"" << name << "\"\n";
+			return false;
+		}
+
+		const std::string* source = m_includes.find(name);
+		if (!source) {
+			LOG(ERROR) << m_out.files[file] << "(" << line << "): cannot open include file \"" << name << "\"\n";
+			return false;
+		}
+
+		uint32_t index = fileIndex(name);
+		if (std::find(m_included.begin(), m_included.end(), index) != m_included.end()) return true;
+		m_included.push_back(index);
+
+		lineDirective(out, 1, index);
+		return expand(*source, index, 1, depth + 1, out);
+	}
+};
+
+bool parseEffect(std::string_view source, Effect& out, std::string_view name, ShaderIncludeCache* includes) {
+	return EffectParser(source, name, includes ? *includes : shaderIncludes(), out).parse();
+}
+
+std::string mapShaderLog(std::string_view log, const std::vector<std::string>& files) {
+	std::string out;
+	out.reserve(log.size());
+
+	size_t p = 0;
+	while (p < log.size()) {
+		size_t eol = log.find('\n', p);
+		size_t next = eol == std::string_view::npos ? log.size() : eol + 1;
+		std::string_view line = log.substr(p, next - p);
+
+		// "0(12) : error" (NVIDIA), "0:12(5): error" (Mesa), "ERROR: 0:12: " (AMD, Intel)
+		size_t at = 0;
+		for (std::string_view prefix : { "ERROR: ", "WARNING: " }) {
+			if (line.compare(0, prefix.size(), prefix) == 0) at = prefix.size();
+		}
+
+		size_t end = at;
+		uint32_t file = 0;
+		while (end < line.size() && ::isdigit(uint8_t(line[end]))) file = file * 10 + uint32_t(line[end++] - '0');
+
+		bool located = end > at && end + 1 < line.size() && (line[end] == '(' || line[end] == ':') &&
+			::isdigit(uint8_t(line[end + 1])) && file < files.size();
+		if (located) {
+			out.append(line.substr(0, at));
+			out += files[file];
+			out.append(line.substr(end));
+		} else {
+			out.append(line);
+		}
+		p = next;
+	}
+	return out;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "shader_program.h"
+
+// Sources for #include "name". Ones added here are looked up first, anything
+// else is read from disk once and kept.
+class ShaderIncludeCache {
+public:
+	void add(const std::string& name, std::string source) { m_sources[name] = std::move(source); }
+	const std::string* find(const std::string& name);
+	void clear() { m_sources.clear(); }
+
+private:
+	std::unordered_map<std::string, std::string> m_sources;
+};
+
+// The cache ShaderProgram::addProgram uses.
+ShaderIncludeCache& shaderIncludes();
+
+struct EffectStage {
+	ShaderType type;
+	std::string source; // includes expanded, #line directives in place
+};
+
+struct Effect {
+	std::vector<EffectStage> stages;
+	std::vector<std::string> files; // names of the #line source string numbers, 0 is the effect
+};
+
+// Splits an effect (vertex_shader { ... } fragment_shader { ... }) into its
+// stages in a single pass over the source. Inside a stage, #include "name"
+// lines are replaced by the file, each file at most once per stage, with #line
+// directives so compiler errors point at the right file and line.
+bool parseEffect(std::string_view source, Effect& out, std::string_view name = "effect", ShaderIncludeCache* includes = nullptr);
+
+// Rewrites the source string numbers of a compiler log ("0(12)", "0:12:") as file names.
+std::string mapShaderLog(std::string_view log, const std::vector<std::string>& files);
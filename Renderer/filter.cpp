@@ -39,7 +39,7 @@ void main() {
 	m_shader.create();
 	m_shader.addShader(fxVert, ShaderType::VertexShader);
 	m_shader.addShader(fxFrag, ShaderType::FragmentShader);
-	m_shader.link();
+	m_shader.submit();
 }
 
 void Filter::setUniforms() {
@@ -30,5 +30,12 @@ void FilterChain::create(uint32_t w, uint32_t h) {
 		m_pingPongBuffer.create(w, h);
 		m_pingPongBuffer.addColorAttachment(TextureFormat::RGBAf, TextureTarget::Texture2D);
 		m_pingPongBuffer.addColorAttachment(TextureFormat::RGBAf, TextureTarget::Texture2D);
+
+		// filters only read level 0 and 1 (blur samples with a bias of 1), so
+		// regenerating mips between iterations only has to rebuild level 1
+		for (auto& tex : m_pingPongBuffer.colorAttachments()) {
+			tex.bind();
+			tex.setLevelRange(0, 1);
+		}
 	}
 }
@@ -1,8 +1,11 @@
 #include "framebuffer.h"
 
+#include <algorithm>
+
 void Framebuffer::destroy() {
 	if (valid()) {
 		glDeleteFramebuffers(1, &m_object);
+		glState().deleted(GL_FRAMEBUFFER, m_object);
 		m_object = 0;
 
 		if (m_renderBuffer) {
@@ -23,25 +26,27 @@ void Framebuffer::create(uint32_t width, uint32_t height) {
 	m_height = height;
 
 	glGenFramebuffers(1, &m_object);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_object);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, m_object);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::bind(FrameBufferTarget target, Attachment readBuffer, uint32_t slot) {
 	m_boundTarget = target;
-	glGetIntegerv(GL_VIEWPORT, m_previousViewport);
-	glBindFramebuffer((GLenum)target, m_object);
-	glViewport(0, 0, m_width, m_height);
+	// from the state cache, a glGet here would stall on the GPU
+	m_hasPreviousViewport = glState().viewportKnown();
+	std::copy_n(glState().viewport(), 4, m_previousViewport);
+	glState().bindFramebuffer((GLenum)target, m_object);
+	glState().viewport(0, 0, m_width, m_height);
 	if (target == FrameBufferTarget::ReadFramebuffer)
 		glReadBuffer((GLenum)readBuffer + slot);
 }
 
 void Framebuffer::unbind(bool resetViewport) {
-	glBindFramebuffer((GLenum)m_boundTarget, 0);
-	if (resetViewport) {
-		glViewport(
+	glState().bindFramebuffer((GLenum)m_boundTarget, 0);
+	if (resetViewport && m_hasPreviousViewport) {
+		glState().viewport(
 			m_previousViewport[0],
 			m_previousViewport[1],
 			m_previousViewport[2],
@@ -51,7 +56,7 @@ void Framebuffer::unbind(bool resetViewport) {
 }
 
 void Framebuffer::addColorAttachment(TextureFormat format, TextureTarget target) {
-	glBindFramebuffer(GL_FRAMEBUFFER, m_object);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, m_object);
 
 	Texture tex{};
 	tex.create(target);
@@ -94,14 +99,14 @@ void Framebuffer::addColorAttachment(TextureFormat format, TextureTarget target)
 
 	m_colorAttachments.push_back(tex);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::addDepthAttachment() {
 	if (m_depthAttachment.object() != 0) {
 		return;
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, m_object);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, m_object);
 
 	Texture tex{};
 	tex.create(TextureTarget::Texture2D);
@@ -117,7 +122,7 @@ void Framebuffer::addDepthAttachment() {
 		tex.object(),
 		0
 	);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	m_depthAttachment = tex;
 }
@@ -126,7 +131,7 @@ void Framebuffer::addStencilAttachment() {
 	if (m_stencilAttachment.object() != 0) {
 		return;
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, m_object);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, m_object);
 
 	Texture tex;
 	tex.create(TextureTarget::Texture2D);
@@ -142,7 +147,7 @@ void Framebuffer::addStencilAttachment() {
 		0
 	);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	m_stencilAttachment = tex;
 }
@@ -155,7 +160,7 @@ void Framebuffer::addRenderBuffer(TextureFormat storage, Attachment attachment,
 	auto [internalFormat, fmt, type] = getTextureFormat(storage);
 	
 	glGenRenderbuffers(1, &m_renderBuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_object);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, m_object);
 	glBindRenderbuffer(GL_RENDERBUFFER, m_renderBuffer);
 
 	if (!multisample) glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, m_width, m_height);
@@ -171,11 +176,11 @@ void Framebuffer::addRenderBuffer(TextureFormat storage, Attachment attachment,
 	glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 		return;
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::resetDrawBuffers() {
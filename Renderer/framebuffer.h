@@ -47,6 +47,7 @@ private:
 	GLuint m_object, m_renderBuffer{ 0 };
 
 	int m_previousViewport[4];
+	bool m_hasPreviousViewport{ false };
 	uint32_t m_width, m_height;
 
 	Texture m_depthAttachment{}, m_stencilAttachment{};
@@ -3,6 +3,8 @@
 #include <chrono>
 #include <iostream>
 
+#include "gl_state.h"
+
 GameWindow::~GameWindow() {
 	if (m_handle) {
 		DestroyWindow(m_handle);
@@ -147,6 +149,7 @@ bool GameWindow::preCreate() {
 	}
 
 	gladLoadGL();
+	glState().reset(m_width, m_height);
 	//glEnable(GL_FRAMEBUFFER_SRGB);
 
 	std::cout << "OpenGL v" << glGetString(GL_VERSION) << " - " << glGetString(GL_VENDOR) << std::endl;
@@ -12,11 +12,19 @@ layout (std140) uniform Material {
 	vec4 diffuse;
 } material;
 
-uniform bool tTextureValid[4];
+// one variant per combination of maps
+#ifdef HAS_DIFFUSE_MAP
 uniform sampler2D tDiffuse;
+#endif
+#ifdef HAS_SPECULAR_MAP
 uniform sampler2D tSpecular;
+#endif
+#ifdef HAS_NORMAL_MAP
 uniform sampler2D tNormals;
+#endif
+#ifdef HAS_EMISSION_MAP
 uniform sampler2D tEmission;
+#endif
 
 in DATA {
 	vec3 position;
@@ -31,28 +39,31 @@ in DATA {
 
 void main() {
 	vec4 diff = material.diffuse * VS.color;
-	if (tTextureValid[0]) {
-		diff *= texture(tDiffuse, VS.uv);
-	}
+#ifdef HAS_DIFFUSE_MAP
+	diff *= texture(tDiffuse, VS.uv);
+#endif
 	rtDiffuse = diff;
 
 	if (diff.a <= 0.5) discard;
 
 	float spec = 1.0;
-	if (tTextureValid[1]) {
-		spec = texture(tSpecular, VS.uv).r;
-	}
+#ifdef HAS_SPECULAR_MAP
+	spec = texture(tSpecular, VS.uv).r;
+#endif
 
 	float emis = material.emission * VS.emission;
-	if (tTextureValid[3]) {
-		emis *= texture(tEmission, VS.uv).r;
-	}
+#ifdef HAS_EMISSION_MAP
+	emis *= texture(tEmission, VS.uv).r;
+#endif
 	rtMaterial = vec3(material.shininess, emis, spec);
 
 	vec3 N = normalize(VS.normal);
-	if (tTextureValid[2]) {
-		N = normalize(VS.tbn * (texture(tNormals, VS.uv).xyz * 2.0 - 1.0));
-	}
+#ifdef HAS_NORMAL_MAP
+	// z is rebuilt so two channel (BC5) normal maps work too
+	vec2 nxy = texture(tNormals, VS.uv).xy * 2.0 - 1.0;
+	vec3 n = vec3(nxy, sqrt(max(1.0 - dot(nxy, nxy), 0.0)));
+	N = normalize(VS.tbn * n);
+#endif
 	rtNormals = N * 0.5 + 0.5;
 	rtPosition = VS.position;
 }
@@ -0,0 +1,202 @@
+#include "gl_state.h"
+
+void GLState::reset(uint32_t width, uint32_t height) {
+	*this = GLState{};
+	m_viewport[2] = int(width);
+	m_viewport[3] = int(height);
+	m_viewportKnown = true;
+}
+
+void GLState::useProgram(GLuint program) {
+	if (changed(m_program, program)) glUseProgram(program);
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+	if (changed(m_vertexArray, vao)) {
+		glBindVertexArray(vao);
+		// the element buffer binding belongs to the vertex array
+		m_buffers[ElementSlot] = Unknown;
+	}
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+	int slot = bufferSlot(target);
+	if (slot < 0) {
+		m_frame.issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (changed(m_buffers[slot], buffer)) glBindBuffer(target, buffer);
+}
+
+void GLState::bindBufferBase(GLenum target, uint32_t index, GLuint buffer) {
+	bindBufferRange(target, index, buffer, 0, 0);
+}
+
+void GLState::bindBufferRange(GLenum target, uint32_t index, GLuint buffer, size_t offset, size_t size) {
+	if (target != GL_UNIFORM_BUFFER || index >= MaxBufferBindings) {
+		m_frame.issued++;
+		if (size == 0) glBindBufferBase(target, index, buffer);
+		else glBindBufferRange(target, index, buffer, GLintptr(offset), GLsizeiptr(size));
+		if (bufferSlot(target) >= 0) m_buffers[bufferSlot(target)] = buffer;
+		return;
+	}
+
+	BufferRange& bound = m_uniformBindings[index];
+	if (bound.buffer == buffer && bound.offset == offset && bound.size == size) {
+		m_frame.filtered++;
+		return;
+	}
+	bound = { buffer, offset, size };
+	m_frame.issued++;
+	if (size == 0) glBindBufferBase(target, index, buffer);
+	else glBindBufferRange(target, index, buffer, GLintptr(offset), GLsizeiptr(size));
+	// also binds the generic target
+	m_buffers[UniformSlot] = buffer;
+}
+
+void GLState::activeTexture(uint32_t unit) {
+	if (changed(m_activeTexture, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::bindTexture(uint32_t unit, GLenum target, GLuint texture) {
+	// texture calls after this one act on the unit, so it is made active either way
+	activeTexture(unit);
+
+	int slot = textureSlot(target);
+	if (slot < 0 || unit >= MaxTextureUnits) {
+		m_frame.issued++;
+		glBindTexture(target, texture);
+		return;
+	}
+	if (changed(m_textures[unit][slot], texture)) glBindTexture(target, texture);
+}
+
+void GLState::bindTextureUnit(uint32_t unit, GLenum target, GLuint texture) {
+	// unbinding through glBindTextureUnit clears every target of the unit
+	int slot = textureSlot(target);
+	if (!GLAD_GL_VERSION_4_5 || slot < 0 || unit >= MaxTextureUnits || texture == 0) {
+		bindTexture(unit, target, texture);
+		return;
+	}
+	if (changed(m_textures[unit][slot], texture)) glBindTextureUnit(unit, texture);
+}
+
+void GLState::bindFramebuffer(GLenum target, GLuint framebuffer) {
+	bool draw = target != GL_READ_FRAMEBUFFER, read = target != GL_DRAW_FRAMEBUFFER;
+	if ((!draw || m_drawFramebuffer == framebuffer) && (!read || m_readFramebuffer == framebuffer)) {
+		m_frame.filtered++;
+		return;
+	}
+	if (draw) m_drawFramebuffer = framebuffer;
+	if (read) m_readFramebuffer = framebuffer;
+	m_frame.issued++;
+	glBindFramebuffer(target, framebuffer);
+}
+
+void GLState::viewport(int x, int y, int width, int height) {
+	if (m_viewportKnown && m_viewport[0] == x && m_viewport[1] == y && m_viewport[2] == width && m_viewport[3] == height) {
+		m_frame.filtered++;
+		return;
+	}
+	m_viewport[0] = x;
+	m_viewport[1] = y;
+	m_viewport[2] = width;
+	m_viewport[3] = height;
+	m_viewportKnown = true;
+	m_frame.issued++;
+	glViewport(x, y, width, height);
+}
+
+void GLState::setCapability(GLenum cap, bool enabled) {
+	int index = capability(cap);
+	if (index >= 0 && m_capabilities[index] == enabled) {
+		m_frame.filtered++;
+		return;
+	}
+	if (index >= 0) m_capabilities[index] = enabled;
+	m_frame.issued++;
+	if (enabled) glEnable(cap);
+	else glDisable(cap);
+}
+
+void GLState::blendFunc(GLenum src, GLenum dst) {
+	if (m_blendSrc == src && m_blendDst == dst) {
+		m_frame.filtered++;
+		return;
+	}
+	m_blendSrc = src;
+	m_blendDst = dst;
+	m_frame.issued++;
+	glBlendFunc(src, dst);
+}
+
+void GLState::cullFace(GLenum mode) {
+	if (changed(m_cullFace, mode)) glCullFace(mode);
+}
+
+void GLState::deleted(GLenum kind, GLuint object) {
+	auto forget = [&](GLuint& cached) { if (cached == object) cached = 0; };
+	switch (kind) {
+		case GL_PROGRAM:
+			// stays in use until another program is, and its name can come back
+			if (m_program == object) m_program = Unknown;
+			break;
+		case GL_VERTEX_ARRAY:
+			if (m_vertexArray == object) {
+				m_vertexArray = 0;
+				m_buffers[ElementSlot] = Unknown;
+			}
+			break;
+		case GL_BUFFER:
+			for (auto& b : m_buffers) forget(b);
+			for (auto& b : m_uniformBindings) forget(b.buffer);
+			break;
+		case GL_TEXTURE:
+			for (auto& unit : m_textures) {
+				for (auto& t : unit) forget(t);
+			}
+			break;
+		case GL_FRAMEBUFFER:
+			forget(m_drawFramebuffer);
+			forget(m_readFramebuffer);
+			break;
+	}
+}
+
+int GLState::bufferSlot(GLenum target) {
+	switch (target) {
+		case GL_ARRAY_BUFFER: return ArraySlot;
+		case GL_ELEMENT_ARRAY_BUFFER: return ElementSlot;
+		case GL_UNIFORM_BUFFER: return UniformSlot;
+		case GL_SHADER_STORAGE_BUFFER: return ShaderStorageSlot;
+		case GL_PIXEL_UNPACK_BUFFER: return PixelUnpackSlot;
+		default: return -1;
+	}
+}
+
+int GLState::textureSlot(GLenum target) {
+	switch (target) {
+		case GL_TEXTURE_1D: return Texture1DSlot;
+		case GL_TEXTURE_2D: return Texture2DSlot;
+		case GL_TEXTURE_2D_MULTISAMPLE: return Texture2DMSSlot;
+		case GL_TEXTURE_3D: return Texture3DSlot;
+		case GL_TEXTURE_CUBE_MAP: return CubeMapSlot;
+		default: return -1;
+	}
+}
+
+int GLState::capability(GLenum cap) {
+	switch (cap) {
+		case GL_DEPTH_TEST: return DepthTestCap;
+		case GL_CULL_FACE: return CullFaceCap;
+		case GL_BLEND: return BlendCap;
+		case GL_SCISSOR_TEST: return ScissorTestCap;
+		default: return -1;
+	}
+}
+
+GLState& glState() {
+	static GLState state;
+	return state;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "glad.h"
+
+struct GLStateStats {
+	uint32_t issued{ 0 }, filtered{ 0 };
+};
+
+// Shadow copy of the bindings and fixed-function state the renderer changes,
+// so a call that would set what is already set never reaches the driver.
+// GL is never queried: the cache starts from the defaults of a new context
+// and anything unknown (the viewport until it is set, the element buffer of
+// a vertex array just bound) is always issued. Everything binding these has
+// to go through here, on the GL thread.
+class GLState {
+public:
+	static constexpr uint32_t MaxTextureUnits = 16;
+	static constexpr uint32_t MaxBufferBindings = 16; // indexed uniform buffer binding points
+
+	// Back to the defaults of a new context whose window is width x height.
+	void reset(uint32_t width, uint32_t height);
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindBuffer(GLenum target, GLuint buffer);
+	void bindBufferBase(GLenum target, uint32_t index, GLuint buffer);
+	void bindBufferRange(GLenum target, uint32_t index, GLuint buffer, size_t offset, size_t size); // size 0 binds it all
+	// Also makes the unit active, for the texture calls that follow.
+	void bindTexture(uint32_t unit, GLenum target, GLuint texture);
+	// For sampling only, leaves the active unit alone where GL 4.5 allows.
+	void bindTextureUnit(uint32_t unit, GLenum target, GLuint texture);
+	void activeTexture(uint32_t unit);
+	uint32_t activeUnit() const { return m_activeTexture; }
+	void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+	void viewport(int x, int y, int width, int height);
+	const int* viewport() const { return m_viewport; }
+	bool viewportKnown() const { return m_viewportKnown; }
+
+	void enable(GLenum cap) { setCapability(cap, true); }
+	void disable(GLenum cap) { setCapability(cap, false); }
+	void blendFunc(GLenum src, GLenum dst);
+	void cullFace(GLenum mode);
+
+	// A deleted object is unbound by GL, these keep the cache in line.
+	void deleted(GLenum kind, GLuint object); // GL_PROGRAM, GL_VERTEX_ARRAY, GL_BUFFER, GL_TEXTURE, GL_FRAMEBUFFER
+
+	GLuint program() const { return m_program; }
+
+	// Counted since the last endFrame.
+	void endFrame() { m_lastFrame = m_frame; m_frame = GLStateStats{}; }
+	const GLStateStats& lastFrame() const { return m_lastFrame; }
+
+private:
+	static constexpr GLuint Unknown = ~0u;
+
+	enum BufferSlot { ArraySlot = 0, ElementSlot, UniformSlot, ShaderStorageSlot, PixelUnpackSlot, BufferSlotCount };
+	enum TextureSlot { Texture1DSlot = 0, Texture2DSlot, Texture2DMSSlot, Texture3DSlot, CubeMapSlot, TextureSlotCount };
+	enum Capability { DepthTestCap = 0, CullFaceCap, BlendCap, ScissorTestCap, CapabilityCount };
+
+	GLuint m_program{ 0 }, m_vertexArray{ 0 };
+	GLuint m_buffers[BufferSlotCount]{};
+	struct BufferRange {
+		GLuint buffer;
+		size_t offset, size; // size 0 for the whole buffer
+	};
+	BufferRange m_uniformBindings[MaxBufferBindings]{};
+	GLuint m_textures[MaxTextureUnits][TextureSlotCount]{};
+	uint32_t m_activeTexture{ 0 };
+	GLuint m_drawFramebuffer{ 0 }, m_readFramebuffer{ 0 };
+
+	int m_viewport[4]{};
+	bool m_viewportKnown{ false };
+
+	bool m_capabilities[CapabilityCount]{};
+	GLenum m_blendSrc{ GL_ONE }, m_blendDst{ GL_ZERO }, m_cullFace{ GL_BACK };
+
+	GLStateStats m_frame{}, m_lastFrame{};
+
+	void setCapability(GLenum cap, bool enabled);
+
+	bool changed(GLuint& cached, GLuint value) {
+		if (cached == value) {
+			m_frame.filtered++;
+			return false;
+		}
+		cached = value;
+		m_frame.issued++;
+		return true;
+	}
+
+	static int bufferSlot(GLenum target);
+	static int textureSlot(GLenum target);
+	static int capability(GLenum cap);
+};
+
+// The state of the one GL context, see GameWindow.
+GLState& glState();
@@ -0,0 +1,808 @@
+#include "gltf_loader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "aixlog.hpp"
+#include "hash.h"
+#include "json.h"
+#include "mapped_file.h"
+#include "tangent_generator.h"
+#include "skin_weights.h"
+
+constexpr uint32_t GlbMagic = 0x46546C67; // "glTF"
+constexpr uint32_t GlbChunkJson = 0x4E4F534A; // "JSON"
+constexpr uint32_t GlbChunkBin = 0x004E4942; // "BIN\0"
+
+enum GltfComponentType : uint32_t {
+	GltfByte = 5120,
+	GltfUnsignedByte = 5121,
+	GltfShort = 5122,
+	GltfUnsignedShort = 5123,
+	GltfUnsignedInt = 5125,
+	GltfFloat = 5126
+};
+
+enum GltfMode {
+	GltfTriangles = 4,
+	GltfTriangleStrip = 5,
+	GltfTriangleFan = 6
+};
+
+struct GltfBuffer {
+	const uint8_t* data{ nullptr };
+	size_t size{ 0 };
+
+	// whichever of these backs data
+	MappedFile file;
+	std::vector<uint8_t> decoded;
+};
+
+// Element i of an accessor is at data + i * stride.
+struct GltfAccessor {
+	const uint8_t* data{ nullptr };
+	size_t count{ 0 }, stride{ 0 };
+	uint32_t componentType{ 0 }, components{ 0 };
+	bool normalized{ false };
+	std::vector<uint8_t> dense; // backs data for sparse or bufferless accessors
+};
+
+struct GltfFile {
+	JsonValue json;
+	std::string directory;
+	MappedFile glb;
+	std::vector<GltfBuffer> buffers;
+};
+
+static size_t componentSize(uint32_t type) {
+	switch (type) {
+		case GltfByte:
+		case GltfUnsignedByte: return 1;
+		case GltfShort:
+		case GltfUnsignedShort: return 2;
+		case GltfUnsignedInt:
+		case GltfFloat: return 4;
+		default: return 0;
+	}
+}
+
+static uint32_t typeComponents(const std::string& type) {
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4" || type == "MAT2") return 4;
+	if (type == "MAT3") return 9;
+	if (type == "MAT4") return 16;
+	return 0;
+}
+
+bool isGltfFile(const std::string& fileName) {
+	size_t dot = fileName.find_last_of('.');
+	if (dot == std::string::npos) return false;
+
+	std::string ext = fileName.substr(dot + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(::tolower(c)); });
+	return ext == "gltf" || ext == "glb";
+}
+
+static bool decodeBase64(std::string_view text, std::vector<uint8_t>& out) {
+	static int8_t table[256];
+	static bool tableReady = false;
+	if (!tableReady) {
+		std::memset(table, -1, sizeof(table));
+		const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		for (int i = 0; i < 64; i++) table[uint8_t(alphabet[i])] = int8_t(i);
+		tableReady = true;
+	}
+
+	out.clear();
+	out.reserve(text.size() / 4 * 3);
+
+	uint32_t bits = 0;
+	int count = 0;
+	for (char c : text) {
+		if (c == '=') break;
+		int8_t v = table[uint8_t(c)];
+		if (v < 0) return false;
+
+		bits = (bits << 6) | uint32_t(v);
+		if (++count == 4) {
+			out.push_back(uint8_t(bits >> 16));
+			out.push_back(uint8_t(bits >> 8));
+			out.push_back(uint8_t(bits));
+			bits = 0;
+			count = 0;
+		}
+	}
+	if (count == 3) {
+		out.push_back(uint8_t(bits >> 10));
+		out.push_back(uint8_t(bits >> 2));
+	} else if (count == 2) {
+		out.push_back(uint8_t(bits >> 4));
+	}
+	return true;
+}
+
+static int hexDigit(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	return std::tolower(uint8_t(c)) - 'a' + 10;
+}
+
+// Relative URIs may be percent-encoded. A '%' not followed by two hex digits
+// is kept as is.
+static std::string decodeUri(const std::string& uri) {
+	std::string out;
+	out.reserve(uri.size());
+	for (size_t i = 0; i < uri.size(); i++) {
+		if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(uint8_t(uri[i + 1])) && std::isxdigit(uint8_t(uri[i + 2]))) {
+			out += char(hexDigit(uri[i + 1]) << 4 | hexDigit(uri[i + 2]));
+			i += 2;
+		} else {
+			out += uri[i];
+		}
+	}
+	return out;
+}
+
+static bool openFile(const std::string& fileName, GltfFile& f) {
+	size_t slash = fileName.find_last_of("/\\");
+	f.directory = slash == std::string::npos ? "" : fileName.substr(0, slash + 1);
+
+	if (!f.glb.open(fileName)) {
+		LOG(ERROR) << "Failed to open " << fileName << "\n";
+		return false;
+	}
+
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(f.glb.data());
+	size_t size = f.glb.size();
+
+	uint32_t header[3] = { 0, 0, 0 };
+	if (size >= 12) std::memcpy(header, data, 12);
+	if (header[0] != GlbMagic) {
+		// plain .gltf, the whole file is JSON
+		bool ok = parseJson(f.glb.data(), size, f.json);
+		f.glb.close();
+		return ok;
+	}
+
+	if (header[1] != 2 || header[2] > size) {
+		LOG(ERROR) << fileName << ": unsupported GLB version or truncated file\n";
+		return false;
+	}
+
+	const uint8_t* bin = nullptr;
+	size_t binSize = 0;
+	bool hasJson = false;
+	for (size_t at = 12; at + 8 <= header[2];) {
+		uint32_t chunk[2];
+		std::memcpy(chunk, data + at, 8);
+		if (at + 8 + chunk[0] > header[2]) break;
+
+		const uint8_t* payload = data + at + 8;
+		if (chunk[1] == GlbChunkJson && !hasJson) {
+			if (!parseJson(reinterpret_cast<const char*>(payload), chunk[0], f.json)) return false;
+			hasJson = true;
+		} else if (chunk[1] == GlbChunkBin && !bin) {
+			bin = payload;
+			binSize = chunk[0];
+		}
+		at += 8 + ((size_t(chunk[0]) + 3) & ~size_t(3));
+	}
+	if (!hasJson) {
+		LOG(ERROR) << fileName << ": GLB without a JSON chunk\n";
+		return false;
+	}
+
+	// buffer 0 without a uri is the BIN chunk, the mapping stays open for it
+	const JsonValue& buffers = f.json["buffers"];
+	if (bin && buffers.size() > 0 && !buffers[0].has("uri")) {
+		f.buffers.resize(buffers.size());
+		f.buffers[0].data = bin;
+		f.buffers[0].size = binSize;
+	}
+	return true;
+}
+
+static bool loadBuffers(GltfFile& f) {
+	const JsonValue& buffers = f.json["buffers"];
+	f.buffers.resize(buffers.size());
+
+	for (size_t i = 0; i < buffers.size(); i++) {
+		GltfBuffer& buffer = f.buffers[i];
+		if (buffer.data) continue; // GLB chunk
+
+		const JsonValue& uri = buffers[i]["uri"];
+		size_t length = size_t(buffers[i]["byteLength"].integer());
+		if (!uri.isString()) {
+			LOG(ERROR) << "glTF: buffer " << i << " has no data\n";
+			return false;
+		}
+
+		const std::string& s = uri.string();
+		if (s.compare(0, 5, "data:") == 0) {
+			size_t comma = s.find(";base64,");
+			if (comma == std::string::npos || !decodeBase64(std::string_view(s).substr(comma + 8), buffer.decoded)) {
+				LOG(ERROR) << "glTF: buffer " << i << " has an unsupported data URI\n";
+				return false;
+			}
+			buffer.data = buffer.decoded.data();
+			buffer.size = buffer.decoded.size();
+		} else {
+			std::string path = f.directory + decodeUri(s);
+			if (!buffer.file.open(path)) {
+				LOG(ERROR) << "glTF: failed to open " << path << "\n";
+				return false;
+			}
+			buffer.data = reinterpret_cast<const uint8_t*>(buffer.file.data());
+			buffer.size = buffer.file.size();
+		}
+
+		if (buffer.size < length) {
+			LOG(ERROR) << "glTF: buffer " << i << " is " << buffer.size << " bytes, expected " << length << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+// Whether count elements of size bytes fit in total, without overflowing.
+static bool fits(size_t count, size_t size, size_t total) {
+	return size == 0 || count <= total / size;
+}
+
+// Start and size of a buffer view, checked against its buffer.
+static bool bufferView(const GltfFile& f, int64_t index, const uint8_t*& data, size_t& size, size_t& stride) {
+	const JsonValue& view = f.json["bufferViews"][size_t(index)];
+	size_t buffer = size_t(view["buffer"].integer(-1));
+	if (view.isNull() || buffer >= f.buffers.size()) return false;
+
+	size_t offset = size_t(view["byteOffset"].integer());
+	size = size_t(view["byteLength"].integer());
+	stride = size_t(view["byteStride"].integer());
+	if (offset > f.buffers[buffer].size || size > f.buffers[buffer].size - offset) return false;
+
+	data = f.buffers[buffer].data + offset;
+	return true;
+}
+
+static bool accessor(const GltfFile& f, int64_t index, GltfAccessor& out) {
+	const JsonValue& acc = f.json["accessors"][size_t(index)];
+	if (acc.isNull()) return false;
+	out.dense.clear(); // accessors are reused across attributes
+
+	out.componentType = uint32_t(acc["componentType"].integer());
+	out.components = typeComponents(acc["type"].string());
+	out.count = size_t(acc["count"].integer());
+	out.normalized = acc["normalized"].boolean();
+
+	size_t elementSize = componentSize(out.componentType) * out.components;
+	if (elementSize == 0 || acc["count"].integer() < 0 || !fits(out.count, elementSize, SIZE_MAX)) return false;
+
+	if (acc.has("bufferView")) {
+		const uint8_t* data;
+		size_t size, stride;
+		if (!bufferView(f, acc["bufferView"].integer(-1), data, size, stride)) return false;
+
+		size_t offset = size_t(acc["byteOffset"].integer());
+		out.stride = stride ? stride : elementSize;
+		if (offset > size) return false;
+		if (out.count > 0 && (elementSize > size - offset || !fits(out.count - 1, out.stride, size - offset - elementSize))) return false;
+		out.data = data + offset;
+	} else {
+		// all zeros unless sparse says otherwise
+		out.dense.assign(out.count * elementSize, 0);
+		out.data = out.dense.data();
+		out.stride = elementSize;
+	}
+
+	const JsonValue& sparse = acc["sparse"];
+	if (sparse.isNull()) return true;
+
+	if (out.dense.empty()) {
+		out.dense.resize(out.count * elementSize);
+		for (size_t i = 0; i < out.count; i++) std::memcpy(&out.dense[i * elementSize], out.data + i * out.stride, elementSize);
+		out.data = out.dense.data();
+		out.stride = elementSize;
+	}
+
+	const JsonValue& indices = sparse["indices"];
+	const JsonValue& values = sparse["values"];
+	size_t count = size_t(sparse["count"].integer());
+	uint32_t indexType = uint32_t(indices["componentType"].integer());
+	size_t indexSize = componentSize(indexType);
+
+	const uint8_t *idx, *val;
+	size_t idxSize, valSize, unused;
+	if (!bufferView(f, indices["bufferView"].integer(-1), idx, idxSize, unused) ||
+		!bufferView(f, values["bufferView"].integer(-1), val, valSize, unused)) return false;
+	int64_t idxOffset = indices["byteOffset"].integer(), valOffset = values["byteOffset"].integer();
+	if (idxOffset < 0 || size_t(idxOffset) > idxSize || valOffset < 0 || size_t(valOffset) > valSize) return false;
+	idx += idxOffset;
+	val += valOffset;
+	idxSize -= size_t(idxOffset);
+	valSize -= size_t(valOffset);
+	if (indexSize == 0 || !fits(count, indexSize, idxSize) || !fits(count, elementSize, valSize)) return false;
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t target = 0;
+		std::memcpy(&target, idx + i * indexSize, indexSize);
+		if (target >= out.count) return false;
+		std::memcpy(&out.dense[target * elementSize], val + i * elementSize, elementSize);
+	}
+	return true;
+}
+
+template <typename T>
+static void convertFloats(const GltfAccessor& a, uint32_t n, uint8_t* dst, size_t dstStride, float scale, float low) {
+	for (size_t i = 0; i < a.count; i++) {
+		T src[16];
+		std::memcpy(src, a.data + i * a.stride, n * sizeof(T));
+
+		float* out = reinterpret_cast<float*>(dst + i * dstStride);
+		for (uint32_t k = 0; k < n; k++) out[k] = std::max(float(src[k]) * scale, low);
+	}
+}
+
+// First n components of every element as floats, dstStride bytes apart. Float
+// data is copied as is (in one go when the layouts match), integers are
+// converted and normalized if the accessor says so.
+static void readFloats(const GltfAccessor& a, uint32_t n, void* dst, size_t dstStride) {
+	auto out = static_cast<uint8_t*>(dst);
+	n = std::min(n, a.components);
+	bool norm = a.normalized;
+
+	switch (a.componentType) {
+		case GltfFloat:
+			if (a.stride == dstStride && a.stride == n * sizeof(float)) {
+				std::memcpy(out, a.data, a.count * a.stride);
+			} else {
+				for (size_t i = 0; i < a.count; i++) std::memcpy(out + i * dstStride, a.data + i * a.stride, n * sizeof(float));
+			}
+			break;
+		case GltfUnsignedByte: convertFloats<uint8_t>(a, n, out, dstStride, norm ? 1.0f / 255.0f : 1.0f, 0.0f); break;
+		case GltfUnsignedShort: convertFloats<uint16_t>(a, n, out, dstStride, norm ? 1.0f / 65535.0f : 1.0f, 0.0f); break;
+		case GltfByte: convertFloats<int8_t>(a, n, out, dstStride, norm ? 1.0f / 127.0f : 1.0f, norm ? -1.0f : -128.0f); break;
+		case GltfShort: convertFloats<int16_t>(a, n, out, dstStride, norm ? 1.0f / 32767.0f : 1.0f, norm ? -1.0f : -32768.0f); break;
+		case GltfUnsignedInt: convertFloats<uint32_t>(a, n, out, dstStride, 1.0f, 0.0f); break;
+		default: break;
+	}
+}
+
+template <typename T>
+static void convertInts(const GltfAccessor& a, uint32_t n, int32_t* dst, size_t dstStride) {
+	for (size_t i = 0; i < a.count; i++) {
+		T src[4];
+		std::memcpy(src, a.data + i * a.stride, n * sizeof(T));
+
+		auto out = reinterpret_cast<int32_t*>(reinterpret_cast<uint8_t*>(dst) + i * dstStride);
+		for (uint32_t k = 0; k < n; k++) out[k] = int32_t(src[k]);
+	}
+}
+
+static void readInts(const GltfAccessor& a, uint32_t n, int32_t* dst, size_t dstStride) {
+	n = std::min(n, a.components);
+	switch (a.componentType) {
+		case GltfUnsignedByte: convertInts<uint8_t>(a, n, dst, dstStride); break;
+		case GltfUnsignedShort: convertInts<uint16_t>(a, n, dst, dstStride); break;
+		case GltfUnsignedInt: convertInts<uint32_t>(a, n, dst, dstStride); break;
+		default: break;
+	}
+}
+
+static void readIndices(const GltfAccessor& a, uint32_t* out) {
+	if (a.componentType == GltfUnsignedInt && a.stride == sizeof(uint32_t)) {
+		std::memcpy(out, a.data, a.count * sizeof(uint32_t));
+	} else {
+		readInts(a, 1, reinterpret_cast<int32_t*>(out), sizeof(uint32_t));
+	}
+}
+
+static float4x4 nodeMatrix(const JsonValue& node) {
+	const JsonValue& m = node["matrix"];
+	if (m.size() == 16) {
+		float4x4 r;
+		for (int c = 0; c < 4; c++) {
+			for (int i = 0; i < 4; i++) r[c][i] = float(m[c * 4 + i].number());
+		}
+		return r;
+	}
+
+	float3 t{ 0.0f }, s{ 1.0f };
+	float4 q{ 0.0f, 0.0f, 0.0f, 1.0f };
+	const JsonValue& jt = node["translation"];
+	const JsonValue& jr = node["rotation"];
+	const JsonValue& js = node["scale"];
+	if (jt.size() == 3) t = float3{ float(jt[0].number()), float(jt[1].number()), float(jt[2].number()) };
+	if (jr.size() == 4) q = float4{ float(jr[0].number()), float(jr[1].number()), float(jr[2].number()), float(jr[3].number()) };
+	if (js.size() == 3) s = float3{ float(js[0].number(1.0)), float(js[1].number(1.0)), float(js[2].number(1.0)) };
+	return linalg::mul(linalg::translation_matrix(t), linalg::rotation_matrix(q), linalg::scaling_matrix(s));
+}
+
+struct GltfScene {
+	std::vector<float4x4> local, world;
+	std::vector<int> parent;
+	std::vector<int> order; // nodes of the scene, parents first
+	std::vector<std::vector<int>> skinJoints; // skin joint -> skeleton joint, filled on first use
+};
+
+static void buildScene(const GltfFile& f, GltfScene& scene) {
+	const JsonValue& nodes = f.json["nodes"];
+	size_t count = nodes.size();
+	scene.local.resize(count);
+	scene.world.resize(count, linalg::identity);
+	scene.parent.assign(count, -1);
+	scene.skinJoints.resize(f.json["skins"].size());
+
+	for (size_t i = 0; i < count; i++) {
+		scene.local[i] = nodeMatrix(nodes[i]);
+		for (const JsonValue& child : nodes[i]["children"].items()) {
+			size_t c = size_t(child.integer(-1));
+			if (c < count && scene.parent[c] == -1) scene.parent[c] = int(i);
+		}
+	}
+
+	// the default scene, or every root when there is none
+	std::vector<int> roots;
+	const JsonValue& scenes = f.json["scenes"];
+	if (scenes.size() > 0) {
+		for (const JsonValue& n : scenes[size_t(f.json["scene"].integer())]["nodes"].items()) roots.push_back(int(n.integer(-1)));
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			if (scene.parent[i] == -1) roots.push_back(int(i));
+		}
+	}
+
+	std::vector<bool> visited(count, false);
+	std::vector<int> stack(roots.rbegin(), roots.rend());
+	while (!stack.empty()) {
+		int n = stack.back();
+		stack.pop_back();
+		if (size_t(n) >= count || visited[n]) continue;
+		visited[n] = true;
+
+		int p = scene.parent[n];
+		scene.world[n] = p >= 0 ? linalg::mul(scene.world[p], scene.local[n]) : scene.local[n];
+		scene.order.push_back(n);
+
+		const JsonValue& children = nodes[size_t(n)]["children"];
+		for (size_t c = children.size(); c-- > 0;) stack.push_back(int(children[c].integer(-1)));
+	}
+}
+
+// Adds the joints of a skin to the skeleton, parents first. Each joint's parent
+// is its closest ancestor in the same skin, and what lies above the skin's root
+// goes into correctionMatrix. nullptr when a joint's ancestors form a cycle.
+static const std::vector<int>* addSkin(const GltfFile& f, GltfScene& scene, size_t skin, Skeleton& skel) {
+	std::vector<int>& ids = scene.skinJoints[skin];
+	if (!ids.empty()) return &ids;
+
+	const JsonValue& jskin = f.json["skins"][skin];
+	const JsonValue& joints = jskin["joints"];
+	const JsonValue& nodes = f.json["nodes"];
+	ids.assign(joints.size(), -1);
+
+	std::vector<float4x4> inverseBind(joints.size(), linalg::identity);
+	GltfAccessor ibm;
+	if (jskin.has("inverseBindMatrices") && accessor(f, jskin["inverseBindMatrices"].integer(-1), ibm) &&
+		ibm.componentType == GltfFloat && ibm.components == 16) {
+		ibm.count = std::min(ibm.count, inverseBind.size());
+		readFloats(ibm, 16, inverseBind.data(), sizeof(float4x4));
+	}
+
+	std::unordered_map<int, size_t> inSkin;
+	std::vector<std::pair<int, size_t>> byDepth;
+	for (size_t j = 0; j < joints.size(); j++) {
+		int node = int(joints[j].integer(-1));
+		if (size_t(node) >= scene.local.size()) continue;
+		inSkin[node] = j;
+
+		// a hierarchy without cycles is never deeper than its node count
+		int depth = 0;
+		for (int p = scene.parent[node]; p >= 0; p = scene.parent[p]) {
+			if (size_t(++depth) > scene.parent.size()) {
+				ids.clear();
+				return nullptr;
+			}
+		}
+		byDepth.push_back({ depth, j });
+	}
+	std::stable_sort(byDepth.begin(), byDepth.end());
+
+	for (auto [depth, j] : byDepth) {
+		int node = int(joints[j].integer());
+
+		int ancestor = scene.parent[node];
+		for (int steps = depth; ancestor >= 0 && !inSkin.count(ancestor) && steps-- > 0;) ancestor = scene.parent[ancestor];
+		int parentId = ancestor >= 0 ? ids[inSkin[ancestor]] : -1;
+
+		const JsonValue& name = nodes[size_t(node)]["name"];
+		int id = skel.addJoint(name.isString() ? name.string() : "joint" + std::to_string(node), inverseBind[j], parentId);
+		Joint& joint = skel.getJoint(id);
+
+		if (ancestor < 0) {
+			int p = scene.parent[node];
+			joint.transform = scene.local[node];
+			joint.correctionMatrix = p >= 0 ? scene.world[p] : float4x4{ linalg::identity };
+		} else {
+			// non-joint nodes in between are folded into the joint
+			joint.transform = ancestor == scene.parent[node] ? scene.local[node] :
+				linalg::mul(linalg::inverse(scene.world[ancestor]), scene.world[node]);
+			joint.correctionMatrix = skel.getJoint(parentId).correctionMatrix;
+		}
+		joint.restTransform = joint.transform;
+		ids[j] = id;
+	}
+	return &ids;
+}
+
+// Triangle list out of any of the triangle modes.
+static bool triangulate(int mode, const std::vector<uint32_t>& in, std::vector<uint32_t>& out) {
+	switch (mode) {
+		case GltfTriangles:
+			out.insert(out.end(), in.begin(), in.begin() + in.size() / 3 * 3);
+			return true;
+		case GltfTriangleStrip:
+			for (size_t i = 2; i < in.size(); i++) {
+				bool odd = i & 1;
+				out.insert(out.end(), { in[i - 2 + odd], in[i - 1 - odd], in[i] });
+			}
+			return true;
+		case GltfTriangleFan:
+			for (size_t i = 2; i < in.size(); i++) out.insert(out.end(), { in[0], in[i - 1], in[i] });
+			return true;
+		default:
+			return false;
+	}
+}
+
+// JOINTS_n/WEIGHTS_n into the vertices with joint ids remapped. A single set
+// is read in place, more than four influences go through SkinWeightBuilder.
+static void readSkinWeights(const GltfFile& f, const JsonValue& attrs, const std::vector<int>& joints, size_t count, Vertex* v) {
+	std::vector<std::pair<GltfAccessor, GltfAccessor>> sets;
+	for (int set = 0;; set++) {
+		GltfAccessor ids, weights;
+		std::string n = std::to_string(set);
+		if (!accessor(f, attrs["JOINTS_" + n].integer(-1), ids) || ids.count != count || ids.components != 4 ||
+			!accessor(f, attrs["WEIGHTS_" + n].integer(-1), weights) || weights.count != count || weights.components != 4) break;
+		sets.emplace_back(std::move(ids), std::move(weights));
+	}
+	if (sets.empty()) return;
+
+	auto remap = [&](int32_t id, float weight) {
+		return size_t(id) < joints.size() && weight > 0.0f ? joints[id] : -1;
+	};
+
+	if (sets.size() == 1) {
+		readInts(sets[0].first, 4, v->jointIDs, sizeof(Vertex));
+		readFloats(sets[0].second, 4, v->jointWeights, sizeof(Vertex));
+		for (size_t i = 0; i < count; i++) {
+			for (int k = 0; k < 4; k++) v[i].jointIDs[k] = remap(v[i].jointIDs[k], v[i].jointWeights[k]);
+		}
+		return;
+	}
+
+	SkinWeightBuilder builder(count);
+	builder.reserve(count * 4 * sets.size());
+	std::vector<int32_t> setIds(count * 4);
+	std::vector<float> setWeights(count * 4);
+	for (const auto& [idAccessor, weightAccessor] : sets) {
+		readInts(idAccessor, 4, setIds.data(), sizeof(int32_t) * 4);
+		readFloats(weightAccessor, 4, setWeights.data(), sizeof(float) * 4);
+		for (size_t i = 0; i < count * 4; i++) builder.add(uint32_t(i / 4), remap(setIds[i], setWeights[i]), setWeights[i]);
+	}
+	builder.apply(v);
+}
+
+struct PrimitiveRange {
+	size_t vertexBase, vertexCount;
+	size_t first, last; // index range
+	bool tangents;
+};
+
+struct PrimitiveStats {
+	std::vector<PrimitiveRange> ranges;
+	size_t missingTangents{ 0 };
+	std::vector<std::pair<size_t, size_t>> missingNormals; // triangle index ranges
+};
+
+static bool appendPrimitive(
+	const GltfFile& f, const JsonValue& prim, const float4x4* world, const std::vector<int>* joints,
+	MeshData& out, PrimitiveStats& stats
+) {
+	const JsonValue& attrs = prim["attributes"];
+	int mode = int(prim["mode"].integer(GltfTriangles));
+
+	GltfAccessor position;
+	if (mode < GltfTriangles || mode > GltfTriangleFan ||
+		!accessor(f, attrs["POSITION"].integer(-1), position) || position.components != 3) {
+		LOG(WARNING) << "glTF: skipped a primitive that is not triangles with positions\n";
+		return false;
+	}
+
+	std::vector<Vertex>& verts = out.vertices;
+	size_t base = verts.size(), count = position.count;
+	verts.resize(base + count);
+	Vertex* v = verts.data() + base;
+	readFloats(position, 3, &v->position, sizeof(Vertex));
+
+	GltfAccessor a;
+	bool hasNormals = accessor(f, attrs["NORMAL"].integer(-1), a) && a.count == count;
+	if (hasNormals) readFloats(a, 3, &v->normal, sizeof(Vertex));
+	if (accessor(f, attrs["TEXCOORD_0"].integer(-1), a) && a.count == count) readFloats(a, 2, &v->texCoord, sizeof(Vertex));
+
+	bool hasTangents = accessor(f, attrs["TANGENT"].integer(-1), a) && a.count == count && a.components == 4;
+	if (hasTangents) {
+		// glTF signs are computed with v pointing up, ours with v as stored
+		readFloats(a, 4, &v->tangent, sizeof(Vertex));
+		for (size_t i = 0; i < count; i++) v[i].tangent.w = v[i].tangent.w < 0.0f ? 1.0f : -1.0f;
+	}
+
+	if (joints) readSkinWeights(f, attrs, *joints, count, v);
+
+	size_t first = out.indices.size();
+	std::vector<uint32_t> corners;
+	if (prim.has("indices")) {
+		if (!accessor(f, prim["indices"].integer(-1), a) || a.components != 1) {
+			verts.resize(base);
+			return false;
+		}
+		// lists go straight to the end of the index buffer
+		std::vector<uint32_t>& dst = mode == GltfTriangles ? out.indices : corners;
+		dst.resize(dst.size() + a.count);
+		readIndices(a, dst.data() + dst.size() - a.count);
+		if (mode == GltfTriangles) out.indices.resize(first + a.count / 3 * 3);
+	} else {
+		corners.resize(count);
+		for (size_t i = 0; i < count; i++) corners[i] = uint32_t(i);
+	}
+	if (!corners.empty()) triangulate(mode, corners, out.indices);
+	for (size_t i = first; i < out.indices.size(); i++) {
+		if (out.indices[i] >= count) {
+			LOG(WARNING) << "glTF: skipped a primitive with indices out of range\n";
+			out.indices.resize(first);
+			verts.resize(base);
+			return false;
+		}
+		out.indices[i] += uint32_t(base);
+	}
+	if (!hasNormals) stats.missingNormals.push_back({ first, out.indices.size() });
+
+	// static meshes are baked into world space
+	if (world && *world != float4x4{ linalg::identity }) {
+		float3x3 m{ (*world)[0].xyz(), (*world)[1].xyz(), (*world)[2].xyz() };
+		float3x3 nm = linalg::transpose(linalg::inverse(m));
+		float det = linalg::determinant(m);
+		for (size_t i = 0; i < count; i++) {
+			v[i].position = linalg::mul(*world, float4{ v[i].position, 1.0f }).xyz();
+			v[i].normal = linalg::normalize(linalg::mul(nm, v[i].normal));
+			float3 t = linalg::mul(m, v[i].tangent.xyz());
+			v[i].tangent = float4{ linalg::length2(t) > 0.0f ? linalg::normalize(t) : t, det < 0.0f ? -v[i].tangent.w : v[i].tangent.w };
+		}
+		// mirrored, keep the winding front facing
+		if (det < 0.0f) {
+			for (size_t i = first; i < out.indices.size(); i += 3) std::swap(out.indices[i + 1], out.indices[i + 2]);
+		}
+	}
+
+	stats.ranges.push_back({ base, count, first, out.indices.size(), hasTangents });
+	if (!hasTangents) stats.missingTangents++;
+	return true;
+}
+
+// Tangents for the primitives that came without, authored ones are kept. The
+// generator may split vertices, so the mesh is put back together primitive by
+// primitive. Runs on a loader worker, hence a single thread.
+static void generateMissingTangents(MeshData& out, const PrimitiveStats& stats) {
+	if (stats.missingTangents == 0) return;
+	if (stats.missingTangents == stats.ranges.size()) {
+		generateTangents(out.vertices, out.indices, 1);
+		return;
+	}
+
+	std::vector<Vertex> vertices, primVertices;
+	std::vector<uint32_t> indices, primIndices;
+	vertices.reserve(out.vertices.size());
+	indices.reserve(out.indices.size());
+	for (const PrimitiveRange& r : stats.ranges) {
+		primVertices.assign(out.vertices.begin() + r.vertexBase, out.vertices.begin() + r.vertexBase + r.vertexCount);
+		primIndices.assign(out.indices.begin() + r.first, out.indices.begin() + r.last);
+		for (uint32_t& i : primIndices) i -= uint32_t(r.vertexBase);
+		if (!r.tangents) generateTangents(primVertices, primIndices, 1);
+
+		uint32_t base = uint32_t(vertices.size());
+		vertices.insert(vertices.end(), primVertices.begin(), primVertices.end());
+		for (uint32_t i : primIndices) indices.push_back(base + i);
+	}
+	out.vertices = std::move(vertices);
+	out.indices = std::move(indices);
+}
+
+// Smooth area weighted normals for primitives that came without.
+static void computeNormals(MeshData& out, size_t first, size_t last) {
+	std::vector<Vertex>& verts = out.vertices;
+	const std::vector<uint32_t>& inds = out.indices;
+	for (size_t i = first; i < last; i++) verts[inds[i]].normal = float3{ 0.0f };
+
+	for (size_t i = first; i < last; i += 3) {
+		Vertex& a = verts[inds[i]];
+		Vertex& b = verts[inds[i + 1]];
+		Vertex& c = verts[inds[i + 2]];
+		float3 n = linalg::cross(b.position - a.position, c.position - a.position);
+		a.normal += n;
+		b.normal += n;
+		c.normal += n;
+	}
+	for (size_t i = first; i < last; i++) {
+		float3& n = verts[inds[i]].normal;
+		float len2 = linalg::length2(n);
+		if (len2 > 0.0f && std::abs(len2 - 1.0f) > 1e-6f) n /= std::sqrt(len2);
+	}
+}
+
+uint64_t hashGltfBuffers(const std::string& fileName, uint64_t seed) {
+	GltfFile f;
+	if (!openFile(fileName, f)) return 0;
+
+	const JsonValue& buffers = f.json["buffers"];
+	for (size_t i = 0; i < buffers.size(); i++) {
+		const JsonValue& uri = buffers[i]["uri"];
+		if (!uri.isString() || uri.string().compare(0, 5, "data:") == 0) continue;
+
+		MappedFile file;
+		if (!file.open(f.directory + decodeUri(uri.string()))) return 0;
+		seed = hashBytes(file.data(), file.size(), seed);
+	}
+	return seed;
+}
+
+bool loadGltf(const std::string& fileName, MeshData& out) {
+	GltfFile f;
+	if (!openFile(fileName, f) || !loadBuffers(f)) {
+		LOG(ERROR) << "Failed to load " << fileName << "\n";
+		return false;
+	}
+
+	GltfScene scene;
+	buildScene(f, scene);
+
+	const JsonValue& nodes = f.json["nodes"];
+	const JsonValue& meshes = f.json["meshes"];
+	std::unique_ptr<Skeleton> skel;
+	PrimitiveStats stats{};
+
+	for (int n : scene.order) {
+		const JsonValue& node = nodes[size_t(n)];
+		const JsonValue& mesh = meshes[size_t(node["mesh"].integer(-1))];
+		if (mesh.isNull()) continue;
+
+		// skinned meshes ignore their node's transform
+		const std::vector<int>* joints = nullptr;
+		size_t skin = size_t(node["skin"].integer(-1));
+		if (skin < scene.skinJoints.size()) {
+			if (!skel) skel = std::make_unique<Skeleton>();
+			joints = addSkin(f, scene, skin, *skel);
+			if (!joints) {
+				LOG(ERROR) << fileName << ": cyclic node hierarchy\n";
+				return false;
+			}
+		}
+
+		for (const JsonValue& prim : mesh["primitives"].items()) {
+			appendPrimitive(f, prim, joints ? nullptr : &scene.world[n], joints, out, stats);
+		}
+	}
+
+	if (out.indices.empty()) {
+		LOG(ERROR) << fileName << ": no triangles\n";
+		return false;
+	}
+
+	for (auto [first, last] : stats.missingNormals) computeNormals(out, first, last);
+	generateMissingTangents(out, stats);
+	out.skeleton = std::move(skel);
+	return true;
+}
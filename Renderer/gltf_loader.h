@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include "mesh.h"
+
+bool isGltfFile(const std::string& fileName);
+
+// seed combined with the bytes of every buffer the file references outside of
+// itself, which its own hash does not cover. 0 when one cannot be read.
+uint64_t hashGltfBuffers(const std::string& fileName, uint64_t seed);
+
+// Loads the default scene of a glTF 2.0 file (.gltf with embedded or external
+// buffers, or .glb) into one MeshData. Every triangle primitive of every mesh
+// node is appended: static nodes are baked into world space, skinned ones stay
+// in bind space and their skins' joints are added to the skeleton. Buffers are
+// memory mapped and attributes are read straight out of them.
+bool loadGltf(const std::string& fileName, MeshData& out);
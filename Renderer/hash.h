@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+constexpr uint64_t HashSeed = 0xcbf29ce484222325ull;
+
+// FNV-1a style hash folded over 8-byte words. Not cryptographic, only used to key caches.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = HashSeed) {
+	constexpr uint64_t prime = 0x100000001b3ull;
+
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	uint64_t h = seed ^ (size * prime);
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t w;
+		std::memcpy(&w, p + i, 8);
+		h = (h ^ w) * prime;
+		h ^= h >> 29;
+	}
+	for (; i < size; i++) {
+		h = (h ^ p[i]) * prime;
+	}
+	return h;
+}
+
+inline uint64_t hashString(std::string_view str, uint64_t seed = HashSeed) {
+	return hashBytes(str.data(), str.size(), seed);
+}
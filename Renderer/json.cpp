@@ -0,0 +1,224 @@
+#include "json.h"
+
+#include <charconv>
+
+#include "aixlog.hpp"
+
+// Deeper documents are rejected rather than recursed into.
+constexpr int MaxJsonDepth = 256;
+
+static const JsonValue NullValue{};
+
+const JsonValue& JsonValue::operator [](size_t index) const {
+	return m_type == Type::Array && index < m_items.size() ? m_items[index] : NullValue;
+}
+
+const JsonValue& JsonValue::operator [](std::string_view key) const {
+	if (m_type != Type::Object) return NullValue;
+	for (size_t i = 0; i < m_keys.size(); i++) {
+		if (m_keys[i] == key) return m_items[i];
+	}
+	return NullValue;
+}
+
+class JsonParser {
+public:
+	JsonParser(const char* data, size_t size) : m_p(data), m_begin(data), m_end(data + size) {}
+
+	bool parse(JsonValue& out) {
+		if (!value(out, 0)) {
+			LOG(ERROR) << "JSON: " << m_error << " at offset " << (m_p - m_begin) << "\n";
+			return false;
+		}
+		skipSpace();
+		if (m_p != m_end) return fail("trailing characters");
+		return true;
+	}
+
+private:
+	const char* m_p;
+	const char* m_begin;
+	const char* m_end;
+	const char* m_error{ "" };
+
+	bool fail(const char* error) {
+		m_error = error;
+		return false;
+	}
+
+	void skipSpace() {
+		while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) m_p++;
+	}
+
+	bool literal(std::string_view word) {
+		if (size_t(m_end - m_p) < word.size() || std::string_view(m_p, word.size()) != word) return fail("invalid literal");
+		m_p += word.size();
+		return true;
+	}
+
+	bool value(JsonValue& out, int depth) {
+		if (depth > MaxJsonDepth) return fail("nested too deep");
+
+		skipSpace();
+		if (m_p == m_end) return fail("unexpected end");
+
+		switch (*m_p) {
+			case '{': return object(out, depth);
+			case '[': return array(out, depth);
+			case '"':
+				out.m_type = JsonValue::Type::String;
+				return string(out.m_string);
+			case 't':
+				out.m_type = JsonValue::Type::Bool;
+				out.m_number = 1.0;
+				return literal("true");
+			case 'f':
+				out.m_type = JsonValue::Type::Bool;
+				return literal("false");
+			case 'n': return literal("null");
+			default: return number(out);
+		}
+	}
+
+	bool number(JsonValue& out) {
+		// from_chars takes no leading '+', which JSON does not allow either
+		auto [end, ec] = std::from_chars(m_p, m_end, out.m_number);
+		if (ec != std::errc() || end == m_p) return fail("invalid number");
+		out.m_type = JsonValue::Type::Number;
+		m_p = end;
+		return true;
+	}
+
+	static void appendUtf8(std::string& s, uint32_t c) {
+		if (c < 0x80) {
+			s += char(c);
+		} else if (c < 0x800) {
+			s += char(0xC0 | (c >> 6));
+			s += char(0x80 | (c & 0x3F));
+		} else if (c < 0x10000) {
+			s += char(0xE0 | (c >> 12));
+			s += char(0x80 | ((c >> 6) & 0x3F));
+			s += char(0x80 | (c & 0x3F));
+		} else {
+			s += char(0xF0 | (c >> 18));
+			s += char(0x80 | ((c >> 12) & 0x3F));
+			s += char(0x80 | ((c >> 6) & 0x3F));
+			s += char(0x80 | (c & 0x3F));
+		}
+	}
+
+	bool hex4(uint32_t& out) {
+		if (m_end - m_p < 4) return fail("invalid escape");
+		out = 0;
+		for (int i = 0; i < 4; i++) {
+			char c = *m_p++;
+			out <<= 4;
+			if (c >= '0' && c <= '9') out |= c - '0';
+			else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+			else return fail("invalid escape");
+		}
+		return true;
+	}
+
+	bool string(std::string& out) {
+		m_p++; // opening quote
+		const char* run = m_p;
+		while (m_p < m_end) {
+			char c = *m_p;
+			if (c == '"') {
+				out.append(run, m_p);
+				m_p++;
+				return true;
+			}
+			if (c != '\\') {
+				m_p++;
+				continue;
+			}
+
+			out.append(run, m_p);
+			if (++m_p == m_end) break;
+			switch (*m_p++) {
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u': {
+					uint32_t c0;
+					if (!hex4(c0)) return false;
+					// surrogate pair
+					if (c0 >= 0xD800 && c0 < 0xDC00 && m_end - m_p >= 6 && m_p[0] == '\\' && m_p[1] == 'u') {
+						m_p += 2;
+						uint32_t c1;
+						if (!hex4(c1)) return false;
+						c0 = 0x10000 + ((c0 - 0xD800) << 10) + (c1 - 0xDC00);
+					}
+					appendUtf8(out, c0);
+				} break;
+				default: return fail("invalid escape");
+			}
+			run = m_p;
+		}
+		return fail("unterminated string");
+	}
+
+	bool array(JsonValue& out, int depth) {
+		out.m_type = JsonValue::Type::Array;
+		m_p++;
+		skipSpace();
+		if (m_p < m_end && *m_p == ']') {
+			m_p++;
+			return true;
+		}
+
+		while (true) {
+			out.m_items.emplace_back();
+			if (!value(out.m_items.back(), depth + 1)) return false;
+
+			skipSpace();
+			if (m_p == m_end) return fail("unterminated array");
+			char c = *m_p++;
+			if (c == ']') return true;
+			if (c != ',') return fail("expected ',' or ']'");
+		}
+	}
+
+	bool object(JsonValue& out, int depth) {
+		out.m_type = JsonValue::Type::Object;
+		m_p++;
+		skipSpace();
+		if (m_p < m_end && *m_p == '}') {
+			m_p++;
+			return true;
+		}
+
+		while (true) {
+			skipSpace();
+			if (m_p == m_end || *m_p != '"') return fail("expected a key");
+			out.m_keys.emplace_back();
+			if (!string(out.m_keys.back())) return false;
+
+			skipSpace();
+			if (m_p == m_end || *m_p != ':') return fail("expected ':'");
+			m_p++;
+
+			out.m_items.emplace_back();
+			if (!value(out.m_items.back(), depth + 1)) return false;
+
+			skipSpace();
+			if (m_p == m_end) return fail("unterminated object");
+			char c = *m_p++;
+			if (c == '}') return true;
+			if (c != ',') return fail("expected ',' or '}'");
+		}
+	}
+};
+
+bool parseJson(const char* data, size_t size, JsonValue& out) {
+	out = JsonValue{};
+	return JsonParser(data, size).parse(out);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only JSON document. Missing members and out of range elements yield a
+// shared null value, so lookups can be chained without checks.
+class JsonValue {
+public:
+	enum class Type : uint8_t {
+		Null = 0,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	Type type() const { return m_type; }
+	bool isNull() const { return m_type == Type::Null; }
+	bool isNumber() const { return m_type == Type::Number; }
+	bool isString() const { return m_type == Type::String; }
+	bool isArray() const { return m_type == Type::Array; }
+	bool isObject() const { return m_type == Type::Object; }
+
+	double number(double fallback = 0.0) const { return m_type == Type::Number ? m_number : fallback; }
+	// fallback as well when the number does not fit, NaN included
+	int64_t integer(int64_t fallback = 0) const {
+		return m_type == Type::Number && m_number >= -0x1p63 && m_number < 0x1p63 ? int64_t(m_number) : fallback;
+	}
+	bool boolean(bool fallback = false) const { return m_type == Type::Bool ? m_number != 0.0 : fallback; }
+	const std::string& string() const { return m_string; }
+
+	// Elements of an array or member values of an object.
+	size_t size() const { return m_items.size(); }
+	const std::vector<JsonValue>& items() const { return m_items; }
+	const std::string& key(size_t i) const { return m_keys[i]; }
+
+	const JsonValue& operator [](size_t index) const;
+	const JsonValue& operator [](std::string_view key) const;
+	bool has(std::string_view key) const { return !(*this)[key].isNull(); }
+
+private:
+	friend class JsonParser;
+
+	Type m_type{ Type::Null };
+	double m_number{ 0.0 };
+	std::string m_string;
+	std::vector<JsonValue> m_items;
+	std::vector<std::string> m_keys; // objects only, parallel to m_items
+};
+
+// Parses a whole document, logging the offset of the first error.
+bool parseJson(const char* data, size_t size, JsonValue& out);
@@ -7,6 +7,10 @@
 #include "texture.h"
 
 #include "renderer.h"
+#include "asset_loader.h"
+#include "resource_manager.h"
+#include "tangent_generator.h"
+#include "program_cache.h"
 
 #include "stb_image.h"
 
@@ -28,19 +32,30 @@ public:
 	void onCreate() {
 		resize(1280, 720, true);
 
+		programCache().setDirectory("shader_cache");
 		ren.create();
+		loader.create();
 
-		Vertex fverts[] = {
+		streamer.setBudget(64ull * 1024 * 1024);
+		loader.setTextureStreamer(&streamer);
+		resources.create(&loader);
+		ren.setTextureStreamer(&streamer);
+
+		std::vector<Vertex> fverts = {
 			Vertex{.position = float3(-10.0f, 0.0f, -10.0f), .normal = float3{ 0.0f, 1.0f, 0.0f }, .texCoord = float2{ 0.0f, 0.0f }},
 			Vertex{.position = float3( 10.0f, 0.0f, -10.0f), .normal = float3{ 0.0f, 1.0f, 0.0f }, .texCoord = float2{ 3.0f, 0.0f }},
 			Vertex{.position = float3( 10.0f, 0.0f,  10.0f), .normal = float3{ 0.0f, 1.0f, 0.0f }, .texCoord = float2{ 3.0f, 3.0f }},
 			Vertex{.position = float3(-10.0f, 0.0f,  10.0f), .normal = float3{ 0.0f, 1.0f, 0.0f }, .texCoord = float2{ 0.0f, 3.0f }}
 		};
-		uint32_t finds[] = { 2, 1, 0, 0, 3, 2 };
+		std::vector<uint32_t> finds = { 2, 1, 0, 0, 3, 2 };
+		generateTangents(fverts, finds);
 
-		floorMesh.create(fverts, 4, finds, 6);
-		cube.load("monkey.obj");
-		worm.import("nugget.gltf");
+		floorMesh.create(fverts.data(), fverts.size(), finds.data(), finds.size(), VertexFormat::Static);
+		cube = resources.loadMesh("monkey.obj", MeshDefaultFlags, VertexFormat::Quantized);
+		worm = resources.importMesh("nugget.gltf", MeshDefaultFlags, VertexFormat::QuantizedSkinned);
+		ren.prewarm(VertexFormat::Static);
+		ren.prewarm(VertexFormat::Quantized);
+		ren.prewarm(VertexFormat::QuantizedSkinned);
 
 		for (int y = -2; y <= 2; y++) {
 			for (int x = -2; x <= 2; x++) {
@@ -55,30 +70,55 @@ public:
 			}
 		}
 
-		tex.create(TextureTarget::Texture2D);
-		{
-			int w, h, comp;
-			auto data = stbi_load("marble.jpg", &w, &h, &comp, 4);
-			if (data) {
-				tex.bind();
-				tex.update(TextureFormat::RGBA, data, w, h);
-				tex.setWrap(TextureWrap::Repeat, TextureWrap::Repeat);
-				tex.setFilter(TextureFilter::LinearMipLinear, TextureFilter::Linear);
-				tex.generateMipmaps();
-				stbi_image_free(data);
-			}
-		}
+		tex = resources.loadTexture("marble.jpg", TextureUsage::Diffuse, TextureDefaultFlags | TextureStreamed);
+		ntex = resources.loadTexture("bricks_n.png", TextureUsage::Normals);
+		stex = resources.loadTexture("bricks_s.png", TextureUsage::Specular);
 
-		mat.textures[Material::SlotDiffuse] = tex;
 		mat.shininess = 1.0f;
 		//mat.emission = 1.0f;
 
 		floorMat.diffuse = float4{ 0.4f, 0.6f, 0.4f, 1.0f };
 		floorMat.shininess = 1.5f;
-		floorMat.textures[Material::SlotDiffuse] = tex;
 	}
 
 	void onDraw(float elapsedTime) {
+		loader.processUploads(2.0);
+		if (loading && loader.pendingCount() == 0) {
+			loading = false;
+			auto& st = loader.stats();
+			auto& px = loader.pixelStats();
+			LOG(INFO) << "Streaming done: " << st.uploads << " uploads, " << st.textureBytes / 1024 << " KB of texels, "
+				<< st.uploadMs << " ms on the GL thread (worst frame " << st.maxFrameMs << " ms), "
+				<< px.uploads << " PBO uploads, " << px.stalls << " ring stalls\n";
+
+			auto& ps = programCache().stats();
+			LOG(INFO) << "Programs: " << ps.hits << " from the binary cache in " << ps.loadMs << " ms, "
+				<< ps.misses << " compiled in " << ps.compileMs << " ms\n";
+
+			auto rs = resources.stats();
+			LOG(INFO) << "Resources: " << rs.loads << " loads, " << rs.pathHits + rs.contentHits << " deduplicated, "
+				<< rs.bytes[size_t(ResourceType::Mesh)] / 1024 << " KB of meshes, "
+				<< rs.bytes[size_t(ResourceType::Texture)] / 1024 << " KB of textures\n";
+
+			auto& fs = ren.stats();
+			LOG(INFO) << "Last frame: " << fs.commands << " commands (" << fs.autoInstanced << " instanced automatically), " << fs.drawCalls << " draws, "
+				<< fs.programBinds << " program binds, " << fs.materialUploads << " material uploads, "
+				<< fs.textureBinds << " texture binds, " << fs.meshBinds << " mesh binds\n";
+
+			auto& gs = glState().lastFrame();
+			LOG(INFO) << "GL state: " << gs.issued << " calls issued, " << gs.filtered << " filtered\n";
+
+			auto& ss = ren.streamStats();
+			LOG(INFO) << "Streamed: " << ss.bytes / 1024 << " KB, " << ss.waits << " fence waits, " << ss.buffers << " buffers\n";
+		}
+		resources.collect();
+		if (tex->ready()) {
+			mat.textures[Material::SlotDiffuse] = tex->get();
+			floorMat.textures[Material::SlotDiffuse] = tex->get();
+		}
+		if (ntex->ready()) mat.textures[Material::SlotNormals] = ntex->get();
+		if (stex->ready()) mat.textures[Material::SlotSpecular] = stex->get();
+
 		float s = ::sinf(angle * 0.4f);
 		float c = ::cosf(angle * 0.4f);
 
@@ -88,8 +128,11 @@ public:
 		//auto br = linalg::rotation_quat(float3{ 1.0f, 0.0f, 0.0f }, c1 * PI);
 		//worm.skeleton()->getJoint(0).transform = linalg::rotation_matrix(br);
 
-		auto br1 = linalg::rotation_quat(float3{ 1.0f, 0.0f, 0.0f }, c * PI);
-		worm.skeleton()->getJoint(1).transform = linalg::rotation_matrix(br1);
+		if (worm->ready()) {
+			auto br1 = linalg::rotation_quat(float3{ 1.0f, 0.0f, 0.0f }, c * PI);
+			Joint& joint = worm->get().skeleton()->getJoint(1);
+			joint.transform = linalg::mul(joint.restTransform, linalg::rotation_matrix(br1));
+		}
 
 		float4x4 v = linalg::lookat_matrix(float3{ 10.0f, 4.0f, 10.0f }, float3{ 0.0f }, float3{ 0.0f, 1.0f, 0.0f });
 		float4x4 p = linalg::perspective_matrix(rad(50.0f), float(width()) / height(), 0.01f, 500.0f);
@@ -117,7 +160,7 @@ public:
 		ren.putDirectionalLight(float3{ -1.0f, -1.0f, 1.0f }, float3{ 1.0f });
 
 		ren.draw(&floorMesh, linalg::translation_matrix(float3{ 0.0f, -1.0f, 0.0f }), floorMat);
-		ren.draw(&worm, linalg::translation_matrix(float3{ 0.0f, 0.0f, 0.0f }), floorMat);
+		if (worm->ready()) ren.draw(&worm->get(), linalg::translation_matrix(float3{ 0.0f, 0.0f, 0.0f }), floorMat);
 		//ren.drawInstanced(&cube, instances.data(), instances.size(), mat);
 
 		ren.renderAll(0, 0, width(), height());
@@ -129,9 +172,14 @@ public:
 	std::vector<Instance> instances;
 	std::vector<float> instancePulses;
 
-	Texture tex, ntex, stex;
+	AssetLoader loader;
+	ResourceManager resources;
+	TextureStreamer streamer;
+	ResourceHandle<Texture> tex, ntex, stex;
 	Material mat{}, floorMat{};
-	Mesh cube, floorMesh, worm;
+	Mesh floorMesh;
+	ResourceHandle<Mesh> cube, worm;
+	bool loading{ true };
 
 	float angle{ 0.0f };
 };
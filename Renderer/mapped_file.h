@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator =(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+	MappedFile& operator =(MappedFile&& other) noexcept;
+
+	bool open(const std::string& fileName);
+	void close();
+
+	bool valid() const { return m_data != nullptr; }
+
+	const char* data() const { return static_cast<const char*>(m_data); }
+	size_t size() const { return m_size; }
+
+private:
+	void* m_data{ nullptr };
+	size_t m_size{ 0 };
+
+#ifdef _WIN32
+	void* m_file{ nullptr };
+	void* m_mapping{ nullptr };
+#else
+	int m_fd{ -1 };
+#endif
+};
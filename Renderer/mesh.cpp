@@ -1,127 +1,100 @@
 #include "mesh.h"
 
-#include <fstream>
 #include <string>
 #include <vector>
-#include <map>
-#include <functional>
+#include <unordered_map>
+#include <cmath>
 
 #include "tinyxml2.h"
-#include "parser_tools.hpp"
 
 #include "aixlog.hpp"
 
+#include "mapped_file.h"
+#include "obj_parser.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "tangent_generator.h"
+#include "skin_weights.h"
+#include "gltf_loader.h"
+#include "hash.h"
+
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-using Filter = std::function<bool(char)>;
+static AABB computeBounds(const Vertex* vertices, size_t count) {
+	AABB bounds{};
+	if (count > 0) {
+		bounds.min = bounds.max = vertices[0].position;
+		for (size_t i = 1; i < count; i++) {
+			bounds.min = linalg::min(bounds.min, vertices[i].position);
+			bounds.max = linalg::max(bounds.max, vertices[i].position);
+		}
+	}
+	return bounds;
+}
+
+// Shared tail of loadData/importData: optimization, LODs and the cache file.
+static void finishData(MeshData& data, uint32_t flags, const std::string& cacheName, uint64_t sourceHash) {
+	if (flags & MeshOptimize) optimizeMesh(data.vertices, data.indices);
+
+	if (flags & MeshGenerateLods) data.lods = buildLodChain(data.vertices, data.indices, flags & MeshOptimize);
+	if (data.lods.empty()) data.lods.push_back(MeshLod{ 0, uint32_t(data.indices.size()), 0.0f });
 
-bool whiteSpace(char c) {
-	return !::isspace(c);
+	data.bounds = computeBounds(data.vertices.data(), data.vertices.size());
+
+	if (flags & MeshUseCache) {
+		MeshCache::write(
+			cacheName, sourceHash, flags & ~MeshUseCache,
+			data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(),
+			data.lods.data(), data.lods.size(), data.bounds, data.skeleton.get()
+		);
+	}
 }
 
-bool fwdSlashWhiteSpace(char c) {
-	return c != '/' && !whiteSpace(c);
+static bool readCache(const std::string& cacheName, uint64_t sourceHash, uint32_t flags, MeshData& out) {
+	auto cache = std::make_shared<MeshCache>();
+	if (!cache->open(cacheName, sourceHash, flags)) return false;
+
+	out.skeleton = cache->skeleton();
+	out.bounds = cache->bounds();
+	out.cache = cache;
+	return true;
 }
 
-bool newLine(char c) {
-	return c != '\n';
+void Mesh::load(const std::string& fileName, uint32_t flags, VertexFormat format) {
+	MeshData data;
+	if (loadData(fileName, data, flags)) create(std::move(data), format);
 }
 
-bool digit(char c) { return ::isdigit(c); }
-
-void Mesh::load(const std::string& fileName) {
-	std::ifstream fp{ fileName };
-	if (fp.good()) {
-		auto readChar = [&]() {
-			char c = '\0';
-			fp.get(c);
-			return c;
-		};
-
-		auto readString = [&](const Filter& filter = whiteSpace) {
-			//std::getline(fp, ret, stopAt);
-			std::string ret = "";
-			while (!fp.eof() && filter(fp.peek())) {
-				ret += readChar();
-			}
-			return ret;
-		};
-
-		auto readFloat = [&](const Filter& filter = whiteSpace) {
-			return std::stof(readString(filter));
-		};
-
-		auto readInt = [&](const Filter& filter = whiteSpace) {
-			return std::stoi(readString(filter));
-		};
-
-		auto readIndices = [&]() {
-			int3 vtn{ -1, -1, -1 };
-			
-			vtn[0] = readInt(digit)-1; // next value is also a number
-			readChar(); // eat /
-			if (fp.peek() == '/') { // v//vn
-				vtn[1] = -1;
-			} else {
-				vtn[1] = readInt(digit)-1; // v/vt
-			}
+void Mesh::import(const std::string& fileName, uint32_t flags, VertexFormat format) {
+	MeshData data;
+	if (importData(fileName, data, flags)) create(std::move(data), format);
+}
 
-			if (fp.peek() == '/') {
-				readChar(); // remove /
-				vtn[2] = readInt(digit)-1;
-			}
-			readChar(); // white space :yeet_table:
-			return vtn;
-		};
-
-		std::vector<float2> uvs;
-		std::vector<float3> pos, nrm;
-
-		std::vector<int3> indices;
-
-		while (!fp.eof()) {
-			char c = readChar();
-			if (c == '#' || c == 's' || c == 'o') {
-				readString(newLine); readChar();
-			} else if (c == 'v') {
-				char sub = readChar();
-				if (!::isspace(sub))
-					readChar(); // skip space
-				if (sub == 't') {
-					float s = readFloat(); readChar();
-					float t = readFloat(); readChar();
-					uvs.push_back(float2{ s, t });
-				} else if (sub == 'n') {
-					float x = readFloat(); readChar();
-					float y = readFloat(); readChar();
-					float z = readFloat(); readChar();
-					nrm.push_back(float3{ x, y, z });
-				} else {
-					float x = readFloat(); readChar();
-					float y = readFloat(); readChar();
-					float z = readFloat(); readChar();
-					pos.push_back(float3{ x, y, z });
-				}
-			} else if (c == 'f') {
-				readChar(); // skip space
-				// there are 4 forms: v | v/vt | v//vn | v/vt/vn... 
-				indices.push_back(readIndices());
-				indices.push_back(readIndices());
-				indices.push_back(readIndices());
-			} else {
-				readChar();
-			}
-		}
+bool Mesh::loadData(const std::string& fileName, MeshData& out, uint32_t flags) {
+	MappedFile file;
+	if (!file.open(fileName)) {
+		LOG(ERROR) << "Failed to open " << fileName << "\n";
+		return false;
+	}
 
-		fp.close();
+	const std::string cacheName = fileName + ".rmesh";
+	uint64_t sourceHash = hashBytes(file.data(), file.size());
+	out.sourceHash = sourceHash;
+	if ((flags & MeshUseCache) && readCache(cacheName, sourceHash, flags & ~MeshUseCache, out)) return true;
 
-		std::vector<Vertex> verts;
-		std::vector<uint32_t> inds;
-		process(pos, nrm, uvs, indices, verts, inds);
-		create(verts.data(), verts.size(), inds.data(), inds.size());
+	ObjData obj;
+	if (!parseObj(file.data(), file.size(), obj)) {
+		LOG(ERROR) << "Failed to parse " << fileName << "\n";
+		return false;
 	}
+
+	process(obj.positions, obj.normals, obj.texCoords, obj.faces, out.vertices, out.indices, flags);
+
+	finishData(out, flags, cacheName, sourceHash);
+	return true;
 }
 
 aiNode* findMeshNode(aiNode* node) {
@@ -155,7 +128,7 @@ void createBoneHierarchy(Skeleton* skel, aiNode* root, int parentID) {
 	int bid = skel->addJoint(std::string(root->mName.data), linalg::identity, parentID);
 	auto& joint = skel->getJoint(bid);
 
-	joint.transform = convertMat(root->mTransformation);
+	joint.transform = joint.restTransform = convertMat(root->mTransformation);
 
 	for (size_t i = 0; i < root->mNumChildren; i++) {
 		aiNode* nd = root->mChildren[i];
@@ -163,30 +136,54 @@ void createBoneHierarchy(Skeleton* skel, aiNode* root, int parentID) {
 	}
 }
 
-void Mesh::import(const std::string& fileName) {
+bool Mesh::importData(const std::string& fileName, MeshData& out, uint32_t flags) {
+	const std::string cacheName = fileName + ".rmesh";
+	uint64_t sourceHash = 0;
+	bool opened = false;
+	{
+		MappedFile file;
+		if (file.open(fileName)) {
+			sourceHash = hashBytes(file.data(), file.size());
+			opened = true;
+		}
+	}
+	// the JSON of a .gltf does not cover its buffers
+	if (opened && isGltfFile(fileName)) {
+		sourceHash = hashGltfBuffers(fileName, sourceHash);
+		opened = sourceHash != 0;
+	}
+	out.sourceHash = sourceHash;
+	if ((flags & MeshUseCache) && opened && readCache(cacheName, sourceHash, flags & ~MeshUseCache, out)) return true;
+
+	// glTF has a loader of its own, Assimp handles the rest
+	if (isGltfFile(fileName)) {
+		if (!loadGltf(fileName, out)) return false;
+		finishData(out, flags, cacheName, sourceHash);
+		return true;
+	}
+
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(
 		fileName,
 		aiProcess_Triangulate |
 		aiProcess_FlipUVs |
-		aiProcess_CalcTangentSpace
+		aiProcess_JoinIdenticalVertices
 	);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
 		LOG(ERROR) << "ERROR::ASSIMP::" << importer.GetErrorString() << "\n";
-		return;
+		return false;
 	}
 
-	m_skeleton = std::make_unique<Skeleton>();
+	out.skeleton = std::make_unique<Skeleton>();
 
-	std::vector<Vertex> verts;
-	std::vector<uint32_t> inds;
-	std::map<size_t, std::vector<std::pair<int, float>>> weights;
+	std::vector<Vertex>& verts = out.vertices;
+	std::vector<uint32_t>& inds = out.indices;
 
 	aiNode* node = findMeshNode(scene->mRootNode);
 	aiMatrix4x4 invXform = scene->mRootNode->mTransformation;
 	aiNode* skel = findBoneNode(node->mParent);
-	createBoneHierarchy(m_skeleton.get(), skel, -1);
+	createBoneHierarchy(out.skeleton.get(), skel, -1);
 
 	aiMesh* mesh = scene->mMeshes[node->mMeshes[0]]; // load one mesh for now
 	for (size_t j = 0; j < mesh->mNumVertices; j++) {
@@ -194,10 +191,8 @@ void Mesh::import(const std::string& fileName) {
 
 		aiVector3D pos = mesh->mVertices[j];
 		aiVector3D nrm = mesh->mNormals[j];
-		aiVector3D tgt = mesh->mTangents[j];
 		vert.position = float3{ pos.x, pos.y, pos.z };
 		vert.normal = float3{ nrm.x, nrm.y, nrm.z };
-		vert.tangent = float3{ tgt.x, tgt.y, tgt.z };
 
 		if (mesh->mTextureCoords[0]) {
 			aiVector3D uv = mesh->mTextureCoords[0][j];
@@ -216,50 +211,105 @@ void Mesh::import(const std::string& fileName) {
 	}
 
 	
+	SkinWeightBuilder weights(verts.size());
+	size_t influences = 0;
+	for (size_t j = 0; j < mesh->mNumBones; j++) influences += mesh->mBones[j]->mNumWeights;
+	weights.reserve(influences);
+
 	for (size_t j = 0; j < mesh->mNumBones; j++) {
 		aiBone* bone = mesh->mBones[j];
 		aiMatrix4x4 off = bone->mOffsetMatrix;
 
 		auto name = std::string(bone->mName.data);
-		auto& joint = m_skeleton->getJoint(name);
+		int jointID = out.skeleton->getJointID(name);
+		auto& joint = out.skeleton->getJoint(jointID);
 		joint.offset = convertMat(off);
 		joint.correctionMatrix = convertMat(invXform);
 
 		for (size_t k = 0; k < bone->mNumWeights; k++) {
 			aiVertexWeight vw = bone->mWeights[k];
-			weights[vw.mVertexId].push_back({ m_skeleton->getJointID(name), vw.mWeight });
+			weights.add(vw.mVertexId, jointID, vw.mWeight);
 		}
 	}
 
-	for (uint32_t i : inds) {
-		Vertex& v = verts[i];
-		auto ws = weights[i];
-
-		size_t j = 0;
-		for (auto [boneID, weight] : ws) {
-			if (j >= 4) break;
-			v.jointIDs[j] = boneID;
-			v.jointWeights[j] = weight;
-			j++;
-		}
+	SkinWeightStats skin = weights.apply(verts.data());
+	if (skin.truncated > 0) {
+		LOG(INFO) << skin.truncated << " of " << skin.skinned << " skinned vertices had more than 4 influences (up to "
+			<< skin.maxInfluences << "), kept the strongest 4\n";
 	}
 
+	// after the weights, seam vertices split here keep theirs
+	generateTangents(verts, inds);
+
 	//process(pos, nrm, uvs, indices, jointWeights, verts, inds);
-	create(verts.data(), verts.size(), inds.data(), inds.size());
+	finishData(out, flags, cacheName, sourceHash);
+	return true;
+}
 
+void Mesh::create(
+	const Vertex* vertices, size_t count,
+	const uint32_t* indices, size_t icount,
+	VertexFormat format,
+	const MeshLod* lods, size_t lodCount
+) {
+	m_bounds = computeBounds(vertices, count);
+	upload(vertices, count, indices, icount, format, lods, lodCount);
 }
 
-void Mesh::create(Vertex* vertices, size_t count, uint32_t* indices, size_t icount) {
+void Mesh::create(MeshData&& data, VertexFormat format) {
+	m_skeleton = std::move(data.skeleton);
+	m_bounds = data.bounds;
+	if (data.cache) {
+		const MeshCache& cache = *data.cache;
+		upload(
+			cache.vertices(), cache.vertexCount(),
+			cache.indices(), cache.indexCount(),
+			format, cache.lods(), cache.lodCount()
+		);
+		return;
+	}
+	upload(
+		data.vertices.data(), data.vertices.size(),
+		data.indices.data(), data.indices.size(),
+		format, data.lods.data(), data.lods.size()
+	);
+}
+
+void Mesh::upload(
+	const Vertex* vertices, size_t count,
+	const uint32_t* indices, size_t icount,
+	VertexFormat format,
+	const MeshLod* lods, size_t lodCount
+) {
+	if (m_skeleton && m_skeleton->jointCount() > 0 && !vertexFormatInfo(format).skinned) {
+		LOG(WARNING) << "Vertex format " << vertexFormatInfo(format).name << " has no skinning streams, using "
+			<< vertexFormatInfo(VertexFormat::QuantizedSkinned).name << " instead\n";
+		format = VertexFormat::QuantizedSkinned;
+	}
+
+	if (lodCount > 0) m_lods.assign(lods, lods + lodCount);
+	else m_lods = { MeshLod{ 0, uint32_t(icount), 0.0f } };
+
 	m_vertexArray.create();
 	m_vertexArray.bind();
 
+	const VertexFormatInfo& info = vertexFormatInfo(format);
+	m_format = format;
+	m_quantization = VertexQuantization{};
+
 	m_vertexBuffer.create(BufferType::ArrayBuffer, BufferUsage::DynamicDraw);
-	m_vertexBuffer.setLayout(VertexLayout, 6, sizeof(Vertex));
-	m_vertexBuffer.update(vertices, count);
+	m_vertexBuffer.setLayout(info.layout, info.layoutSize, info.stride);
+	if (format == VertexFormat::Full) {
+		m_vertexBuffer.update(vertices, count);
+	} else {
+		m_quantization = computeQuantization(vertices, count);
+		auto packed = packVertices(vertices, count, format, m_quantization);
+		m_vertexBuffer.update(packed.data(), packed.size());
+	}
 
 	m_indexBuffer.create(BufferType::ElementBuffer, BufferUsage::DynamicDraw);
 	m_indexBuffer.update(indices, icount);
-	m_indexCount = icount;
+	m_indexCount = m_lods[0].indexCount;
 
 	m_vertexArray.unbind();
 }
@@ -270,20 +320,66 @@ void Mesh::destroy() {
 	m_indexBuffer.destroy();
 }
 
+// Step sizes used by MeshWeldQuantized.
+constexpr float WeldPositionStep = 1e-4f;
+constexpr float WeldNormalStep = 1.0f / 1024.0f;
+constexpr float WeldTexCoordStep = 1.0f / 8192.0f;
+
+// Maps every value to the first one that quantizes to the same grid cell.
+template <int M>
+static std::vector<int> quantizedRemap(const std::vector<linalg::vec<float, M>>& values, float step) {
+	std::unordered_map<linalg::vec<int, M>, int> cells;
+	cells.reserve(values.size());
+
+	std::vector<int> remap(values.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		linalg::vec<int, M> cell;
+		for (int k = 0; k < M; k++) cell[k] = int(std::lround(values[i][k] / step));
+		remap[i] = cells.try_emplace(cell, int(i)).first->second;
+	}
+	return remap;
+}
+
 void Mesh::process(
 	const std::vector<float3>& pos,
 	const std::vector<float3>& nrm,
 	const std::vector<float2>& uvs,
 	const std::vector<int3>& faces,
-	std::vector<Vertex>& verts, std::vector<uint32_t>& indices)
+	std::vector<Vertex>& verts, std::vector<uint32_t>& indices,
+	uint32_t flags)
 {
-	// Now process all the data...
-	uint32_t idx = 0;
+	const bool quantized = flags & MeshWeldQuantized;
+	const bool weld = quantized || (flags & MeshWeldVertices);
+
+	std::vector<int> posRemap, uvRemap, nrmRemap;
+	if (quantized) {
+		posRemap = quantizedRemap(pos, WeldPositionStep);
+		uvRemap = quantizedRemap(uvs, WeldTexCoordStep);
+		nrmRemap = quantizedRemap(nrm, WeldNormalStep);
+	}
+
+	std::unordered_map<int3, uint32_t> welded;
+	if (weld) welded.reserve(faces.size());
+
+	indices.reserve(indices.size() + faces.size());
 	for (int3 i : faces) {
+		if (quantized) {
+			i[0] = posRemap[i[0]];
+			if (i[1] != -1) i[1] = uvRemap[i[1]];
+			if (i[2] != -1) i[2] = nrmRemap[i[2]];
+		}
+
+		if (weld) {
+			auto [it, inserted] = welded.try_emplace(i, uint32_t(verts.size()));
+			if (!inserted) {
+				indices.push_back(it->second);
+				continue;
+			}
+		}
+
 		Vertex vert{};
-		indices.push_back(idx++);
+		indices.push_back(uint32_t(verts.size()));
 
-		vert.tangent = float3{ 0.0f };
 		vert.position = pos[i[0]];
 		
 		if (i[1] != -1) vert.texCoord = uvs[i[1]];
@@ -291,41 +387,5 @@ void Mesh::process(
 		verts.push_back(vert);
 	}
 
-	// calculate tangent space
-	for (uint32_t i = 0; i < indices.size(); i += 3) {
-		uint32_t i0 = indices[i + 0];
-		uint32_t i1 = indices[i + 1];
-		uint32_t i2 = indices[i + 2];
-
-		float3 v0 = verts[i0].position;
-		float3 v1 = verts[i1].position;
-		float3 v2 = verts[i2].position;
-
-		float2 t0 = verts[i0].texCoord;
-		float2 t1 = verts[i1].texCoord;
-		float2 t2 = verts[i2].texCoord;
-
-		float3 e0 = v1 - v0;
-		float3 e1 = v2 - v0;
-
-		float2 dt1 = t1 - t0;
-		float2 dt2 = t2 - t0;
-
-		float dividend = dt1.x * dt2.y - dt1.y * dt2.x;
-		float f = dividend == 0.0f ? 0.0f : 1.0f / dividend;
-
-		float3 t{ 0.0f };
-
-		t.x = (f * (dt2.y * e0.x - dt1.y * e1.x));
-		t.y = (f * (dt2.y * e0.y - dt1.y * e1.y));
-		t.z = (f * (dt2.y * e0.z - dt1.y * e1.z));
-
-		verts[i0].tangent += t;
-		verts[i1].tangent += t;
-		verts[i2].tangent += t;
-	}
-
-	for (auto& v : verts) {
-		v.tangent = linalg::normalize(v.tangent);
-	}
+	generateTangents(verts, indices);
 }
@@ -1,14 +1,18 @@
 #pragma once
 
+#include <memory>
+
 #include "buffer.h"
 #include "skeleton.h"
+#include "vertex_format.h"
 
 #undef min
 #undef max
 #include <assimp/scene.h>
 
 struct Vertex {
-	float3 position, normal, tangent;
+	float3 position, normal;
+	float4 tangent; // w is the bitangent sign
 	float2 texCoord;
 	float jointWeights[4]{ 0.0f, 0.0f, 0.0f, 0.0f };
 	int32_t jointIDs[4]{ -1, -1, -1, -1 };
@@ -17,12 +21,50 @@ struct Vertex {
 static BufferLayoutEntry VertexLayout[] = {
 	{ 3, DataType::Float, false },  // vPosition
 	{ 3, DataType::Float, false },  // vNormal
-	{ 3, DataType::Float, false },  // vTangent
+	{ 4, DataType::Float, false },  // vTangent
 	{ 2, DataType::Float, false },  // vTexCoord
 	{ 4, DataType::Float, false },   // vWeights
 	{ 4, DataType::Int, false },   // vJointIDs
 };
 
+enum MeshProcessFlags : uint32_t {
+	MeshWeldVertices = 1 << 0, // share vertices between corners with the same (v, vt, vn) triplet
+	MeshWeldQuantized = 1 << 1, // also share corners whose quantized attribute values match
+	MeshUseCache = 1 << 2, // read/write a .rmesh cache next to the source file
+	MeshOptimize = 1 << 3, // reorder triangles and vertices for cache locality and overdraw
+	MeshGenerateLods = 1 << 4, // append simplified index ranges sharing the vertex buffer
+	MeshDefaultFlags = MeshWeldVertices | MeshUseCache
+};
+
+struct AABB {
+	float3 min{ 0.0f }, max{ 0.0f };
+};
+
+constexpr uint32_t MaxMeshLods = 5;
+
+struct MeshLod {
+	uint32_t indexOffset, indexCount;
+	float error; // geometric error relative to the mesh extent
+};
+
+float4x4 convertMat(aiMatrix4x4 m);
+
+class MeshCache;
+
+// CPU side result of loading a mesh, safe to produce on any thread.
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshLod> lods;
+	std::unique_ptr<Skeleton> skeleton;
+	AABB bounds{};
+	// Set on a cache hit instead of vertices/indices/lods, create uploads
+	// straight out of the mapping.
+	std::shared_ptr<const MeshCache> cache;
+	// Hash of the source file and the buffers it references, 0 when unknown.
+	uint64_t sourceHash{ 0 };
+};
+
 enum class PrimitiveType {
 	Points = GL_POINTS,
 	Lines = GL_LINES,
@@ -37,16 +79,34 @@ class Mesh {
 	friend class Renderer;
 public:
 
-	void load(const std::string& fileName);
-	void import(const std::string& fileName);
+	void load(const std::string& fileName, uint32_t flags = MeshDefaultFlags, VertexFormat format = VertexFormat::Full);
+	void import(const std::string& fileName, uint32_t flags = MeshDefaultFlags, VertexFormat format = VertexFormat::Full);
+
+	// load/import without touching GL, pass the result to create on the GL thread.
+	static bool loadData(const std::string& fileName, MeshData& out, uint32_t flags = MeshDefaultFlags);
+	static bool importData(const std::string& fileName, MeshData& out, uint32_t flags = MeshDefaultFlags);
 
-	void create(Vertex* vertices, size_t count, uint32_t* indices, size_t icount);
+	void create(
+		const Vertex* vertices, size_t count,
+		const uint32_t* indices, size_t icount,
+		VertexFormat format = VertexFormat::Full,
+		const MeshLod* lods = nullptr, size_t lodCount = 0
+	);
+	void create(MeshData&& data, VertexFormat format = VertexFormat::Full);
 	void destroy();
 
 	VertexArray& vao() { return m_vertexArray;  }
 	Buffer& vbo() { return m_vertexBuffer; }
 	Buffer& ibo() { return m_indexBuffer; }
 	uint32_t indexCount() const { return m_indexCount; }
+	size_t memorySize() const { return m_vertexBuffer.size() + m_indexBuffer.size(); }
+	const AABB& bounds() const { return m_bounds; }
+
+	VertexFormat vertexFormat() const { return m_format; }
+	const VertexQuantization& quantization() const { return m_quantization; }
+
+	uint32_t lodCount() const { return uint32_t(m_lods.size()); }
+	const MeshLod& lod(uint32_t index) const { return m_lods[index]; }
 
 	Skeleton* skeleton() { return m_skeleton ? m_skeleton.get() : nullptr; }
 
@@ -54,17 +114,30 @@ protected:
 	Buffer m_vertexBuffer{}, m_indexBuffer{};
 	VertexArray m_vertexArray{};
 	uint32_t m_indexCount{ 0 };
-	bool m_hasInstanceBuffer{ false };
+	uint32_t m_instanceBuffer{ 0 }; // StreamAllocation::bufferId the instance attributes point at, 0 for none
+	AABB m_bounds{};
+	std::vector<MeshLod> m_lods;
+
+	VertexFormat m_format{ VertexFormat::Full };
+	VertexQuantization m_quantization{};
 
 	std::unique_ptr<Skeleton> m_skeleton;
 
-	void process(
+	void upload(
+		const Vertex* vertices, size_t count,
+		const uint32_t* indices, size_t icount,
+		VertexFormat format,
+		const MeshLod* lods, size_t lodCount
+	);
+
+	static void process(
 		const std::vector<float3>& pos,
 		const std::vector<float3>& nrm,
 		const std::vector<float2>& uvs,
 		const std::vector<int3>& faces,
 		std::vector<Vertex>& verts,
-		std::vector<uint32_t>& indices
+		std::vector<uint32_t>& indices,
+		uint32_t flags = MeshDefaultFlags
 	);
 
 };
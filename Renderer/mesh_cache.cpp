@@ -0,0 +1,180 @@
+#include "mesh_cache.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "aixlog.hpp"
+
+struct MeshCacheJoint {
+	float4x4 transform, offset, correctionMatrix;
+	int32_t parent;
+	uint32_t nameLength; // followed by the name, padded to 4 bytes
+};
+
+static size_t alignUp(size_t v, size_t a) { return (v + a - 1) & ~(a - 1); }
+
+// count elements of stride bytes at offset, inside a file of size bytes.
+static bool sectionFits(uint64_t offset, uint64_t count, size_t stride, size_t size) {
+	return offset <= size && count <= (size - offset) / stride && offset % 4 == 0;
+}
+
+// Every section lies inside the file, and so does every joint name and LOD range.
+static bool sectionsValid(const MeshCacheHeader* h, const char* data, size_t size) {
+	if (!sectionFits(h->vertexOffset, h->vertexCount, sizeof(Vertex), size) ||
+		!sectionFits(h->indexOffset, h->indexCount, sizeof(uint32_t), size) ||
+		!sectionFits(h->lodOffset, h->lodCount, sizeof(MeshLod), size) ||
+		!sectionFits(h->jointOffset, h->jointCount, sizeof(MeshCacheJoint), size)) return false;
+
+	// whole triangles only, and every index within the vertices, as they go straight to GL
+	if (h->indexCount % 3 != 0) return false;
+	auto indices = reinterpret_cast<const uint32_t*>(data + h->indexOffset);
+	for (uint32_t i = 0; i < h->indexCount; i++) {
+		if (indices[i] >= h->vertexCount) return false;
+	}
+
+	auto lods = reinterpret_cast<const MeshLod*>(data + h->lodOffset);
+	for (uint32_t i = 0; i < h->lodCount; i++) {
+		if (lods[i].indexOffset > h->indexCount || lods[i].indexCount > h->indexCount - lods[i].indexOffset) return false;
+		if (lods[i].indexOffset % 3 != 0 || lods[i].indexCount % 3 != 0) return false;
+	}
+
+	size_t p = size_t(h->jointOffset);
+	for (uint32_t i = 0; i < h->jointCount; i++) {
+		if (size - p < sizeof(MeshCacheJoint)) return false;
+		MeshCacheJoint rec;
+		::memcpy(&rec, data + p, sizeof(rec));
+		p += sizeof(rec);
+		if (size - p < alignUp(rec.nameLength, 4)) return false;
+		p += alignUp(rec.nameLength, 4);
+	}
+	return true;
+}
+
+bool MeshCache::open(const std::string& fileName, uint64_t sourceHash, uint32_t flags) {
+	close();
+	if (!m_file.open(fileName)) return false;
+
+	auto header = reinterpret_cast<const MeshCacheHeader*>(m_file.data());
+	bool valid = m_file.size() >= sizeof(MeshCacheHeader) &&
+		header->magic == MeshCacheMagic &&
+		header->version == MeshCacheVersion &&
+		header->vertexSize == sizeof(Vertex) &&
+		header->sourceHash == sourceHash &&
+		header->flags == flags &&
+		header->lodCount > 0 &&
+		header->fileSize == m_file.size() &&
+		sectionsValid(header, m_file.data(), m_file.size());
+
+	if (!valid) {
+		m_file.close();
+		return false;
+	}
+
+	m_header = header;
+	return true;
+}
+
+AABB MeshCache::bounds() const {
+	AABB ret{};
+	ret.min = float3{ m_header->boundsMin[0], m_header->boundsMin[1], m_header->boundsMin[2] };
+	ret.max = float3{ m_header->boundsMax[0], m_header->boundsMax[1], m_header->boundsMax[2] };
+	return ret;
+}
+
+std::unique_ptr<Skeleton> MeshCache::skeleton() const {
+	if (m_header->jointCount == 0) return nullptr;
+
+	auto skel = std::make_unique<Skeleton>();
+	const char* p = m_file.data() + m_header->jointOffset;
+	for (uint32_t i = 0; i < m_header->jointCount; i++) {
+		MeshCacheJoint rec;
+		::memcpy(&rec, p, sizeof(rec));
+		p += sizeof(rec);
+
+		std::string name(p, rec.nameLength);
+		p += alignUp(rec.nameLength, 4);
+
+		int id = skel->addJoint(name, rec.offset, rec.parent);
+		auto& joint = skel->getJoint(id);
+		joint.transform = joint.restTransform = rec.transform;
+		joint.correctionMatrix = rec.correctionMatrix;
+	}
+	return skel;
+}
+
+bool MeshCache::write(
+	const std::string& fileName,
+	uint64_t sourceHash, uint32_t flags,
+	const Vertex* vertices, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount,
+	const MeshLod* lods, size_t lodCount,
+	const AABB& bounds,
+	Skeleton* skeleton
+) {
+	std::vector<char> joints;
+	size_t jointCount = skeleton ? skeleton->jointCount() : 0;
+	if (jointCount > 0) {
+		std::vector<const std::string*> names(jointCount, nullptr);
+		for (auto& [name, id] : skeleton->jointNames()) names[id] = &name;
+
+		for (size_t i = 0; i < jointCount; i++) {
+			auto& joint = skeleton->getJoint(int(i));
+
+			MeshCacheJoint rec{};
+			rec.transform = joint.restTransform;
+			rec.offset = joint.offset;
+			rec.correctionMatrix = joint.correctionMatrix;
+			rec.parent = joint.parent;
+			rec.nameLength = names[i] ? uint32_t(names[i]->size()) : 0;
+
+			size_t at = joints.size();
+			joints.resize(at + sizeof(rec) + alignUp(rec.nameLength, 4), '\0');
+			::memcpy(&joints[at], &rec, sizeof(rec));
+			if (rec.nameLength) ::memcpy(&joints[at + sizeof(rec)], names[i]->data(), rec.nameLength);
+		}
+	}
+
+	MeshCacheHeader header{};
+	header.magic = MeshCacheMagic;
+	header.version = MeshCacheVersion;
+	header.sourceHash = sourceHash;
+	header.flags = flags;
+	header.vertexSize = sizeof(Vertex);
+	header.vertexCount = uint32_t(vertexCount);
+	header.indexCount = uint32_t(indexCount);
+	header.jointCount = uint32_t(jointCount);
+	header.lodCount = uint32_t(lodCount);
+	for (int i = 0; i < 3; i++) {
+		header.boundsMin[i] = bounds.min[i];
+		header.boundsMax[i] = bounds.max[i];
+	}
+	header.vertexOffset = alignUp(sizeof(MeshCacheHeader), 16);
+	header.indexOffset = alignUp(header.vertexOffset + vertexCount * sizeof(Vertex), 16);
+	header.lodOffset = alignUp(header.indexOffset + indexCount * sizeof(uint32_t), 16);
+	header.jointOffset = alignUp(header.lodOffset + lodCount * sizeof(MeshLod), 16);
+	header.fileSize = header.jointOffset + joints.size();
+
+	std::ofstream fp{ fileName, std::ios::binary | std::ios::trunc };
+	if (!fp.good()) {
+		LOG(WARNING) << "Could not write mesh cache " << fileName << "\n";
+		return false;
+	}
+
+	auto pad = [&](uint64_t to) {
+		static const char zeros[16]{};
+		fp.write(zeros, std::streamsize(to - uint64_t(fp.tellp())));
+	};
+
+	fp.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	pad(header.vertexOffset);
+	fp.write(reinterpret_cast<const char*>(vertices), std::streamsize(vertexCount * sizeof(Vertex)));
+	pad(header.indexOffset);
+	fp.write(reinterpret_cast<const char*>(indices), std::streamsize(indexCount * sizeof(uint32_t)));
+	pad(header.lodOffset);
+	fp.write(reinterpret_cast<const char*>(lods), std::streamsize(lodCount * sizeof(MeshLod)));
+	pad(header.jointOffset);
+	fp.write(joints.data(), std::streamsize(joints.size()));
+
+	return fp.good();
+}
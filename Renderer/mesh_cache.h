@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+#include "mesh.h"
+#include "mapped_file.h"
+
+constexpr uint32_t MeshCacheMagic = 0x48534D52; // "RMSH"
+constexpr uint32_t MeshCacheVersion = 4;
+
+struct MeshCacheHeader {
+	uint32_t magic, version;
+	uint64_t sourceHash;
+	uint32_t flags, vertexSize;
+	uint32_t vertexCount, indexCount, jointCount, lodCount;
+	float boundsMin[3], boundsMax[3];
+	uint64_t vertexOffset, indexOffset, lodOffset, jointOffset, fileSize;
+};
+
+// Binary image of a processed mesh (.rmesh). Vertex and index data are read
+// straight out of the mapping, so a warm load is a single mmap + upload.
+class MeshCache {
+public:
+	bool open(const std::string& fileName, uint64_t sourceHash, uint32_t flags);
+	void close() { m_file.close(); m_header = nullptr; }
+
+	static bool write(
+		const std::string& fileName,
+		uint64_t sourceHash, uint32_t flags,
+		const Vertex* vertices, size_t vertexCount,
+		const uint32_t* indices, size_t indexCount,
+		const MeshLod* lods, size_t lodCount,
+		const AABB& bounds,
+		Skeleton* skeleton
+	);
+
+	const Vertex* vertices() const { return reinterpret_cast<const Vertex*>(m_file.data() + m_header->vertexOffset); }
+	const uint32_t* indices() const { return reinterpret_cast<const uint32_t*>(m_file.data() + m_header->indexOffset); }
+	size_t vertexCount() const { return m_header->vertexCount; }
+	size_t indexCount() const { return m_header->indexCount; }
+	const MeshLod* lods() const { return reinterpret_cast<const MeshLod*>(m_file.data() + m_header->lodOffset); }
+	size_t lodCount() const { return m_header->lodCount; }
+
+	AABB bounds() const;
+	std::unique_ptr<Skeleton> skeleton() const;
+
+private:
+	MappedFile m_file;
+	const MeshCacheHeader* m_header{ nullptr };
+};
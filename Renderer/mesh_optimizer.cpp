@@ -0,0 +1,281 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Forsyth's scoring parameters, see "Linear-Speed Vertex Cache Optimisation".
+constexpr uint32_t ForsythCacheSize = 32;
+constexpr uint32_t ForsythMaxValence = 32;
+constexpr float CacheDecayPower = 1.5f;
+constexpr float LastTriScore = 0.75f;
+constexpr float ValenceBoostScale = 2.0f;
+constexpr float ValenceBoostPower = 0.5f;
+
+struct ForsythScores {
+	float cache[ForsythCacheSize + 3];
+	float valence[ForsythMaxValence + 1];
+
+	ForsythScores() {
+		for (uint32_t i = 0; i < ForsythCacheSize + 3; i++) {
+			if (i < 3) {
+				cache[i] = LastTriScore;
+			} else if (i < ForsythCacheSize) {
+				float scaler = 1.0f / float(ForsythCacheSize - 3);
+				cache[i] = std::pow(1.0f - float(i - 3) * scaler, CacheDecayPower);
+			} else {
+				cache[i] = 0.0f;
+			}
+		}
+
+		valence[0] = 0.0f;
+		for (uint32_t i = 1; i <= ForsythMaxValence; i++) {
+			valence[i] = ValenceBoostScale * std::pow(float(i), -ValenceBoostPower);
+		}
+	}
+
+	float score(int cachePosition, uint32_t remaining) const {
+		if (remaining == 0) return -1.0f;
+		float s = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+		return s + valence[std::min(remaining, ForsythMaxValence)];
+	}
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+	VertexCacheStats stats{};
+	if (indexCount < 3) return stats;
+
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	size_t misses = 0;
+
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t v = indices[i];
+		if (time - timestamps[v] > cacheSize) {
+			timestamps[v] = time++;
+			misses++;
+		}
+	}
+
+	size_t used = std::count_if(timestamps.begin(), timestamps.end(), [](uint32_t t) { return t != 0; });
+	stats.acmr = float(misses) / float(indexCount / 3);
+	stats.atvr = used ? float(misses) / float(used) : 0.0f;
+	return stats;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	static const ForsythScores scores{};
+
+	const size_t triCount = indexCount / 3;
+	if (triCount == 0) return;
+
+	// vertex -> triangle adjacency, the first `remaining[v]` entries are still pending
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triCount * 3; i++) remaining[indices[i]]++;
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+
+	std::vector<uint32_t> adjacency(triCount * 3);
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triCount * 3; i++) adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = scores.score(-1, remaining[v]);
+
+	std::vector<float> triScore(triCount);
+	std::vector<uint8_t> emitted(triCount, 0);
+	for (size_t t = 0; t < triCount; t++) {
+		triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<uint32_t> output(triCount * 3);
+	std::vector<uint32_t> cache, nextCache;
+	cache.reserve(ForsythCacheSize + 3);
+	nextCache.reserve(ForsythCacheSize + 3);
+
+	int64_t best = std::max_element(triScore.begin(), triScore.end()) - triScore.begin();
+	size_t cursor = 0;
+
+	for (size_t out = 0; out < triCount; out++) {
+		if (best < 0) {
+			// dead end, continue with the next pending triangle in input order
+			while (emitted[cursor]) cursor++;
+			best = int64_t(cursor);
+		}
+
+		const uint32_t* tri = &indices[best * 3];
+		std::copy(tri, tri + 3, &output[out * 3]);
+		emitted[best] = 1;
+
+		nextCache.clear();
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = tri[k];
+
+			uint32_t* adj = &adjacency[offsets[v]];
+			uint32_t* last = adj + remaining[v] - 1;
+			*std::find(adj, last + 1, uint32_t(best)) = *last;
+			remaining[v]--;
+
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) nextCache.push_back(v);
+		}
+		for (uint32_t v : cache) {
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) nextCache.push_back(v);
+		}
+
+		// rescore everything that was or is in the cache
+		for (size_t i = 0; i < nextCache.size(); i++) {
+			uint32_t v = nextCache[i];
+			cachePosition[v] = i < ForsythCacheSize ? int(i) : -1;
+			vertexScore[v] = scores.score(cachePosition[v], remaining[v]);
+		}
+
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t v : nextCache) {
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+				uint32_t t = adjacency[a];
+				const uint32_t* ti = &indices[t * 3];
+				float s = vertexScore[ti[0]] + vertexScore[ti[1]] + vertexScore[ti[2]];
+				triScore[t] = s;
+				if (s > bestScore || (s == bestScore && int64_t(t) < best)) {
+					bestScore = s;
+					best = int64_t(t);
+				}
+			}
+		}
+
+		if (nextCache.size() > ForsythCacheSize) nextCache.resize(ForsythCacheSize);
+		std::swap(cache, nextCache);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold) {
+	constexpr uint32_t CacheSize = 16;
+
+	const size_t triCount = indexCount / 3;
+	if (triCount < 2) return;
+
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t time = CacheSize + 1;
+	auto triMisses = [&](size_t t) {
+		uint32_t misses = 0;
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = indices[t * 3 + k];
+			if (time - timestamps[v] > CacheSize) {
+				timestamps[v] = time++;
+				misses++;
+			}
+		}
+		return misses;
+	};
+	auto resetCache = [&]() { time += CacheSize + 1; };
+
+	// hard boundaries: triangles that miss on every vertex start over anyway
+	std::vector<size_t> hard;
+	for (size_t t = 0; t < triCount; t++) {
+		if (triMisses(t) == 3) hard.push_back(t);
+	}
+	hard.push_back(triCount);
+
+	// soft boundaries: split further as long as the cluster ACMR stays within threshold
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hard.size(); h++) {
+		size_t start = hard[h], end = hard[h + 1];
+
+		resetCache();
+		uint32_t clusterMisses = 0;
+		for (size_t t = start; t < end; t++) clusterMisses += triMisses(t);
+		float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+		resetCache();
+		clusters.push_back(start);
+		uint32_t running = 0;
+		size_t runStart = start;
+		for (size_t t = start; t < end; t++) {
+			running += triMisses(t);
+			if (t + 1 < end && float(running) / float(t + 1 - runStart) <= clusterThreshold) {
+				clusters.push_back(t + 1);
+				resetCache();
+				running = 0;
+				runStart = t + 1;
+			}
+		}
+	}
+	clusters.push_back(triCount);
+
+	// area weighted centroid and normal per cluster
+	struct Cluster { size_t start, end; float key; };
+	std::vector<Cluster> sorted;
+	sorted.reserve(clusters.size() - 1);
+
+	float3 meshCentroid{ 0.0f };
+	float meshArea = 0.0f;
+	std::vector<float3> centroids(clusters.size() - 1), normals(clusters.size() - 1);
+
+	for (size_t c = 0; c + 1 < clusters.size(); c++) {
+		float3 centroid{ 0.0f }, normal{ 0.0f };
+		float area = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+			float3 p0 = vertices[indices[t * 3 + 0]].position;
+			float3 p1 = vertices[indices[t * 3 + 1]].position;
+			float3 p2 = vertices[indices[t * 3 + 2]].position;
+			float3 n = linalg::cross(p1 - p0, p2 - p0);
+			float a = linalg::length(n);
+
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+		centroids[c] = area > 0.0f ? centroid / area : float3{ 0.0f };
+		normals[c] = linalg::length2(normal) > 0.0f ? linalg::normalize(normal) : float3{ 0.0f };
+	}
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	for (size_t c = 0; c + 1 < clusters.size(); c++) {
+		float key = linalg::dot(centroids[c] - meshCentroid, normals[c]);
+		sorted.push_back(Cluster{ clusters[c], clusters[c + 1], key });
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+	std::vector<uint32_t> output;
+	output.reserve(triCount * 3);
+	for (auto& c : sorted) {
+		output.insert(output.end(), indices + c.start * 3, indices + c.end * 3);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+size_t optimizeVertexFetch(Vertex* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	constexpr uint32_t Unused = ~0u;
+
+	std::vector<uint32_t> remap(vertexCount, Unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t& r = remap[indices[i]];
+		if (r == Unused) r = next++;
+		indices[i] = r;
+	}
+
+	std::vector<Vertex> reordered(next);
+	for (size_t v = 0; v < vertexCount; v++) {
+		if (remap[v] != Unused) reordered[remap[v]] = vertices[v];
+	}
+	std::copy(reordered.begin(), reordered.end(), vertices);
+	return next;
+}
+
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+	optimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+	vertices.resize(optimizeVertexFetch(vertices.data(), indices.data(), indices.size(), vertices.size()));
+}
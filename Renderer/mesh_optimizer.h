@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+struct VertexCacheStats {
+	float acmr{ 0.0f }; // average cache miss ratio, transformed vertices per triangle
+	float atvr{ 0.0f }; // average transform to vertex ratio, 1.0 is optimal
+};
+
+// Simulates a FIFO post-transform cache of cacheSize entries.
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm).
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Splits cache-optimized triangles into clusters and sorts them outside-in so
+// that occluders tend to be drawn first. threshold bounds the ACMR loss (1.05 = 5%).
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold = 1.05f);
+
+// Reorders vertices into first-use order, drops unreferenced ones and remaps
+// the indices. Returns the new vertex count.
+size_t optimizeVertexFetch(Vertex* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Runs all of the above in order. Deterministic.
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
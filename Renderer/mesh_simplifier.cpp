@@ -0,0 +1,288 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+#include "mesh_optimizer.h"
+
+struct Quadric {
+	double a00{ 0 }, a01{ 0 }, a02{ 0 }, a11{ 0 }, a12{ 0 }, a22{ 0 };
+	double b0{ 0 }, b1{ 0 }, b2{ 0 }, c{ 0 };
+	double weight{ 0 };
+
+	// Squared distance to the plane n.x + d = 0, scaled by weight.
+	void addPlane(float3 n, float d, double weight) {
+		this->weight += weight;
+		a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z;
+		a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a22 += weight * n.z * n.z;
+		b0 += weight * n.x * d; b1 += weight * n.y * d; b2 += weight * n.z * d;
+		c += weight * d * d;
+	}
+
+	Quadric& operator +=(const Quadric& o) {
+		a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+		b0 += o.b0; b1 += o.b1; b2 += o.b2; c += o.c;
+		weight += o.weight;
+		return *this;
+	}
+
+	// Weighted mean of the squared plane distances, in model units squared.
+	double evaluate(float3 p) const {
+		if (weight <= 0.0) return 0.0;
+		double x = p.x, y = p.y, z = p.z;
+		double r = a00 * x * x + a11 * y * y + a22 * z * z
+			+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+			+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		return std::max(r / weight, 0.0);
+	}
+};
+
+struct Collapse {
+	double cost;
+	uint32_t source, target;
+};
+
+static float3 triangleNormal(float3 p0, float3 p1, float3 p2) {
+	return linalg::cross(p1 - p0, p2 - p0);
+}
+
+std::vector<uint32_t> simplifyMesh(
+	const Vertex* vertices, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount,
+	size_t targetIndexCount, float targetError,
+	float* resultError
+) {
+	std::vector<uint32_t> result(indices, indices + indexCount);
+	if (resultError) *resultError = 0.0f;
+	if (indexCount <= targetIndexCount || vertexCount == 0) return result;
+
+	float3 bmin = vertices[0].position, bmax = vertices[0].position;
+	for (size_t v = 1; v < vertexCount; v++) {
+		bmin = linalg::min(bmin, vertices[v].position);
+		bmax = linalg::max(bmax, vertices[v].position);
+	}
+	const double extent = linalg::maxelem(bmax - bmin);
+	if (extent <= 0.0) return result;
+
+	const double maxError = double(targetError) * extent;
+	const double maxCost = maxError * maxError;
+
+	auto position = [&](uint32_t v) { return vertices[v].position; };
+
+	// vertices sharing a position with another one sit on an attribute seam
+	std::vector<uint32_t> canonical(vertexCount), groupSize(vertexCount, 0);
+	{
+		std::unordered_map<float3, uint32_t> groups;
+		groups.reserve(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) {
+			canonical[v] = groups.try_emplace(vertices[v].position, uint32_t(v)).first->second;
+			groupSize[canonical[v]]++;
+		}
+	}
+
+	// open edges in position space are borders
+	std::vector<uint8_t> border(vertexCount, 0);
+	{
+		std::unordered_map<uint64_t, uint32_t> edges;
+		edges.reserve(indexCount);
+		for (size_t i = 0; i < indexCount; i += 3) {
+			for (int k = 0; k < 3; k++) {
+				uint32_t a = canonical[result[i + k]], b = canonical[result[i + (k + 1) % 3]];
+				uint64_t key = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+				edges[key]++;
+			}
+		}
+		for (auto& [key, count] : edges) {
+			if (count == 1) {
+				border[key >> 32] = 1;
+				border[key & 0xFFFFFFFF] = 1;
+			}
+		}
+	}
+
+	std::vector<uint8_t> locked(vertexCount, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		uint32_t c = canonical[v];
+		locked[v] = groupSize[c] > 1 || border[c];
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < indexCount; i += 3) {
+		float3 p0 = position(result[i]), p1 = position(result[i + 1]), p2 = position(result[i + 2]);
+		float3 n = triangleNormal(p0, p1, p2);
+		float area = linalg::length(n);
+		if (area <= 0.0f) continue;
+
+		n /= area;
+		float d = -linalg::dot(n, p0);
+		for (int k = 0; k < 3; k++) quadrics[result[i + k]].addPlane(n, d, area);
+	}
+
+	std::vector<uint32_t> remap(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) remap[v] = uint32_t(v);
+
+	std::vector<uint32_t> offsets(vertexCount + 1), adjacency;
+	std::vector<Collapse> best(vertexCount), candidates;
+	std::vector<uint8_t> dirty(vertexCount);
+	std::vector<uint32_t> neighborsU, neighborsV;
+
+	auto gatherNeighbors = [&](uint32_t v, std::vector<uint32_t>& out) {
+		out.clear();
+		for (uint32_t a = offsets[v]; a < offsets[v + 1]; a++) {
+			const uint32_t* tri = &result[adjacency[a] * 3];
+			for (int k = 0; k < 3; k++) {
+				if (tri[k] != v) out.push_back(tri[k]);
+			}
+		}
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	};
+
+	// rejects collapses that flip a triangle or pinch the surface into a non-manifold
+	auto canCollapse = [&](uint32_t u, uint32_t v) {
+		uint32_t shared = 0;
+		for (uint32_t a = offsets[u]; a < offsets[u + 1]; a++) {
+			const uint32_t* tri = &result[adjacency[a] * 3];
+			if (tri[0] == v || tri[1] == v || tri[2] == v) {
+				shared++;
+				continue;
+			}
+
+			float3 p[3], q[3];
+			for (int k = 0; k < 3; k++) {
+				p[k] = position(tri[k]);
+				q[k] = tri[k] == u ? position(v) : p[k];
+			}
+			if (linalg::dot(triangleNormal(p[0], p[1], p[2]), triangleNormal(q[0], q[1], q[2])) <= 0.0f) return false;
+		}
+
+		gatherNeighbors(u, neighborsU);
+		gatherNeighbors(v, neighborsV);
+		size_t common = 0;
+		for (size_t i = 0, j = 0; i < neighborsU.size() && j < neighborsV.size();) {
+			if (neighborsU[i] < neighborsV[j]) i++;
+			else if (neighborsU[i] > neighborsV[j]) j++;
+			else { common++; i++; j++; }
+		}
+		return shared > 0 && common <= shared;
+	};
+
+	double errorReached = 0.0;
+	while (result.size() > targetIndexCount) {
+		const size_t triCount = result.size() / 3;
+
+		// vertex -> triangle adjacency for this pass
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t v : result) offsets[v + 1]++;
+		for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+		adjacency.resize(result.size());
+		{
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < result.size(); i++) adjacency[fill[result[i]]++] = uint32_t(i / 3);
+		}
+
+		// cheapest collapse per source vertex
+		std::fill(best.begin(), best.end(), Collapse{ std::numeric_limits<double>::max(), 0, ~0u });
+		for (size_t t = 0; t < triCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				uint32_t u = result[t * 3 + k];
+				if (locked[u]) continue;
+
+				for (int e = 1; e < 3; e++) {
+					uint32_t v = result[t * 3 + (k + e) % 3];
+					double cost = quadrics[u].evaluate(position(v));
+					if (cost < best[u].cost || (cost == best[u].cost && v < best[u].target)) {
+						best[u] = Collapse{ cost, u, v };
+					}
+				}
+			}
+		}
+
+		candidates.clear();
+		for (size_t v = 0; v < vertexCount; v++) {
+			if (best[v].target != ~0u && best[v].cost <= maxCost) candidates.push_back(best[v]);
+		}
+		if (candidates.empty()) break;
+
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) {
+			return a.cost < b.cost || (a.cost == b.cost && a.source < b.source);
+		});
+
+		std::fill(dirty.begin(), dirty.end(), 0);
+		const size_t needed = result.size() - targetIndexCount;
+		size_t removed = 0;
+		bool collapsed = false;
+
+		for (auto& c : candidates) {
+			uint32_t u = c.source, v = c.target;
+			if (dirty[u] || dirty[v] || !canCollapse(u, v)) continue;
+
+			remap[u] = v;
+			quadrics[v] += quadrics[u];
+			errorReached = std::max(errorReached, c.cost);
+			collapsed = true;
+
+			for (uint32_t a = offsets[u]; a < offsets[u + 1]; a++) {
+				const uint32_t* tri = &result[adjacency[a] * 3];
+				if (tri[0] == v || tri[1] == v || tri[2] == v) removed += 3;
+				for (int k = 0; k < 3; k++) dirty[tri[k]] = 1;
+			}
+
+			if (removed >= needed) break;
+		}
+		if (!collapsed) break;
+
+		size_t write = 0;
+		for (size_t t = 0; t < triCount; t++) {
+			uint32_t a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+			if (a == b || b == c || a == c) continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+
+		for (size_t v = 0; v < vertexCount; v++) remap[v] = uint32_t(v);
+	}
+
+	if (resultError) *resultError = float(std::sqrt(errorReached) / extent);
+	return result;
+}
+
+std::vector<MeshLod> buildLodChain(
+	const std::vector<Vertex>& vertices,
+	std::vector<uint32_t>& indices,
+	bool optimize,
+	float maxError
+) {
+	const size_t baseCount = indices.size();
+
+	std::vector<MeshLod> lods;
+	lods.push_back(MeshLod{ 0, uint32_t(baseCount), 0.0f });
+
+	size_t target = baseCount;
+	while (lods.size() < MaxMeshLods) {
+		target = (target / 6) * 3;
+		if (target < 3 * 8) break;
+
+		float error = 0.0f;
+		auto lod = simplifyMesh(vertices.data(), vertices.size(), indices.data(), baseCount, target, maxError, &error);
+
+		// not worth a level of its own
+		if (lod.empty() || lod.size() > lods.back().indexCount * 9 / 10) break;
+
+		if (optimize) optimizeVertexCache(lod.data(), lod.size(), vertices.size());
+
+		MeshLod range{};
+		range.indexOffset = uint32_t(indices.size());
+		range.indexCount = uint32_t(lod.size());
+		range.error = std::max(error, lods.back().error);
+		lods.push_back(range);
+
+		indices.insert(indices.end(), lod.begin(), lod.end());
+		target = lod.size();
+	}
+	return lods;
+}
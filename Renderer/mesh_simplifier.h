@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Quadric error edge-collapse simplification. Vertices are only ever collapsed
+// onto other existing vertices, so the result indexes the same vertex buffer.
+// Attribute seams and open borders are kept in place.
+//
+// Stops at targetIndexCount or once the next collapse would move the surface by
+// more than targetError (relative to the mesh extent). The error reached is
+// written to resultError when given.
+std::vector<uint32_t> simplifyMesh(
+	const Vertex* vertices, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount,
+	size_t targetIndexCount, float targetError,
+	float* resultError = nullptr
+);
+
+// Appends progressively coarser index ranges (each about half of the previous one)
+// to indices and returns the LOD table, with the original range as LOD 0. Every
+// level is simplified from LOD 0 so its error is relative to the full mesh.
+std::vector<MeshLod> buildLodChain(
+	const std::vector<Vertex>& vertices,
+	std::vector<uint32_t>& indices,
+	bool optimize,
+	float maxError = 0.05f
+);
@@ -0,0 +1,216 @@
+#include "mip_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// Levels with fewer texels than this are filtered on the calling thread.
+constexpr size_t MinParallelTexels = 256 * 256;
+
+// Kaiser window: radius in destination texels and shape.
+constexpr float KaiserWidth = 3.0f;
+constexpr float KaiserAlpha = 4.0f;
+
+constexpr float Pi = 3.14159265358979f;
+
+struct FilterTaps {
+	uint32_t first{ 0 }, count{ 0 };
+	float weights[16]; // radius is capped to fit
+};
+
+static float besselI0(float x) {
+	float sum = 1.0f, term = 1.0f, halfX = x * 0.5f;
+	for (int k = 1; k < 16; k++) {
+		term *= (halfX / k) * (halfX / k);
+		sum += term;
+	}
+	return sum;
+}
+
+static float kaiser(float x) {
+	float t = x / KaiserWidth;
+	if (std::abs(t) >= 1.0f) return 0.0f;
+
+	float sinc = std::abs(x) < 1e-5f ? 1.0f : std::sin(Pi * x) / (Pi * x);
+	return sinc * besselI0(KaiserAlpha * std::sqrt(1.0f - t * t)) / besselI0(KaiserAlpha);
+}
+
+// Source texels and weights for every destination texel along one axis.
+// Out of range texels clamp to the edge.
+static std::vector<FilterTaps> buildTaps(uint32_t srcSize, uint32_t dstSize, MipFilter filter) {
+	std::vector<FilterTaps> taps(dstSize);
+	float scale = float(srcSize) / float(dstSize);
+	float radius = filter == MipFilter::Kaiser ? KaiserWidth * scale : scale * 0.5f;
+	radius = std::min(radius, 7.0f); // only thin odd sized levels get here
+
+	for (uint32_t x = 0; x < dstSize; x++) {
+		FilterTaps& t = taps[x];
+		float center = (float(x) + 0.5f) * scale;
+		int begin = int(std::floor(center - radius));
+		int last = int(std::ceil(center + radius)) - 1;
+
+		int lo = std::max(begin, 0), hi = std::min(last, int(srcSize) - 1);
+		t.first = uint32_t(lo);
+		t.count = uint32_t(hi - lo + 1);
+		std::fill_n(t.weights, 16, 0.0f);
+
+		float sum = 0.0f;
+		for (int s = begin; s <= last; s++) {
+			float w;
+			if (filter == MipFilter::Kaiser) {
+				w = kaiser((float(s) + 0.5f - center) / scale);
+			} else {
+				// overlap of the texel with the footprint
+				float a = std::max(float(s), center - radius), b = std::min(float(s + 1), center + radius);
+				w = std::max(b - a, 0.0f);
+			}
+			t.weights[std::clamp(s, lo, hi) - lo] += w;
+			sum += w;
+		}
+		for (uint32_t i = 0; i < t.count; i++) t.weights[i] /= sum;
+	}
+	return taps;
+}
+
+// dst = sum(weights[i] * src[i * stride]) over RGBA float texels.
+static inline void accumulate(const float* src, size_t stride, const FilterTaps& t, float* dst) {
+#ifdef MIP_GENERATOR_SSE2
+	__m128 acc = _mm_setzero_ps();
+	for (uint32_t i = 0; i < t.count; i++) {
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(t.weights[i]), _mm_loadu_ps(src + i * stride)));
+	}
+	_mm_storeu_ps(dst, acc);
+#else
+	float acc[4]{};
+	for (uint32_t i = 0; i < t.count; i++) {
+		for (int c = 0; c < 4; c++) acc[c] += t.weights[i] * src[i * stride + c];
+	}
+	std::copy_n(acc, 4, dst);
+#endif
+}
+
+template <typename Fn>
+static void parallelRows(uint32_t rows, size_t texels, uint32_t threadCount, Fn&& fn) {
+	uint32_t chunkCount = texels < MinParallelTexels ? 1 : std::clamp(threadCount, 1u, rows);
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < chunkCount; i++) {
+		workers.emplace_back(fn, rows * i / chunkCount, rows * (i + 1) / chunkCount);
+	}
+	fn(0u, rows / chunkCount);
+	for (auto& w : workers) w.join();
+}
+
+static void downsample(
+	const float* src, uint32_t sw, uint32_t sh,
+	float* dst, uint32_t dw, uint32_t dh,
+	MipFilter filter, std::vector<float>& scratch, uint32_t threadCount
+) {
+	auto horizontal = buildTaps(sw, dw, filter);
+	auto vertical = buildTaps(sh, dh, filter);
+
+	// rows first into scratch (dw x sh), then columns into dst
+	scratch.resize(size_t(dw) * sh * 4);
+	float* tmp = scratch.data();
+
+	parallelRows(sh, size_t(dw) * sh, threadCount, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t y = begin; y < end; y++) {
+			const float* row = src + size_t(y) * sw * 4;
+			for (uint32_t x = 0; x < dw; x++) {
+				const FilterTaps& t = horizontal[x];
+				accumulate(row + t.first * 4, 4, t, tmp + (size_t(y) * dw + x) * 4);
+			}
+		}
+	});
+
+	parallelRows(dh, size_t(dw) * dh, threadCount, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t y = begin; y < end; y++) {
+			const FilterTaps& t = vertical[y];
+			const float* column = tmp + size_t(t.first) * dw * 4;
+			for (uint32_t x = 0; x < dw; x++) {
+				accumulate(column + x * 4, size_t(dw) * 4, t, dst + (size_t(y) * dw + x) * 4);
+			}
+		}
+	});
+}
+
+struct ColorTables {
+	float toLinear[256];
+	float encodeThreshold[255]; // midpoints between the decoded values
+	uint8_t encodeGuess[1024]; // starting code for v * 1023
+};
+
+static const ColorTables& colorTables() {
+	static const ColorTables tables = []() {
+		ColorTables t{};
+		for (int i = 0; i < 256; i++) {
+			float c = i / 255.0f;
+			t.toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 255; i++) t.encodeThreshold[i] = (t.toLinear[i] + t.toLinear[i + 1]) * 0.5f;
+		for (int i = 0; i < 1024; i++) {
+			const float* pos = std::upper_bound(t.encodeThreshold, t.encodeThreshold + 255, i / 1023.0f);
+			t.encodeGuess[i] = uint8_t(pos - t.encodeThreshold);
+		}
+		return t;
+	}();
+	return tables;
+}
+
+static void encodeLevel(const float* src, size_t texels, bool srgb, uint8_t* dst) {
+	const ColorTables& tables = colorTables();
+	for (size_t i = 0; i < texels * 4; i++) {
+		float v = std::clamp(src[i], 0.0f, 1.0f); // Kaiser lobes can overshoot
+		if (srgb && (i & 3) != 3) {
+			// nearest code in linear space, the guess is at most a few codes off
+			int code = tables.encodeGuess[int(v * 1023.0f)];
+			while (code < 255 && v >= tables.encodeThreshold[code]) code++;
+			while (code > 0 && v < tables.encodeThreshold[code - 1]) code--;
+			dst[i] = uint8_t(code);
+		} else {
+			dst[i] = uint8_t(v * 255.0f + 0.5f);
+		}
+	}
+}
+
+std::vector<MipLevel> generateMipChain(
+	const uint8_t* rgba, uint32_t width, uint32_t height,
+	MipFilter filter, bool srgb,
+	std::vector<uint8_t>& pixels,
+	uint32_t threadCount
+) {
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<MipLevel> levels;
+	size_t total = 0;
+	for (uint32_t w = width, h = height;; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u)) {
+		levels.push_back(MipLevel{ total, w, h });
+		total += size_t(w) * h * 4;
+		if (w == 1 && h == 1) break;
+	}
+
+	pixels.resize(total);
+	std::copy_n(rgba, size_t(width) * height * 4, pixels.data());
+
+	const ColorTables& tables = colorTables();
+	std::vector<float> current(size_t(width) * height * 4), next, scratch;
+	for (size_t i = 0; i < current.size(); i++) {
+		current[i] = srgb && (i & 3) != 3 ? tables.toLinear[rgba[i]] : rgba[i] / 255.0f;
+	}
+
+	for (size_t level = 1; level < levels.size(); level++) {
+		const MipLevel& src = levels[level - 1];
+		const MipLevel& dst = levels[level];
+
+		next.resize(size_t(dst.width) * dst.height * 4);
+		downsample(current.data(), src.width, src.height, next.data(), dst.width, dst.height, filter, scratch, threadCount);
+		encodeLevel(next.data(), size_t(dst.width) * dst.height, srgb, pixels.data() + dst.offset);
+		std::swap(current, next);
+	}
+	return levels;
+}
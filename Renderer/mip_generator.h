@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class MipFilter {
+	Box = 0, // area average
+	Kaiser // Kaiser windowed sinc, keeps more detail in the smaller levels
+};
+
+struct MipLevel {
+	size_t offset{ 0 }; // into the chain
+	uint32_t width{ 0 }, height{ 0 };
+};
+
+// Builds the full mip chain of an RGBA8 image (GL level sizes, down to 1x1)
+// into pixels, level after level. Each level is filtered from the previous one
+// in float. With srgb the colour channels are filtered in linear space and
+// encoded back, alpha is always linear. Rows are split over threadCount
+// threads (0 = hardware concurrency).
+std::vector<MipLevel> generateMipChain(
+	const uint8_t* rgba, uint32_t width, uint32_t height,
+	MipFilter filter, bool srgb,
+	std::vector<uint8_t>& pixels,
+	uint32_t threadCount = 0
+);
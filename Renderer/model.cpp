@@ -0,0 +1,232 @@
+#include "model.h"
+
+#include <atomic>
+#include <map>
+#include <thread>
+
+#include "aixlog.hpp"
+#include "stb_image.h"
+#include "mesh_optimizer.h"
+#include "mip_generator.h"
+#include "tangent_generator.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+static const std::pair<Material::Slot, aiTextureType> TextureSlots[] = {
+	{ Material::SlotDiffuse, aiTextureType_DIFFUSE },
+	{ Material::SlotSpecular, aiTextureType_SPECULAR },
+	{ Material::SlotNormals, aiTextureType_NORMALS },
+	{ Material::SlotEmission, aiTextureType_EMISSIVE }
+};
+
+// One texture file referenced by the scene, decoded with its mip chain off the GL thread.
+struct TextureSource {
+	std::string key;
+	const aiTexture* embedded{ nullptr };
+	bool srgb{ false };
+	std::vector<uint8_t> pixels;
+	std::vector<MipLevel> levels;
+};
+
+static void decodeTexture(const std::string& directory, TextureSource& src) {
+	int w, h, comp;
+	uint8_t* pixels = nullptr;
+	if (src.embedded) {
+		if (src.embedded->mHeight == 0) {
+			pixels = stbi_load_from_memory(
+				reinterpret_cast<const stbi_uc*>(src.embedded->pcData), int(src.embedded->mWidth),
+				&w, &h, &comp, 4
+			);
+		}
+	} else {
+		pixels = stbi_load((directory + src.key).c_str(), &w, &h, &comp, 4);
+	}
+	if (!pixels) return;
+
+	src.levels = generateMipChain(pixels, w, h, MipFilter::Kaiser, src.srgb, src.pixels, 1);
+	stbi_image_free(pixels);
+}
+
+static Texture createTexture(const TextureSource& src) {
+	Texture tex{};
+	tex.create(TextureTarget::Texture2D);
+	tex.bind();
+	tex.allocate(TextureFormat::RGBA, src.levels[0].width, src.levels[0].height, uint32_t(src.levels.size()));
+	for (size_t i = 0; i < src.levels.size(); i++) {
+		const MipLevel& level = src.levels[i];
+		tex.updateRegion(TextureFormat::RGBA, src.pixels.data() + level.offset, 0, 0, level.width, level.height, uint32_t(i));
+	}
+	tex.setWrap(TextureWrap::Repeat, TextureWrap::Repeat);
+	tex.setFilter(TextureFilter::LinearMipLinear, TextureFilter::Linear);
+	return tex;
+}
+
+static void collectSubMeshes(
+	const aiNode* node, float4x4 parent,
+	const std::vector<SubMesh>& parts,
+	std::vector<SubMesh>& out
+) {
+	float4x4 transform = linalg::mul(parent, convertMat(node->mTransformation));
+	for (size_t i = 0; i < node->mNumMeshes; i++) {
+		SubMesh sub = parts[node->mMeshes[i]];
+		if (sub.indexCount == 0) continue;
+
+		sub.transform = transform;
+		out.push_back(sub);
+	}
+	for (size_t i = 0; i < node->mNumChildren; i++) {
+		collectSubMeshes(node->mChildren[i], transform, parts, out);
+	}
+}
+
+void Model::import(const std::string& fileName, uint32_t flags, VertexFormat format) {
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(
+		fileName,
+		aiProcess_Triangulate |
+		aiProcess_FlipUVs |
+		aiProcess_JoinIdenticalVertices |
+		aiProcess_SortByPType
+	);
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		LOG(ERROR) << "ERROR::ASSIMP::" << importer.GetErrorString() << "\n";
+		return;
+	}
+
+	std::string directory = "";
+	size_t slash = fileName.find_last_of("/\\");
+	if (slash != std::string::npos) directory = fileName.substr(0, slash + 1);
+
+	// materials, textures are loaded once per path
+	struct TextureRef { size_t material; Material::Slot slot; size_t source; };
+	std::vector<TextureSource> sources;
+	std::vector<TextureRef> refs;
+	std::map<std::string, size_t> textureIndices;
+
+	m_materials.resize(std::max(scene->mNumMaterials, 1u));
+	for (size_t i = 0; i < scene->mNumMaterials; i++) {
+		const aiMaterial* mat = scene->mMaterials[i];
+		Material& dst = m_materials[i];
+
+		aiColor4D diffuse;
+		if (mat->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse) == AI_SUCCESS) {
+			dst.diffuse = float4{ diffuse.r, diffuse.g, diffuse.b, diffuse.a };
+		}
+
+		for (auto [slot, type] : TextureSlots) {
+			aiString path;
+			if (mat->GetTexture(type, 0, &path) != AI_SUCCESS) continue;
+
+			std::string key = path.C_Str();
+			auto pos = textureIndices.find(key);
+			if (pos == textureIndices.end()) {
+				TextureSource src{};
+				src.key = key;
+				src.embedded = scene->GetEmbeddedTexture(path.C_Str());
+				src.srgb = slot == Material::SlotDiffuse || slot == Material::SlotEmission;
+				pos = textureIndices.emplace(key, sources.size()).first;
+				sources.push_back(std::move(src));
+			}
+			refs.push_back(TextureRef{ i, slot, pos->second });
+		}
+	}
+
+	// decode and build the mip chains of all images in parallel
+	{
+		std::atomic<size_t> next{ 0 };
+		auto decodeAll = [&]() {
+			for (size_t i = next++; i < sources.size(); i = next++) decodeTexture(directory, sources[i]);
+		};
+
+		size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), sources.size());
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < threadCount; i++) workers.emplace_back(decodeAll);
+		decodeAll();
+		for (auto& w : workers) w.join();
+	}
+
+	std::vector<Texture> created(sources.size());
+	for (size_t i = 0; i < sources.size(); i++) {
+		if (sources[i].levels.empty()) {
+			LOG(WARNING) << "Failed to load texture " << sources[i].key << " for " << fileName << "\n";
+			continue;
+		}
+		created[i] = createTexture(sources[i]);
+		m_textures.push_back(created[i]);
+	}
+	for (auto& ref : refs) {
+		if (created[ref.source].valid()) m_materials[ref.material].textures[ref.slot] = created[ref.source];
+	}
+
+	// geometry, one range per aiMesh
+	std::vector<Vertex> verts;
+	std::vector<uint32_t> inds;
+	std::vector<SubMesh> parts(scene->mNumMeshes);
+
+	for (size_t m = 0; m < scene->mNumMeshes; m++) {
+		const aiMesh* mesh = scene->mMeshes[m];
+		if (!(mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE)) continue;
+
+		std::vector<Vertex> partVerts(mesh->mNumVertices);
+		std::vector<uint32_t> partInds;
+		partInds.reserve(size_t(mesh->mNumFaces) * 3);
+
+		for (size_t j = 0; j < mesh->mNumVertices; j++) {
+			Vertex& vert = partVerts[j];
+
+			aiVector3D pos = mesh->mVertices[j];
+			vert.position = float3{ pos.x, pos.y, pos.z };
+			if (mesh->mNormals) {
+				aiVector3D nrm = mesh->mNormals[j];
+				vert.normal = float3{ nrm.x, nrm.y, nrm.z };
+			}
+			if (mesh->mTextureCoords[0]) {
+				aiVector3D uv = mesh->mTextureCoords[0][j];
+				vert.texCoord = float2{ uv.x, uv.y };
+			}
+		}
+
+		for (size_t j = 0; j < mesh->mNumFaces; j++) {
+			const aiFace& face = mesh->mFaces[j];
+			if (face.mNumIndices != 3) continue;
+			partInds.insert(partInds.end(), face.mIndices, face.mIndices + 3);
+		}
+
+		generateTangents(partVerts, partInds);
+		if (flags & MeshOptimize) optimizeMesh(partVerts, partInds);
+
+		SubMesh& part = parts[m];
+		part.baseVertex = int32_t(verts.size());
+		part.vertexCount = uint32_t(partVerts.size());
+		part.firstIndex = uint32_t(inds.size());
+		part.indexCount = uint32_t(partInds.size());
+		part.material = mesh->mMaterialIndex < m_materials.size() ? mesh->mMaterialIndex : 0;
+
+		if (!partVerts.empty()) {
+			part.bounds.min = part.bounds.max = partVerts[0].position;
+			for (auto& v : partVerts) {
+				part.bounds.min = linalg::min(part.bounds.min, v.position);
+				part.bounds.max = linalg::max(part.bounds.max, v.position);
+			}
+		}
+
+		verts.insert(verts.end(), partVerts.begin(), partVerts.end());
+		inds.insert(inds.end(), partInds.begin(), partInds.end());
+	}
+
+	m_subMeshes.clear();
+	collectSubMeshes(scene->mRootNode, linalg::identity, parts, m_subMeshes);
+
+	m_mesh.create(verts.data(), verts.size(), inds.data(), inds.size(), format);
+}
+
+void Model::destroy() {
+	m_mesh.destroy();
+	for (auto& tex : m_textures) tex.destroy();
+	m_textures.clear();
+	m_materials.clear();
+	m_subMeshes.clear();
+}
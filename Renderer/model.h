@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+#include "renderer.h"
+
+// A drawable part of a model. Indices are relative to baseVertex, so every
+// range can be drawn with glDrawElementsBaseVertex on the shared buffers.
+struct SubMesh {
+	int32_t baseVertex{ 0 };
+	uint32_t vertexCount{ 0 };
+	uint32_t firstIndex{ 0 }, indexCount{ 0 };
+	uint32_t material{ 0 }; // index into Model::materials()
+	float4x4 transform{ linalg::identity }; // node transform relative to the model root
+	AABB bounds{};
+};
+
+// Every mesh of an imported scene packed into one vertex/index buffer (one VAO),
+// with one SubMesh per node reference and one Material per scene material.
+class Model {
+public:
+	// Supported flags: MeshOptimize (per part).
+	void import(const std::string& fileName, uint32_t flags = MeshDefaultFlags, VertexFormat format = VertexFormat::Full);
+	void destroy();
+
+	Mesh& mesh() { return m_mesh; }
+	const std::vector<SubMesh>& subMeshes() const { return m_subMeshes; }
+	std::vector<Material>& materials() { return m_materials; }
+
+private:
+	Mesh m_mesh{};
+	std::vector<SubMesh> m_subMeshes;
+	std::vector<Material> m_materials;
+	std::vector<Texture> m_textures; // owned, shared between materials
+};
@@ -0,0 +1,238 @@
+#include "obj_parser.h"
+
+#include <charconv>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+
+#include "aixlog.hpp"
+
+// Chunks smaller than this are not worth a thread of their own.
+constexpr size_t MinChunkSize = 256 * 1024;
+
+struct ObjCorner {
+	int3 vtn;
+	uint8_t relative; // bit n set when vtn[n] is relative to the owning chunk
+};
+
+struct ObjChunk {
+	const char* begin{ nullptr };
+	const char* end{ nullptr };
+
+	ObjData data;
+	std::vector<uint8_t> relative; // one mask per face corner
+
+	size_t basePosition{ 0 }, baseTexCoord{ 0 }, baseNormal{ 0 }, baseFace{ 0 };
+	const char* error{ nullptr };
+};
+
+static inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static inline const char* skipBlank(const char* p, const char* end) {
+	while (p < end && isBlank(*p)) p++;
+	return p;
+}
+
+static inline const char* skipLine(const char* p, const char* end) {
+	const char* nl = static_cast<const char*>(::memchr(p, '\n', end - p));
+	return nl ? nl + 1 : end;
+}
+
+static const char* parseFloat(const char* p, const char* end, float& v) {
+	p = skipBlank(p, end);
+	if (p < end && *p == '+') p++;
+	auto [ptr, ec] = std::from_chars(p, end, v);
+	if (ec == std::errc::result_out_of_range) v = 0.0f;
+	else if (ec != std::errc()) return nullptr;
+	return ptr;
+}
+
+static const char* parseIndex(const char* p, const char* end, int& v) {
+	if (p < end && *p == '+') p++;
+	auto [ptr, ec] = std::from_chars(p, end, v);
+	return ec == std::errc() && v != 0 ? ptr : nullptr;
+}
+
+// Positive indices are absolute, negative ones count back from the last element
+// seen so far. Since a chunk does not know how many elements precede it, those are
+// stored relative to the chunk and rebased on merge.
+static inline void resolveIndex(int raw, size_t localCount, int& out, uint8_t& relative, uint8_t bit) {
+	if (raw > 0) {
+		out = raw - 1;
+	} else {
+		out = int(localCount) + raw;
+		relative |= bit;
+	}
+}
+
+static const char* parseCorner(const char* p, const char* end, const ObjData& data, ObjCorner& corner) {
+	int raw;
+	corner.vtn = int3{ -1, -1, -1 };
+	corner.relative = 0;
+
+	// there are 4 forms: v | v/vt | v//vn | v/vt/vn
+	if (!(p = parseIndex(p, end, raw))) return nullptr;
+	resolveIndex(raw, data.positions.size(), corner.vtn[0], corner.relative, 1);
+
+	if (p < end && *p == '/') {
+		p++;
+		if (p < end && *p != '/') {
+			if (!(p = parseIndex(p, end, raw))) return nullptr;
+			resolveIndex(raw, data.texCoords.size(), corner.vtn[1], corner.relative, 2);
+		}
+		if (p < end && *p == '/') {
+			p++;
+			if (!(p = parseIndex(p, end, raw))) return nullptr;
+			resolveIndex(raw, data.normals.size(), corner.vtn[2], corner.relative, 4);
+		}
+	}
+	return (p == end || isBlank(*p) || *p == '\n') ? p : nullptr;
+}
+
+static void parseChunk(ObjChunk& chunk) {
+	const char* p = chunk.begin;
+	const char* end = chunk.end;
+	ObjData& data = chunk.data;
+
+	std::vector<ObjCorner> corners;
+	corners.reserve(8);
+
+	while (p < end) {
+		p = skipBlank(p, end);
+		if (p >= end) break;
+
+		const char* line = p;
+		char c = *p;
+		char sub = p + 1 < end ? p[1] : '\n';
+
+		if (c == 'v' && (isBlank(sub) || sub == 't' || sub == 'n')) {
+			p += isBlank(sub) ? 1 : 2;
+
+			float3 v{ 0.0f };
+			size_t n = sub == 't' ? 2 : 3;
+			for (size_t i = 0; i < n && p; i++) {
+				p = parseFloat(p, end, v[i]);
+			}
+
+			if (!p) {
+				chunk.error = line;
+				return;
+			}
+
+			if (sub == 't') data.texCoords.push_back(float2{ v.x, v.y });
+			else if (sub == 'n') data.normals.push_back(v);
+			else data.positions.push_back(v);
+		} else if (c == 'f' && isBlank(sub)) {
+			p++;
+			corners.clear();
+
+			while (true) {
+				p = skipBlank(p, end);
+				if (p >= end || *p == '\n' || *p == '#') break;
+
+				ObjCorner corner;
+				if (!(p = parseCorner(p, end, data, corner))) {
+					chunk.error = line;
+					return;
+				}
+				corners.push_back(corner);
+			}
+
+			// triangulate quads and n-gons as a fan around the first corner
+			for (size_t i = 1; i + 1 < corners.size(); i++) {
+				for (size_t k : { size_t(0), i, i + 1 }) {
+					data.faces.push_back(corners[k].vtn);
+					chunk.relative.push_back(corners[k].relative);
+				}
+			}
+		}
+
+		p = skipLine(p, end);
+	}
+}
+
+// Rebases chunk-relative indices and validates every corner against the merged arrays.
+static bool mergeChunk(ObjChunk& chunk, ObjData& out) {
+	const int3 base{ int(chunk.basePosition), int(chunk.baseTexCoord), int(chunk.baseNormal) };
+	const int3 limit{ int(out.positions.size()), int(out.texCoords.size()), int(out.normals.size()) };
+
+	std::copy(chunk.data.positions.begin(), chunk.data.positions.end(), out.positions.begin() + chunk.basePosition);
+	std::copy(chunk.data.texCoords.begin(), chunk.data.texCoords.end(), out.texCoords.begin() + chunk.baseTexCoord);
+	std::copy(chunk.data.normals.begin(), chunk.data.normals.end(), out.normals.begin() + chunk.baseNormal);
+
+	int3* dst = out.faces.data() + chunk.baseFace;
+	for (size_t i = 0; i < chunk.data.faces.size(); i++) {
+		int3 vtn = chunk.data.faces[i];
+		uint8_t rel = chunk.relative[i];
+
+		for (int k = 0; k < 3; k++) {
+			if (rel & (1 << k)) vtn[k] += base[k];
+			else if (k > 0 && vtn[k] == -1) continue;
+
+			if (vtn[k] < 0 || vtn[k] >= limit[k]) return false;
+		}
+		dst[i] = vtn;
+	}
+	return true;
+}
+
+bool parseObj(const char* data, size_t size, ObjData& out, uint32_t threadCount) {
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	size_t chunkCount = std::clamp<size_t>(size / MinChunkSize, 1, threadCount);
+	std::vector<ObjChunk> chunks(chunkCount);
+
+	// split at line boundaries
+	const char* end = data + size;
+	const char* begin = data;
+	for (size_t i = 0; i < chunkCount; i++) {
+		const char* split = i + 1 == chunkCount ? end : data + (size * (i + 1)) / chunkCount;
+		split = split < begin ? begin : skipLine(split, end);
+		chunks[i].begin = begin;
+		chunks[i].end = split;
+		begin = split;
+	}
+
+	auto runParallel = [&](auto&& fn) {
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < chunkCount; i++) {
+			workers.emplace_back(fn, i);
+		}
+		fn(0);
+		for (auto& w : workers) w.join();
+	};
+
+	runParallel([&](size_t i) { parseChunk(chunks[i]); });
+
+	size_t positions = 0, texCoords = 0, normals = 0, faces = 0;
+	for (auto& chunk : chunks) {
+		if (chunk.error) {
+			const char* lineEnd = skipLine(chunk.error, end);
+			LOG(ERROR) << "Malformed OBJ line: " << std::string(chunk.error, lineEnd - chunk.error) << "\n";
+			return false;
+		}
+
+		chunk.basePosition = positions;
+		chunk.baseTexCoord = texCoords;
+		chunk.baseNormal = normals;
+		chunk.baseFace = faces;
+		positions += chunk.data.positions.size();
+		texCoords += chunk.data.texCoords.size();
+		normals += chunk.data.normals.size();
+		faces += chunk.data.faces.size();
+	}
+
+	out.positions.resize(positions);
+	out.texCoords.resize(texCoords);
+	out.normals.resize(normals);
+	out.faces.resize(faces);
+
+	std::vector<uint8_t> valid(chunkCount, 0);
+	runParallel([&](size_t i) { valid[i] = mergeChunk(chunks[i], out); });
+
+	if (std::find(valid.begin(), valid.end(), 0) != valid.end()) {
+		LOG(ERROR) << "OBJ face references an undefined vertex attribute.\n";
+		return false;
+	}
+	return true;
+}
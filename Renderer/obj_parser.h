@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "linalg.h"
+using namespace linalg::aliases;
+
+struct ObjData {
+	std::vector<float3> positions, normals;
+	std::vector<float2> texCoords;
+
+	// Triangulated face corners as (v, vt, vn), zero-based, -1 when absent.
+	std::vector<int3> faces;
+};
+
+// Parses OBJ text in line-aligned chunks on up to threadCount threads
+// (0 = hardware concurrency). Faces of any arity are fan-triangulated.
+bool parseObj(const char* data, size_t size, ObjData& out, uint32_t threadCount = 0);
+
@@ -0,0 +1,91 @@
+#include "pixel_upload_ring.h"
+
+#include <chrono>
+
+void PixelUploadRing::create(uint32_t slotCount, size_t slotSize) {
+	m_slots.resize(slotCount);
+	for (auto& slot : m_slots) {
+		slot.buffer.create(BufferType::PixelUnpackBuffer, BufferUsage::StreamDraw, slotSize);
+	}
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	m_next = 0;
+}
+
+void PixelUploadRing::destroy() {
+	for (auto& slot : m_slots) {
+		if (slot.mapped) {
+			slot.buffer.bind();
+			slot.buffer.unmap();
+		}
+		if (slot.fence) glDeleteSync(slot.fence);
+		slot.buffer.destroy();
+	}
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	m_slots.clear();
+}
+
+PixelStaging PixelUploadRing::acquire(size_t size) {
+	PixelStaging staging{};
+	if (m_slots.empty()) return staging;
+
+	// oldest submission first, if it is not done the newer ones are not either
+	Slot& slot = m_slots[m_next];
+	if (slot.mapped) {
+		m_stats.stalls++;
+		return staging;
+	}
+	if (slot.fence) {
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			m_stats.stalls++;
+			return staging;
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+	}
+
+	if (slot.buffer.size() < size) slot.buffer.allocate(size);
+
+	// the fence already guarantees the GPU is done with this slot
+	void* data = slot.buffer.mapRange(
+		0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+	);
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!data) return staging;
+
+	slot.mapped = true;
+	staging.slot = m_next;
+	staging.data = static_cast<uint8_t*>(data);
+	staging.size = size;
+
+	m_next = (m_next + 1) % uint32_t(m_slots.size());
+	return staging;
+}
+
+void PixelUploadRing::upload(PixelStaging& staging, const PixelRegion* regions, size_t count, Texture& texture) {
+	if (!staging.valid()) return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Slot& slot = m_slots[staging.slot];
+	slot.buffer.bind();
+	slot.buffer.unmap();
+	slot.mapped = false;
+
+	texture.bind();
+	for (size_t i = 0; i < count; i++) {
+		const PixelRegion& r = regions[i];
+		texture.updateRegion(r.format, reinterpret_cast<const void*>(r.offset), r.x, r.y, r.width, r.height, r.level);
+	}
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_stats.bytes += staging.size;
+	m_stats.uploads++;
+	m_stats.submitMs += elapsed.count();
+
+	staging = PixelStaging{};
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "buffer.h"
+#include "texture.h"
+
+// Mapped slot memory handed out by PixelUploadRing::acquire. Any thread may
+// write to data until the staging is passed back to upload.
+struct PixelStaging {
+	uint32_t slot{ ~0u };
+	uint8_t* data{ nullptr };
+	size_t size{ 0 };
+
+	bool valid() const { return data != nullptr; }
+};
+
+struct PixelRegion {
+	size_t offset{ 0 }; // into the staging memory
+	TextureFormat format{ TextureFormat::RGBA };
+	uint32_t x{ 0 }, y{ 0 }, width{ 0 }, height{ 0 };
+	uint32_t level{ 0 };
+};
+
+// Texture data with its mip chain stored level after level.
+struct ImageData {
+	TextureFormat format{ TextureFormat::RGBA };
+	std::vector<uint8_t> pixels;
+	std::vector<PixelRegion> levels;
+
+	size_t levelSize(size_t level) const {
+		const PixelRegion& r = levels[level];
+		return isCompressed(format) ? compressedSize(format, r.width, r.height) : size_t(r.width) * r.height * 4;
+	}
+};
+
+struct PixelUploadStats {
+	uint64_t bytes{ 0 };
+	uint32_t uploads{ 0 };
+	uint32_t stalls{ 0 }; // acquire calls that found every slot in flight
+	double submitMs{ 0.0 }; // GL thread time spent in upload
+};
+
+// Round-robin set of pixel unpack buffers guarded by fences. A slot is only
+// reused once the GPU has finished reading it, so texture uploads never wait
+// on the driver and the CPU copy can happen off the GL thread.
+class PixelUploadRing {
+public:
+	void create(uint32_t slotCount = 4, size_t slotSize = 16 * 1024 * 1024);
+	void destroy();
+	bool valid() const { return !m_slots.empty(); }
+
+	// GL thread. Maps a free slot, grown to size if needed. Returns an invalid
+	// staging when all slots are still in flight.
+	PixelStaging acquire(size_t size);
+
+	// GL thread. Unmaps the staging, copies the regions into the texture
+	// (bound to its target) and fences the slot.
+	void upload(PixelStaging& staging, const PixelRegion* regions, size_t count, Texture& texture);
+
+	const PixelUploadStats& stats() const { return m_stats; }
+	void resetStats() { m_stats = PixelUploadStats{}; }
+
+private:
+	struct Slot {
+		Buffer buffer{};
+		GLsync fence{ nullptr };
+		bool mapped{ false };
+	};
+
+	std::vector<Slot> m_slots;
+	uint32_t m_next{ 0 };
+	PixelUploadStats m_stats{};
+};
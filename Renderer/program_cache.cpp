@@ -0,0 +1,125 @@
+#include "program_cache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "aixlog.hpp"
+#include "hash.h"
+#include "mapped_file.h"
+
+void ProgramCache::setDirectory(const std::string& directory) {
+	m_directory = directory;
+	if (m_directory.empty()) return;
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_directory, ec);
+	if (ec) {
+		LOG(WARNING) << "Could not create program cache directory " << m_directory << ": " << ec.message() << "\n";
+		m_directory.clear();
+	}
+}
+
+bool ProgramCache::enabled() {
+	if (m_directory.empty()) return false;
+	if (m_supported < 0) {
+		GLint formats = 0;
+		if (GLAD_GL_VERSION_4_1) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		m_supported = formats > 0;
+		if (!m_supported) LOG(INFO) << "No program binary formats, shaders are compiled from source\n";
+	}
+	return m_supported > 0;
+}
+
+uint64_t ProgramCache::driverKey() {
+	if (m_driverKey == 0) {
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION }) {
+			auto str = reinterpret_cast<const char*>(glGetString(name));
+			m_driverKey = hashString(str ? str : "", m_driverKey ? m_driverKey : HashSeed);
+		}
+	}
+	return m_driverKey;
+}
+
+std::string ProgramCache::fileName(uint64_t key) const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.rprog", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(m_directory) / name).string();
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key) {
+	if (!enabled()) return false;
+
+	std::string name = fileName(key);
+	MappedFile file;
+	if (!file.open(name)) return false;
+
+	const auto header = reinterpret_cast<const ProgramCacheHeader*>(file.data());
+	if (file.size() < sizeof(ProgramCacheHeader) ||
+		header->magic != ProgramCacheMagic || header->version != ProgramCacheVersion || header->key != key ||
+		file.size() < sizeof(ProgramCacheHeader) + header->binarySize) {
+		return false;
+	}
+
+	glProgramBinary(program, header->binaryFormat, file.data() + sizeof(ProgramCacheHeader), GLsizei(header->binarySize));
+
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		// stale format, relinked from source and written again
+		m_stats.rejected++;
+		file.close();
+		std::error_code ec;
+		std::filesystem::remove(name, ec);
+		return false;
+	}
+	return true;
+}
+
+void ProgramCache::prepare(GLuint program) {
+	if (enabled()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(GLuint program, uint64_t key) {
+	if (!enabled()) return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(static_cast<size_t>(length));
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	ProgramCacheHeader header{};
+	header.magic = ProgramCacheMagic;
+	header.version = ProgramCacheVersion;
+	header.key = key;
+	header.binaryFormat = format;
+	header.binarySize = uint32_t(length);
+
+	std::string name = fileName(key);
+	std::ofstream fp{ name, std::ios::binary | std::ios::trunc };
+	if (!fp.good()) {
+		LOG(WARNING) << "Could not write program cache " << name << "\n";
+		return;
+	}
+	fp.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fp.write(binary.data(), std::streamsize(length));
+}
+
+void ProgramCache::record(bool hit, double ms) {
+	if (hit) {
+		m_stats.hits++;
+		m_stats.loadMs += ms;
+	} else {
+		m_stats.misses++;
+		m_stats.compileMs += ms;
+	}
+}
+
+ProgramCache& programCache() {
+	static ProgramCache cache;
+	return cache;
+}
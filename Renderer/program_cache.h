@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "glad.h"
+
+constexpr uint32_t ProgramCacheMagic = 0x47525052; // "RPRG"
+constexpr uint32_t ProgramCacheVersion = 1;
+
+struct ProgramCacheHeader {
+	uint32_t magic, version;
+	uint64_t key;
+	uint32_t binaryFormat, binarySize;
+};
+
+struct ProgramCacheStats {
+	uint32_t hits{ 0 }, misses{ 0 };
+	uint32_t rejected{ 0 }; // binaries the driver refused, recompiled from source
+	double loadMs{ 0.0 }, compileMs{ 0.0 }; // from ShaderProgram::submit to finish, either way
+};
+
+// Linked program binaries (.rprog), one file per program in a directory. The
+// key covers every stage source and the driver, so a new driver or a changed
+// shader simply misses, and a binary the driver rejects is deleted. Needs GL
+// 4.1 and at least one binary format, otherwise every program is compiled.
+class ProgramCache {
+public:
+	// Empty disables the cache, which is the default. Created if missing.
+	void setDirectory(const std::string& directory);
+	bool enabled();
+
+	// Hash of the vendor, renderer and version strings. GL thread.
+	uint64_t driverKey();
+
+	// True if the program was linked from a cached binary.
+	bool load(GLuint program, uint64_t key);
+
+	// Before glLinkProgram of a program that is going to be stored.
+	void prepare(GLuint program);
+	void store(GLuint program, uint64_t key);
+
+	void record(bool hit, double ms);
+	const ProgramCacheStats& stats() const { return m_stats; }
+
+private:
+	std::string m_directory;
+	uint64_t m_driverKey{ 0 };
+	int m_supported{ -1 }; // unknown until the first GL query
+
+	ProgramCacheStats m_stats{};
+
+	std::string fileName(uint64_t key) const;
+};
+
+// The cache ShaderProgram::link uses.
+ProgramCache& programCache();
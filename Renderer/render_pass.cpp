@@ -7,20 +7,16 @@ LightingPass::LightingPass(Renderer* renderer) : m_renderer(renderer) {
 	m_ambientShader.create();
 	m_ambientShader.addShader(QuadVert, ShaderType::VertexShader);
 	m_ambientShader.addShader(AmbientPassFrag, ShaderType::FragmentShader);
-	m_ambientShader.link();
+	m_ambientShader.submit();
 
 	m_lightShader.create();
 	m_lightShader.addShader(QuadVert, ShaderType::VertexShader);
 	m_lightShader.addShader(LightPassFrag, ShaderType::FragmentShader);
-	m_lightShader.link();
+	m_lightShader.submit();
 
-	m_shadowShader.create();
-	m_shadowShader.addProgram(ShadowSrc);
-	m_shadowShader.link();
-
-	m_shadowInstancedShader.create();
-	m_shadowInstancedShader.addProgram(ShadowInstSrc);
-	m_shadowInstancedShader.link();
+	m_shadowVariants.create(ShadowSrc, "", nullptr, "shadow.glsl");
+	m_shadowVariants.get(VertexFormat::Full, 0);
+	m_shadowVariants.get(VertexFormat::Full, ShaderInstanced);
 }
 
 void LightingPass::render(PassParameters params, RenderPass* previousPass) {
@@ -40,17 +36,17 @@ void LightingPass::gbufferFill(PassParameters params) {
 
 	m_gbuffer.bind();
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	glState().enable(GL_DEPTH_TEST);
+	glState().enable(GL_CULL_FACE);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glViewport(params.viewport[0], params.viewport[1], params.viewport[2], params.viewport[3]);
+	glState().viewport(params.viewport[0], params.viewport[1], params.viewport[2], params.viewport[3]);
 
 	m_renderer->renderGeometry(params);
 
-	glBindVertexArray(0);
-	glUseProgram(0);
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
+	glState().bindVertexArray(0);
+	glState().useProgram(0);
+	glState().disable(GL_CULL_FACE);
+	glState().disable(GL_DEPTH_TEST);
 
 	m_gbuffer.unbind(true);
 }
@@ -64,13 +60,13 @@ void LightingPass::lighting(PassParameters params) {
 	m_passResult.bind();
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glState().enable(GL_BLEND);
+	glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_ambientShader.bind();
 
-	m_gbuffer.colorAttachments()[0].bind(0);
-	m_gbuffer.colorAttachments()[1].bind(1);
+	m_gbuffer.colorAttachments()[0].bindUnit(0);
+	m_gbuffer.colorAttachments()[1].bindUnit(1);
 	m_ambientShader["rtDiffuse"](0);
 	m_ambientShader["rtMaterial"](1);
 	m_ambientShader["uAmbientColor"](m_ambientColor);
@@ -79,10 +75,10 @@ void LightingPass::lighting(PassParameters params) {
 
 	m_lightShader.bind();
 
-	m_gbuffer.colorAttachments()[0].bind(0);
-	m_gbuffer.colorAttachments()[1].bind(1);
-	m_gbuffer.colorAttachments()[2].bind(2);
-	m_gbuffer.colorAttachments()[3].bind(3);
+	m_gbuffer.colorAttachments()[0].bindUnit(0);
+	m_gbuffer.colorAttachments()[1].bindUnit(1);
+	m_gbuffer.colorAttachments()[2].bindUnit(2);
+	m_gbuffer.colorAttachments()[3].bindUnit(3);
 	m_lightShader["rtDiffuse"](0);
 	m_lightShader["rtMaterial"](1);
 	m_lightShader["rtNormals"](2);
@@ -90,7 +86,7 @@ void LightingPass::lighting(PassParameters params) {
 
 	m_lightShader["uView"](params.view);
 
-	glBlendFunc(GL_ONE, GL_ONE);
+	glState().blendFunc(GL_ONE, GL_ONE);
 	for (auto& light : m_renderer->lights()) {
 		if (light.type == LightType::Directional) { // TODO: Implement this for Spot too
 			// TODO: Make this adjustable
@@ -109,7 +105,7 @@ void LightingPass::lighting(PassParameters params) {
 			m_lightShader["rtShadow"](4);
 			m_lightShader["uNF"](float2{ -s, s+4.0f });
 
-			m_shadowBuffer.depthAttachment().bind(4);
+			m_shadowBuffer.depthAttachment().bindUnit(4);
 		}
 
 		m_lightShader["uLight.position"](light.position);
@@ -122,7 +118,7 @@ void LightingPass::lighting(PassParameters params) {
 		m_renderer->renderScreenQuad();
 	}
 
-	glDisable(GL_BLEND);
+	glState().disable(GL_BLEND);
 	m_passResult.unbind(true);
 }
 
@@ -135,10 +131,10 @@ void LightingPass::renderToShadowBuffer(LightParameters params, float4x4 view, f
 		//m_shadowBuffer.addRenderBuffer(TextureFormat::Depthf, Attachment::DepthAttachment);
 	}
 
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_FRONT);
+	glState().disable(GL_BLEND);
+	glState().enable(GL_DEPTH_TEST);
+	glState().enable(GL_CULL_FACE);
+	glState().cullFace(GL_FRONT);
 
 	m_shadowBuffer.bind();
 	glClear(GL_DEPTH_BUFFER_BIT);
@@ -146,15 +142,16 @@ void LightingPass::renderToShadowBuffer(LightParameters params, float4x4 view, f
 	PassParameters pp;
 	pp.projection = proj;
 	pp.view = view;
+	pp.lodBias = m_shadowLodBias;
 
-	m_renderer->renderGeometryWithShader(pp, m_shadowShader, m_shadowInstancedShader);
+	m_renderer->renderGeometryWithShader(pp, m_shadowVariants);
 
 	m_shadowBuffer.unbind(true);
 
-	glCullFace(GL_BACK);
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
+	glState().cullFace(GL_BACK);
+	glState().disable(GL_CULL_FACE);
+	glState().disable(GL_DEPTH_TEST);
+	glState().enable(GL_BLEND);
 }
 
 GammaCorrectionPass::GammaCorrectionPass(Renderer* renderer) : m_renderer(renderer) {
@@ -170,7 +167,7 @@ void GammaCorrectionPass::render(PassParameters params, RenderPass* previousPass
 	m_passResult.bind();
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	previousPass->passResult().colorAttachments()[0].bind(0);
+	previousPass->passResult().colorAttachments()[0].bindUnit(0);
 
 	m_filter.bind();
 	m_filter.setUniforms();
@@ -202,12 +199,12 @@ void BloomPass::render(PassParameters params, RenderPass* previousPass) {
 	const uint32_t downScale = 3;
 	m_blurChain.create(params.viewport[2] / downScale, params.viewport[3] / downScale);
 
-	glDisable(GL_BLEND);
+	glState().disable(GL_BLEND);
 
 	m_thresholdedResult.bind();
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	previousPass->passResult().colorAttachments()[0].bind(0);
+	previousPass->passResult().colorAttachments()[0].bindUnit(0);
 
 	m_thresholdFilter.bind();
 	m_thresholdFilter.setUniforms();
@@ -216,13 +213,12 @@ void BloomPass::render(PassParameters params, RenderPass* previousPass) {
 
 	m_thresholdedResult.unbind(true);
 
-	m_thresholdedResult.colorAttachments()[0].bind(0);
-	m_thresholdedResult.colorAttachments()[0].generateMipmaps();
+	// the blit below only reads level 0, no mips needed here
 
 	m_blurChain.pingPongBuffer().bind(FrameBufferTarget::DrawFramebuffer, Attachment::ColorAttachment, 0);
 	m_thresholdedResult.bind(FrameBufferTarget::ReadFramebuffer, Attachment::ColorAttachment);
 	glBlitFramebuffer(0, 0, params.viewport[2], params.viewport[3], 0, 0, params.viewport[2] / downScale, params.viewport[3] / downScale, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	auto blur = (Blur*) m_blurChain.get(0);
 	blur->resolution = float2{ float(params.viewport[2]) / downScale, float(params.viewport[3]) / downScale };
@@ -240,12 +236,12 @@ void BloomPass::render(PassParameters params, RenderPass* previousPass) {
 	/*m_passResult.bind(FrameBufferTarget::DrawFramebuffer, Attachment::ColorAttachment);
 	m_blurChain.pingPongBuffer().bind(FrameBufferTarget::ReadFramebuffer, Attachment::ColorAttachment, m_blurChain.slot());
 	glBlitFramebuffer(0, 0, params.viewport[2], params.viewport[3], 0, 0, params.viewport[2], params.viewport[3], GL_COLOR_BUFFER_BIT, GL_LINEAR);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);*/
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);*/
 
 	m_passResult.bind();
 
-	previousPass->passResult().colorAttachments()[0].bind(0);
-	m_blurChain.pingPongBuffer().colorAttachments()[m_blurChain.slot()].bind(1);
+	previousPass->passResult().colorAttachments()[0].bindUnit(0);
+	m_blurChain.pingPongBuffer().colorAttachments()[m_blurChain.slot()].bindUnit(1);
 
 	m_combineFilter.bind();
 	m_combineFilter.setUniforms();
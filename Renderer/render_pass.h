@@ -5,8 +5,10 @@ using namespace linalg::aliases;
 
 #include "framebuffer.h"
 #include "shader_program.h"
+#include "shader_variants.h"
 #include "filter.h"
 #include "filter_chain.h"
+#include "vertex_format.h"
 
 class Renderer;
 struct LightParameters;
@@ -14,6 +16,7 @@ struct LightParameters;
 struct PassParameters {
 	uint32_t viewport[4];
 	float4x4 view, projection;
+	uint32_t lodBias{ 0 }; // added to the LOD picked for each command
 };
 
 class RenderPass {
@@ -31,14 +34,18 @@ public:
 
 	Framebuffer& passResult() override { return m_passResult; }
 
+	uint32_t shadowLodBias() const { return m_shadowLodBias; }
+	void shadowLodBias(uint32_t bias) { m_shadowLodBias = bias; }
+
 private:
 	Renderer* m_renderer;
 
-	ShaderProgram m_shadowShader, m_shadowInstancedShader;
+	ShaderVariants m_shadowVariants;
 	Framebuffer m_gbuffer, m_passResult, m_shadowBuffer;
 
 	ShaderProgram m_ambientShader;
 	float3 m_ambientColor{ 0.02f };
+	uint32_t m_shadowLodBias{ 1 };
 
 	ShaderProgram m_lightShader;
 
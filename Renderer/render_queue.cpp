@@ -0,0 +1,33 @@
+#include "render_queue.h"
+
+#include <utility>
+
+void radixSort(std::vector<RenderQueueEntry>& entries, std::vector<RenderQueueEntry>& scratch) {
+	const size_t count = entries.size();
+	if (count < 2) return;
+
+	uint32_t histograms[8][256]{};
+	for (const RenderQueueEntry& e : entries) {
+		for (int d = 0; d < 8; d++) histograms[d][(e.key >> (d * 8)) & 0xFF]++;
+	}
+
+	scratch.resize(count);
+	RenderQueueEntry* src = entries.data();
+	RenderQueueEntry* dst = scratch.data();
+
+	for (int d = 0; d < 8; d++) {
+		uint32_t* histogram = histograms[d];
+		if (histogram[(src[0].key >> (d * 8)) & 0xFF] == count) continue;
+
+		uint32_t sum = 0;
+		for (int b = 0; b < 256; b++) {
+			uint32_t c = histogram[b];
+			histogram[b] = sum;
+			sum += c;
+		}
+		for (size_t i = 0; i < count; i++) dst[histogram[(src[i].key >> (d * 8)) & 0xFF]++] = src[i];
+		std::swap(src, dst);
+	}
+
+	if (src != entries.data()) entries.swap(scratch);
+}
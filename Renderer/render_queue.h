@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Draw order packed into one integer, sorted ascending. Most significant first:
+//   opaque: pass 4 | variant 12 | material 16 | mesh 16 | depth 16
+//   shadow: pass 4 | variant 12 | 0 16 | mesh 16 | depth 16
+// State changes as rarely as possible and draws sharing all of it go front
+// to back for early-Z. Shadow draws have no material.
+enum class RenderQueuePass : uint8_t {
+	Opaque = 0,
+	Shadow
+};
+
+// Top 16 bits of a non-negative float. Monotonic, with more steps close to
+// the camera and no near/far range to pick.
+inline uint16_t quantizeDepth(float depth) {
+	if (!(depth > 0.0f)) return 0;
+	uint32_t bits;
+	std::memcpy(&bits, &depth, sizeof(bits));
+	return uint16_t(bits >> 16);
+}
+
+inline uint64_t renderSortKey(RenderQueuePass pass, uint32_t variant, uint16_t material, uint16_t mesh, float depth) {
+	if (pass == RenderQueuePass::Shadow) material = 0;
+	return uint64_t(pass) << 60 | uint64_t(variant & 0xFFF) << 48 |
+		uint64_t(material) << 32 | uint64_t(mesh) << 16 | quantizeDepth(depth);
+}
+
+struct RenderQueueEntry {
+	uint64_t key;
+	uint32_t command; // index into the frame's commands
+};
+
+// LSD radix sort on 8-bit digits. All histograms come from one read of the
+// keys and digits every key shares are skipped, so the usual 3-5 passes are
+// made instead of 8. Stable. scratch is resized as needed and can be reused.
+void radixSort(std::vector<RenderQueueEntry>& entries, std::vector<RenderQueueEntry>& scratch);
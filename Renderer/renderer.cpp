@@ -1,6 +1,12 @@
 #include "renderer.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "shaders.hpp"
+#include "hash.h"
+#include "model.h"
+#include "texture_streamer.h"
 
 static BufferLayoutEntry InstanceLayout[] = {
 	{ 4, DataType::Float, false },
@@ -12,6 +18,9 @@ static BufferLayoutEntry InstanceLayout[] = {
 	{ 1, DataType::Float, false } // Emission
 };
 
+// Uniform block binding points of the G-buffer variants.
+constexpr uint32_t MaterialBinding = 2, BonesBinding = 5;
+
 static std::string SlotNames[] = {
 	"tDiffuse",
 	"tSpecular",
@@ -19,8 +28,28 @@ static std::string SlotNames[] = {
 	"tEmission"
 };
 
+static uint32_t materialFeatures(const Material& material) {
+	uint32_t features = 0;
+	for (uint32_t i = 0; i < Material::SlotCount; i++) {
+		if (material.textures[i].valid()) features |= ShaderDiffuseMap << i;
+	}
+	return features;
+}
+
+// Shader variant for a command, picked once when it is submitted.
+static uint32_t commandFeatures(const RenderCommand& cmd) {
+	uint32_t features = 0;
+	if (cmd.type == RenderCommand::Type::Instanced) {
+		// TODO: Skeletal animation for instanced objects... ooof
+		features |= ShaderInstanced;
+	} else if (cmd.mesh->skeleton() && cmd.mesh->skeleton()->jointCount() > 0) {
+		features |= ShaderHasBones;
+	}
+	return features | materialFeatures(cmd.material);
+}
+
 void Renderer::create() {
-	m_instanceBuffer.create(BufferType::ArrayBuffer, BufferUsage::StreamDraw);
+	m_stream.create();
 
 	Vertex verts[] = {
 		Vertex{ .position = float3{ 0.0f, 0.0f, 0.0f } },
@@ -31,28 +60,18 @@ void Renderer::create() {
 	uint32_t inds[] = { 0, 1, 2, 2, 3, 0 };
 	m_quad.create(verts, 4, inds, 6);
 
-	m_gbufferShader.create();
-	m_gbufferShader.addShader(DefaultVert, ShaderType::VertexShader);
-	m_gbufferShader.addShader(GBufferPassFrag, ShaderType::FragmentShader);
-	m_gbufferShader.link();
-
-	m_gbufferInstancedShader.create();
-	m_gbufferInstancedShader.addShader(DefaultInstancedVert, ShaderType::VertexShader);
-	m_gbufferInstancedShader.addShader(GBufferPassFrag, ShaderType::FragmentShader);
-	m_gbufferInstancedShader.link();
-
-	m_nullShader.create();
-	m_nullShader.addShader(DefaultVert, ShaderType::VertexShader);
-	m_nullShader.addShader("#version 330 core\nvoid main(){}", ShaderType::FragmentShader);
-	m_nullShader.link();
-
-	m_nullInstancedShader.create();
-	m_nullInstancedShader.addShader(DefaultInstancedVert, ShaderType::VertexShader);
-	m_nullInstancedShader.addShader("#version 330 core\nvoid main(){}", ShaderType::FragmentShader);
-	m_nullInstancedShader.link();
+	// the rest of the variants are submitted by prewarm, or by the first
+	// pass that needs them
+	m_gbufferVariants.create(DefaultVert, GBufferPassFrag, [](ShaderProgram& sp) {
+		// one texture unit per material slot
+		for (int i = 0; i < Material::SlotCount; i++) sp[SlotNames[i]](i);
+		sp.uniformBlock("Material", MaterialBinding);
+		sp.uniformBlock("Bones", BonesBinding);
+	});
+	prewarm(VertexFormat::Full);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	glState().enable(GL_DEPTH_TEST);
+	glState().enable(GL_CULL_FACE);
 
 	addPass(new LightingPass(this));
 	addPass(new BloomPass(this));
@@ -60,9 +79,15 @@ void Renderer::create() {
 }
 
 void Renderer::destroy() {
-	m_instanceBuffer.destroy();
-	if (m_gbufferShader.valid()) m_gbufferShader.destroy();
-	if (m_gbufferInstancedShader.valid()) m_gbufferInstancedShader.destroy();
+	m_stream.destroy();
+	m_gbufferVariants.destroy();
+}
+
+void Renderer::prewarm(VertexFormat format, const Material& material) {
+	uint32_t maps = materialFeatures(material);
+	for (uint32_t features : { 0u, uint32_t(ShaderInstanced), uint32_t(ShaderHasBones) }) {
+		m_gbufferVariants.get(format, features | maps);
+	}
 }
 
 void Renderer::draw(Mesh* mesh, float4x4 model, Material material) {
@@ -71,33 +96,36 @@ void Renderer::draw(Mesh* mesh, float4x4 model, Material material) {
 	cmd.mesh = mesh;
 	cmd.single.model = model;
 	cmd.material = material;
+	cmd.features = commandFeatures(cmd);
 	m_commands.push_back(cmd);
 }
 
-void Renderer::drawInstanced(Mesh* mesh, Instance* instances, size_t count, Material material) {
-	if (!mesh->m_hasInstanceBuffer) {
-		mesh->vao().bind();
-		m_instanceBuffer.bind();
-		m_instanceBuffer.setLayout(InstanceLayout, 7, sizeof(Instance), 6);
-		m_instanceBuffer.attributeDivisor(6, 1);
-		m_instanceBuffer.attributeDivisor(7, 1);
-		m_instanceBuffer.attributeDivisor(8, 1);
-		m_instanceBuffer.attributeDivisor(9, 1);
-		m_instanceBuffer.attributeDivisor(10, 1);
-		m_instanceBuffer.attributeDivisor(11, 1);
-		m_instanceBuffer.attributeDivisor(12, 1);
-
-		mesh->vao().unbind();
-		mesh->m_hasInstanceBuffer = true;
+void Renderer::draw(Model* model, float4x4 transform) {
+	for (auto& sub : model->subMeshes()) {
+		RenderCommand cmd{};
+		cmd.type = RenderCommand::Type::Single;
+		cmd.mesh = &model->mesh();
+		cmd.single.model = linalg::mul(transform, sub.transform);
+		cmd.material = model->materials()[sub.material];
+		cmd.firstIndex = sub.firstIndex;
+		cmd.indexCount = sub.indexCount;
+		cmd.baseVertex = sub.baseVertex;
+		cmd.features = commandFeatures(cmd);
+		m_commands.push_back(cmd);
 	}
-	m_instanceBuffer.update(instances, count);
+}
 
+void Renderer::drawInstanced(Mesh* mesh, Instance* instances, size_t count, Material material) {
 	RenderCommand cmd{};
 	cmd.type = RenderCommand::Type::Instanced;
 	cmd.instanced.count = count;
+	cmd.firstInstance = uint32_t(m_instances.size());
 	cmd.mesh = mesh;
 	cmd.material = material;
+	cmd.features = commandFeatures(cmd);
 	m_commands.push_back(cmd);
+
+	m_instances.insert(m_instances.end(), instances, instances + count);
 }
 
 void Renderer::renderAll(uint32_t vx, uint32_t vy, uint32_t vw, uint32_t vh) {
@@ -109,6 +137,21 @@ void Renderer::renderAll(uint32_t vx, uint32_t vy, uint32_t vw, uint32_t vh) {
 	params.view = m_view;
 	params.projection = m_projection;
 
+	m_stats = RenderStats{};
+	m_stats.commands = uint32_t(m_commands.size());
+
+	selectLods(params);
+	if (m_textureStreamer) requestTextureLevels(params);
+	assignSortIds();
+	batchInstances();
+	if (!m_instances.empty()) {
+		// one copy per frame, instanced draws pick their range by offset
+		m_instanceData = m_stream.write(m_instances.data(), m_instances.size() * sizeof(Instance), sizeof(Instance));
+		for (auto& cmd : m_commands) {
+			if (cmd.type == RenderCommand::Type::Instanced) cmd.instanceOffset = m_instanceData.offset + size_t(cmd.firstInstance) * sizeof(Instance);
+		}
+	}
+
 	RenderPass* previous = nullptr;
 	for (auto& pass : m_passes) {
 		pass->render(params, previous);
@@ -117,12 +160,16 @@ void Renderer::renderAll(uint32_t vx, uint32_t vy, uint32_t vw, uint32_t vh) {
 
 	auto& lastPass = m_passes.back()->passResult();
 	lastPass.bind(FrameBufferTarget::ReadFramebuffer, Attachment::ColorAttachment);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 	glBlitFramebuffer(0, 0, vw, vh, 0, 0, vw, vh, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
+	m_stream.endFrame();
 	m_commands.clear();
+	m_instances.clear();
 	m_lights.clear();
+
+	glState().endFrame();
 }
 
 void Renderer::setCamera(float4x4 view, float4x4 projection) {
@@ -130,49 +177,288 @@ void Renderer::setCamera(float4x4 view, float4x4 projection) {
 	m_projection = projection;
 }
 
-void setShaderParams(Material& mat, Skeleton* skel, ShaderProgram& sp, PassParameters params) {
-	sp["uView"](params.view);
-	sp["uProjection"](params.projection);
+// Projected size in pixels of the diagonal of a mesh's bounds.
+static float screenExtent(const PassParameters& params, const float4x4& model, const AABB& bounds) {
+	const bool perspective = params.projection[3][3] == 0.0f;
+	const float pixelsPerUnit = params.projection[1][1] * float(params.viewport[3]) * 0.5f;
+
+	float scale = std::max({ linalg::length(model[0].xyz()), linalg::length(model[1].xyz()), linalg::length(model[2].xyz()) });
+	float3 center = (bounds.min + bounds.max) * 0.5f;
+	float extent = linalg::length(bounds.max - bounds.min) * scale;
+
+	float4 viewPos = linalg::mul(params.view, linalg::mul(model, float4{ center, 1.0f }));
+	float pixels = extent * pixelsPerUnit;
+	if (perspective) pixels /= std::max(-viewPos.z, 1e-3f);
+	return pixels;
+}
+
+void Renderer::selectLods(PassParameters params) {
+	std::unordered_map<uint64_t, uint32_t> history;
+	std::unordered_map<Mesh*, uint32_t> occurrences;
+
+	for (auto& cmd : m_commands) {
+		cmd.lod = 0;
+
+		Mesh* mesh = cmd.mesh;
+		if (mesh->lodCount() <= 1 || cmd.type != RenderCommand::Type::Single || cmd.indexCount > 0) continue;
+
+		// identifies "the same object" across frames as the n-th draw of a mesh
+		uint32_t occurrence = occurrences[mesh]++;
+		uint64_t key = hashBytes(&mesh, sizeof(mesh), occurrence);
+
+		float pixels = screenExtent(params, cmd.single.model, mesh->bounds());
+
+		auto fits = [&](uint32_t i, float limit) { return mesh->lod(i).error * pixels <= limit; };
+
+		uint32_t lod = 0;
+		for (uint32_t i = mesh->lodCount() - 1; i > 0; i--) {
+			if (fits(i, m_lodPixelError)) {
+				lod = i;
+				break;
+			}
+		}
+
+		auto prev = m_lodHistory.find(key);
+		if (prev != m_lodHistory.end() && prev->second < mesh->lodCount()) {
+			uint32_t current = prev->second;
+			if (lod > current) {
+				// only go coarser once the new level is comfortably under the threshold
+				uint32_t coarser = current;
+				for (uint32_t i = lod; i > current; i--) {
+					if (fits(i, m_lodPixelError * (1.0f - m_lodHysteresis))) {
+						coarser = i;
+						break;
+					}
+				}
+				lod = coarser;
+			} else if (lod < current && fits(current, m_lodPixelError * (1.0f + m_lodHysteresis))) {
+				lod = current;
+			}
+		}
+
+		cmd.lod = lod;
+		history[key] = lod;
+	}
+
+	m_lodHistory = std::move(history);
+}
+
+void Renderer::requestTextureLevels(PassParameters params) {
+	for (auto& cmd : m_commands) {
+		// instances are not kept around, assume one of them is close
+		float pixels = 0.0f;
+		if (cmd.type == RenderCommand::Type::Single) {
+			pixels = std::max(screenExtent(params, cmd.single.model, cmd.mesh->bounds()), 1.0f);
+		}
 
-	if (skel != nullptr) {
-		float4x4 mats[MaxJoints];
-		for (size_t id = 0; id < MaxJoints; id++) {
-			mats[id] = linalg::identity;
+		for (auto& tex : cmd.material.textures) {
+			if (!tex.valid()) continue;
+			// roughly one texel per pixel when the UVs span the object once
+			float level = pixels > 0.0f ? std::log2(float(std::max(tex.width(), tex.height())) / pixels) : 0.0f;
+			m_textureStreamer->request(tex, level);
 		}
+	}
+	m_textureStreamer->update();
+}
+
+// Dense per-frame ids so materials and meshes fit in 16 bits of the sort key.
+void Renderer::assignSortIds() {
+	std::unordered_map<uint64_t, uint16_t> materials;
+	std::unordered_map<Mesh*, uint16_t> meshes;
 
-		for (size_t id = 0; id < skel->jointCount(); id++) {
-			auto& joint = skel->getJoint(id);
-			mats[id] = skel->jointTransform(id);
-				//linalg::mul(joint.correctionMatrix, linalg::mul(skel->jointTransform(id), joint.offset));
+	for (auto& cmd : m_commands) {
+		const Material& mat = cmd.material;
+		uint64_t h = hashBytes(&mat.shininess, sizeof(float) * 2);
+		h = hashBytes(&mat.diffuse, sizeof(mat.diffuse), h);
+		for (auto& tex : mat.textures) {
+			GLuint object = tex.object();
+			h = hashBytes(&object, sizeof(object), h);
 		}
 
-		sp.uniformBufferArray("Bones", &mats[0], MaxJoints, 5);
-		sp["uHasBones"](true);
-	} else {
-		sp["uHasBones"](false);
+		// past 64k the last id is shared, only the order suffers: batching and
+		// state tracking go by the hash and the mesh itself
+		auto material = materials.try_emplace(h, uint16_t(std::min<size_t>(materials.size(), 0xFFFF)));
+		auto mesh = meshes.try_emplace(cmd.mesh, uint16_t(std::min<size_t>(meshes.size(), 0xFFFF)));
+		cmd.materialHash = h;
+		cmd.materialId = material.first->second;
+		cmd.meshId = mesh.first->second;
+	}
+}
+
+// Single draws of the same mesh part with the same material and LOD, anywhere
+// in the frame, become one instanced draw. Skinned draws stay as they are.
+void Renderer::batchInstances() {
+	if (m_autoInstanceMin == 0) return;
+
+	struct BatchKey {
+		Mesh* mesh;
+		uint64_t material;
+		uint32_t lod, firstIndex, indexCount;
+		int32_t baseVertex;
+
+		bool operator==(const BatchKey&) const = default;
+	};
+	struct BatchKeyHash {
+		size_t operator()(const BatchKey& k) const { return size_t(hashBytes(&k, sizeof(k))); }
+	};
+
+	// first count them, only batches that are big enough are worth it
+	std::unordered_map<BatchKey, uint32_t, BatchKeyHash> groups;
+	std::vector<uint32_t> groupOf(m_commands.size(), ~0u), counts;
+	for (size_t i = 0; i < m_commands.size(); i++) {
+		const RenderCommand& cmd = m_commands[i];
+		if (cmd.type != RenderCommand::Type::Single || (cmd.features & ShaderHasBones)) continue;
+
+		BatchKey key{ cmd.mesh, cmd.materialHash, cmd.lod, cmd.firstIndex, cmd.indexCount, cmd.baseVertex };
+		auto [pos, added] = groups.try_emplace(key, uint32_t(counts.size()));
+		if (added) counts.push_back(0);
+		counts[pos->second]++;
+		groupOf[i] = pos->second;
 	}
 
+	std::vector<RenderCommand> commands;
+	commands.reserve(m_commands.size());
+	std::vector<uint32_t> batchOf(counts.size(), ~0u);
+
+	for (size_t i = 0; i < m_commands.size(); i++) {
+		const RenderCommand& cmd = m_commands[i];
+		uint32_t group = groupOf[i];
+		if (group == ~0u || counts[group] < m_autoInstanceMin) {
+			commands.push_back(cmd);
+			continue;
+		}
+
+		// the batch takes the place of its first command
+		if (batchOf[group] == ~0u) {
+			batchOf[group] = uint32_t(commands.size());
+
+			RenderCommand batch = cmd;
+			batch.type = RenderCommand::Type::Instanced;
+			batch.instanced.count = 0;
+			batch.firstInstance = uint32_t(m_instances.size());
+			batch.features |= ShaderInstanced;
+			commands.push_back(batch);
+
+			m_instances.resize(m_instances.size() + counts[group]);
+		}
+
+		RenderCommand& batch = commands[batchOf[group]];
+		Instance& instance = m_instances[batch.firstInstance + batch.instanced.count++];
+		instance = Instance{};
+		instance.model = cmd.single.model;
+		m_stats.autoInstanced++;
+	}
+
+	m_commands.swap(commands);
+}
+
+void Renderer::buildQueue(RenderQueuePass pass, const PassParameters& params) {
+	m_queue.clear();
+	m_queue.reserve(m_commands.size());
+
+	for (uint32_t i = 0; i < m_commands.size(); i++) {
+		RenderCommand& cmd = m_commands[i];
+
+		// instances can be anywhere, they go first
+		float depth = 0.0f;
+		if (cmd.type == RenderCommand::Type::Single) {
+			const AABB& bounds = cmd.mesh->bounds();
+			float4 center = linalg::mul(cmd.single.model, float4{ (bounds.min + bounds.max) * 0.5f, 1.0f });
+			depth = -linalg::mul(params.view, center).z;
+		}
+
+		// feature bits, then the vertex format, as picked by the pass's variants
+		uint32_t features = pass == RenderQueuePass::Shadow ? cmd.features & ShaderInstanced : cmd.features;
+		uint32_t variant = features | uint32_t(cmd.mesh->vertexFormat()) << ShaderFeatureCount;
+
+		cmd.sortKey = renderSortKey(pass, variant, cmd.materialId, cmd.meshId, depth);
+		m_queue.push_back({ cmd.sortKey, i });
+	}
+
+	radixSort(m_queue, m_queueScratch);
+}
+
+void Renderer::uploadBones(Skeleton* skel) {
+	float4x4 mats[MaxJoints];
+	for (size_t id = 0; id < MaxJoints; id++) {
+		mats[id] = linalg::identity;
+	}
+
+	for (size_t id = 0; id < std::min(skel->jointCount(), MaxJoints); id++) {
+		auto& joint = skel->getJoint(int(id));
+		mats[id] = linalg::mul(joint.correctionMatrix, skel->jointTransform(int(id)), joint.offset);
+	}
+
+	StreamAllocation bones = m_stream.write(mats, sizeof(mats), m_stream.uniformAlignment());
+	glState().bindBufferRange(GL_UNIFORM_BUFFER, BonesBinding, bones.buffer->object(), bones.offset, sizeof(mats));
+}
+
+void Renderer::setMaterial(const Material& mat) {
 	MaterialParameters mp{};
 	mp.shininess = mat.shininess;
 	mp.emission = mat.emission;
 	mp.diffuse = mat.diffuse;
-	sp.uniformBuffer("Material", mp, 2);
-
-	bool textureValid[Material::SlotCount] = { false };
-	uint32_t i = 0;
-	int slot = 0;
-	for (auto& tex : mat.textures) {
-		textureValid[i] = tex.valid();
-		if (tex.valid()) {
-			tex.bind(slot++);
-			sp[SlotNames[i]](slot-1);
-		}
+	StreamAllocation params = m_stream.write(&mp, sizeof(mp), m_stream.uniformAlignment());
+	glState().bindBufferRange(GL_UNIFORM_BUFFER, MaterialBinding, params.buffer->object(), params.offset, sizeof(mp));
+	m_stats.materialUploads++;
+
+	// the variant only samples the slots that have a texture, each on its own unit
+	for (int i = 0; i < Material::SlotCount; i++) {
+		if (!mat.textures[i].valid()) continue;
+		mat.textures[i].bindUnit(i);
+		m_stats.textureBinds++;
+	}
+}
+
+void Renderer::bindMesh(const RenderCommand& cmd, ShaderProgram& shader) {
+	VertexFormat format = cmd.mesh->vertexFormat();
+	if (format == VertexFormat::Quantized || format == VertexFormat::QuantizedSkinned) {
+		const VertexQuantization& q = cmd.mesh->quantization();
+		shader["uPositionOffset"](q.positionOffset);
+		shader["uPositionScale"](q.positionScale);
+		shader["uTexCoordTransform"](float4{ q.texCoordOffset.x, q.texCoordOffset.y, q.texCoordScale.x, q.texCoordScale.y });
+	}
 
-		std::string un = std::string("tTextureValid[") + std::to_string(i) + std::string("]");
-		sp[un](textureValid[i] ? 1 : 0);
+	cmd.mesh->vao().bind();
+	m_stats.meshBinds++;
+}
+
+void Renderer::drawCommand(const RenderCommand& cmd, PassParameters params) {
+	uint32_t firstIndex = cmd.firstIndex, indexCount = cmd.indexCount;
+	if (indexCount == 0) {
+		const MeshLod& lod = cmd.mesh->lod(std::min(cmd.lod + params.lodBias, cmd.mesh->lodCount() - 1));
+		firstIndex = lod.indexOffset;
+		indexCount = lod.indexCount;
+	}
+	const void* offset = reinterpret_cast<const void*>(size_t(firstIndex) * sizeof(uint32_t));
+
+	if (cmd.type == RenderCommand::Type::Instanced) {
+		bindInstances(cmd);
+		if (GLAD_GL_VERSION_4_2) {
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, offset, GLsizei(cmd.instanced.count), cmd.baseVertex, GLuint(cmd.instanceOffset / sizeof(Instance)));
+		} else {
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, offset, GLsizei(cmd.instanced.count), cmd.baseVertex);
+		}
+	} else {
+		glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, offset, cmd.baseVertex);
+	}
+	m_stats.drawCalls++;
+}
 
-		i++;
+// Instance attributes of the bound vertex array. Without base instance they
+// are pointed at the command's instances before each draw.
+void Renderer::bindInstances(const RenderCommand& cmd) {
+	Mesh* mesh = cmd.mesh;
+	const bool baseInstance = GLAD_GL_VERSION_4_2;
+	if (baseInstance && mesh->m_instanceBuffer == m_instanceData.bufferId) return;
+
+	// each frame in flight writes its instances to another buffer
+	Buffer& buffer = *m_instanceData.buffer;
+	buffer.setLayout(InstanceLayout, 7, sizeof(Instance), 6, baseInstance ? 0 : cmd.instanceOffset);
+	if (mesh->m_instanceBuffer == 0) {
+		for (uint32_t i = 6; i <= 12; i++) buffer.attributeDivisor(i, 1);
 	}
+	mesh->m_instanceBuffer = m_instanceData.bufferId;
 }
 
 void Renderer::putPointLight(float3 position, float radius, float3 color, float intensity) {
@@ -189,68 +475,96 @@ void Renderer::renderScreenQuad() {
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
 }
 
+// Sorted by state, so each of it is only set when it differs from the
+// previous command's. Uniform blocks and textures are bound outside of the
+// program and survive a switch, the mesh's quantization uniforms do not.
 void Renderer::renderGeometry(PassParameters params) {
-	for (auto& cmd : m_commands) {
-		switch (cmd.type) {
-			case RenderCommand::Type::Single:
-			{
-				m_gbufferShader.bind();
-				m_gbufferShader["uModel"](cmd.single.model);
-
-				setShaderParams(cmd.material, cmd.mesh->skeleton(), m_gbufferShader, params);
-
-				cmd.mesh->vao().bind();
-				glDrawElements(GL_TRIANGLES, cmd.mesh->indexCount(), GL_UNSIGNED_INT, nullptr);
-			} break;
-			case RenderCommand::Type::Instanced:
-			{
-				m_gbufferInstancedShader.bind();
-
-				// TODO: Skeletal animation for instanced objects... ooof
-				setShaderParams(cmd.material, nullptr, m_gbufferInstancedShader, params);
-
-				cmd.mesh->vao().bind();
-				glDrawElementsInstanced(
-					GL_TRIANGLES,
-					cmd.mesh->indexCount(),
-					GL_UNSIGNED_INT,
-					nullptr,
-					cmd.instanced.count
-				);
-			} break;
+	buildQueue(RenderQueuePass::Opaque, params);
+
+	// submit every variant first, so the new ones compile together and the
+	// loop below only waits once
+	uint64_t variant = ~0ull;
+	for (const RenderQueueEntry& e : m_queue) {
+		if (e.key >> 48 == variant) continue;
+		variant = e.key >> 48;
+		const RenderCommand& cmd = m_commands[e.command];
+		m_gbufferVariants.get(cmd.mesh->vertexFormat(), cmd.features);
+	}
+
+	ShaderProgram* shader = nullptr;
+	variant = ~0ull;
+	uint64_t material = ~0ull;
+	const Mesh* mesh = nullptr;
+	Skeleton* skeleton = nullptr;
+
+	for (const RenderQueueEntry& e : m_queue) {
+		const RenderCommand& cmd = m_commands[e.command];
+
+		if (e.key >> 48 != variant) {
+			variant = e.key >> 48;
+			shader = &m_gbufferVariants.bind(cmd.mesh->vertexFormat(), cmd.features);
+			(*shader)["uView"](params.view);
+			(*shader)["uProjection"](params.projection);
+			mesh = nullptr;
+			m_stats.programBinds++;
 		}
+
+		if (cmd.type == RenderCommand::Type::Single) (*shader)["uModel"](cmd.single.model);
+
+		Skeleton* skel = cmd.features & ShaderHasBones ? cmd.mesh->skeleton() : nullptr;
+		if (skel != nullptr && skel != skeleton) {
+			uploadBones(skel);
+			skeleton = skel;
+		}
+		if (cmd.materialHash != material) {
+			setMaterial(cmd.material);
+			material = cmd.materialHash;
+		}
+		if (cmd.mesh != mesh) {
+			bindMesh(cmd, *shader);
+			mesh = cmd.mesh;
+		}
+
+		drawCommand(cmd, params);
 	}
 }
 
-void Renderer::renderGeometryWithShader(PassParameters params, ShaderProgram& shader, ShaderProgram& instancedShader) {
-	for (auto& cmd : m_commands) {
-		switch (cmd.type) {
-			case RenderCommand::Type::Single:
-			{
-				shader.bind();
-				shader["uModel"](cmd.single.model);
-				shader["uView"](params.view);
-				shader["uProjection"](params.projection);
-
-				cmd.mesh->vao().bind();
-				glDrawElements(GL_TRIANGLES, cmd.mesh->indexCount(), GL_UNSIGNED_INT, nullptr);
-			} break;
-			case RenderCommand::Type::Instanced:
-			{
-				instancedShader.bind();
-				instancedShader["uView"](params.view);
-				instancedShader["uProjection"](params.projection);
-
-				cmd.mesh->vao().bind();
-				glDrawElementsInstanced(
-					GL_TRIANGLES,
-					cmd.mesh->indexCount(),
-					GL_UNSIGNED_INT,
-					nullptr,
-					cmd.instanced.count
-				);
-			} break;
+void Renderer::renderGeometryWithShader(PassParameters params, ShaderVariants& variants) {
+	buildQueue(RenderQueuePass::Shadow, params);
+
+	uint64_t variant = ~0ull;
+	for (const RenderQueueEntry& e : m_queue) {
+		if (e.key >> 48 == variant) continue;
+		variant = e.key >> 48;
+		const RenderCommand& cmd = m_commands[e.command];
+		variants.get(cmd.mesh->vertexFormat(), cmd.type == RenderCommand::Type::Instanced ? ShaderInstanced : 0);
+	}
+
+	ShaderProgram* shader = nullptr;
+	variant = ~0ull;
+	const Mesh* mesh = nullptr;
+
+	for (const RenderQueueEntry& e : m_queue) {
+		const RenderCommand& cmd = m_commands[e.command];
+		bool instanced = cmd.type == RenderCommand::Type::Instanced;
+
+		if (e.key >> 48 != variant) {
+			variant = e.key >> 48;
+			shader = &variants.bind(cmd.mesh->vertexFormat(), instanced ? ShaderInstanced : 0);
+			(*shader)["uView"](params.view);
+			(*shader)["uProjection"](params.projection);
+			mesh = nullptr;
+			m_stats.programBinds++;
+		}
+
+		if (!instanced) (*shader)["uModel"](cmd.single.model);
+
+		if (cmd.mesh != mesh) {
+			bindMesh(cmd, *shader);
+			mesh = cmd.mesh;
 		}
+
+		drawCommand(cmd, params);
 	}
 }
 
@@ -1,10 +1,14 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "mesh.h"
 #include "shader_program.h"
+#include "shader_variants.h"
+#include "render_queue.h"
+#include "stream_allocator.h"
 #include "buffer.h"
 #include "texture.h"
 #include "framebuffer.h"
@@ -14,6 +18,9 @@
 
 #include "render_pass.h"
 
+class Model;
+class TextureStreamer;
+
 constexpr size_t MaxJoints = 64;
 
 struct Instance {
@@ -75,9 +82,30 @@ struct RenderCommand {
 	union {
 		size_t count;
 	} instanced;
+	uint32_t firstInstance{ 0 }; // in the frame's instance data
+	size_t instanceOffset{ 0 }; // bytes into the frame's instance buffer, set by renderAll
 
 	Mesh* mesh;
 	Material material{};
+	uint32_t lod{ 0 };
+
+	// index range inside the mesh (model parts), indexCount 0 draws the selected LOD
+	uint32_t firstIndex{ 0 }, indexCount{ 0 };
+	int32_t baseVertex{ 0 };
+
+	uint32_t features{ 0 }; // ShaderFeature bits of the G-buffer variant
+
+	// per frame, set by renderAll
+	uint64_t materialHash{ 0 }; // identifies the material, the id can be shared
+	uint16_t materialId{ 0 }, meshId{ 0 };
+	uint64_t sortKey{ 0 }; // in the pass being drawn
+};
+
+// Counted over one renderAll, all passes.
+struct RenderStats {
+	uint32_t commands{ 0 }, drawCalls{ 0 };
+	uint32_t autoInstanced{ 0 }; // single commands merged into instanced draws
+	uint32_t programBinds{ 0 }, materialUploads{ 0 }, textureBinds{ 0 }, meshBinds{ 0 };
 };
 
 class Renderer {
@@ -89,30 +117,60 @@ public:
 	void draw(Mesh* mesh, float4x4 model, Material material);
 	void drawInstanced(Mesh* mesh, Instance* instances, size_t count, Material material);
 
+	// One command per part, all sharing the model's vertex array.
+	void draw(Model* model, float4x4 transform);
+
 	void putPointLight(float3 position, float radius, float3 color, float intensity = 1.0f);
 	void putDirectionalLight(float3 direction, float3 color, float intensity = 1.0f);
 	void putSpotLight(float3 position, float3 direction, float radius, float cutOff, float3 color, float intensity = 1.0f);
 
 	void renderAll(uint32_t vx, uint32_t vy, uint32_t vw, uint32_t vh);
 
+	// Submits the G-buffer variants a mesh of this format drawn with this
+	// material will need (plain, instanced and skinned), so that they compile
+	// while assets load instead of on the frame that first draws it.
+	void prewarm(VertexFormat format, const Material& material = {});
+
 	// TODO: Replace with a proper camera class
 	void setCamera(float4x4 view, float4x4 projection);
 
+	// Coarser LODs are used while their error stays under pixelError pixels on screen.
+	// hysteresis widens that threshold around the current LOD to avoid popping.
+	void setLodThreshold(float pixelError, float hysteresis = 0.25f) {
+		m_lodPixelError = pixelError;
+		m_lodHysteresis = hysteresis;
+	}
+
+	// Runs of at least minCount draw() calls of the same mesh part, material
+	// and LOD without a skeleton become one instanced draw. 0 disables.
+	void setAutoInstancing(uint32_t minCount) { m_autoInstanceMin = minCount; }
+
+	// Material textures get their mip level requested from screen coverage and
+	// the streamer is updated once per renderAll.
+	void setTextureStreamer(TextureStreamer* streamer) { m_textureStreamer = streamer; }
+
 	void addPass(RenderPass* pass) { return m_passes.push_back(std::unique_ptr<RenderPass>(pass)); }
 	
 	void renderGeometry(PassParameters params);
-	void renderGeometryWithShader(PassParameters params, ShaderProgram& shader, ShaderProgram& instancedShader);
+	// Only INSTANCED is set on the variants.
+	void renderGeometryWithShader(PassParameters params, ShaderVariants& variants);
 	void renderScreenQuad();
 
 	std::vector<LightParameters> lights() const { return m_lights; }
 
+	const RenderStats& stats() const { return m_stats; }
+	const StreamAllocatorStats& streamStats() const { return m_stream.lastFrame(); }
+
 private:
 	std::vector<RenderCommand> m_commands;
+	std::vector<Instance> m_instances; // all of the frame's, uploaded once by renderAll
+	std::vector<RenderQueueEntry> m_queue, m_queueScratch;
+	RenderStats m_stats{};
 	std::vector<LightParameters> m_lights;
-	Buffer m_instanceBuffer;
+	StreamAllocator m_stream; // instances, materials and bones
+	StreamAllocation m_instanceData; // this frame's
 
-	ShaderProgram m_gbufferShader, m_gbufferInstancedShader;
-	ShaderProgram m_nullShader, m_nullInstancedShader;
+	ShaderVariants m_gbufferVariants;
 	
 	Mesh m_quad;
 
@@ -120,5 +178,24 @@ private:
 
 	float4x4 m_view, m_projection;
 
+	float m_lodPixelError{ 1.0f }, m_lodHysteresis{ 0.25f };
+	std::unordered_map<uint64_t, uint32_t> m_lodHistory;
+
+	TextureStreamer* m_textureStreamer{ nullptr };
+
+	uint32_t m_autoInstanceMin{ 4 };
+
+	void selectLods(PassParameters params);
+	void requestTextureLevels(PassParameters params);
+	void assignSortIds();
+	void batchInstances();
+	void buildQueue(RenderQueuePass pass, const PassParameters& params);
+
+	void uploadBones(Skeleton* skel);
+	void setMaterial(const Material& mat);
+	void bindMesh(const RenderCommand& cmd, ShaderProgram& shader);
+	void drawCommand(const RenderCommand& cmd, PassParameters params);
+	void bindInstances(const RenderCommand& cmd);
+
 };
 
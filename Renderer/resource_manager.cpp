@@ -0,0 +1,210 @@
+#include "resource_manager.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "aixlog.hpp"
+#include "hash.h"
+
+// Marks importMesh keys apart from loadMesh ones.
+constexpr uint32_t ImportedMesh = 1u << 16;
+
+static std::string normalizePath(const std::string& fileName) {
+	std::string path = fileName;
+	std::replace(path.begin(), path.end(), '\\', '/');
+	while (path.compare(0, 2, "./") == 0) path.erase(0, 2);
+#ifdef _WIN32
+	std::transform(path.begin(), path.end(), path.begin(), [](unsigned char c) { return char(::tolower(c)); });
+#endif
+	return path;
+}
+
+// What was asked for besides the file, two requests only share a resource when this matches.
+static uint64_t optionsKey(ResourceType type, uint32_t flags, uint32_t extra) {
+	uint32_t options[3] = { uint32_t(type), flags, extra };
+	return hashBytes(options, sizeof(options));
+}
+
+template <typename T>
+ResourceHandle<T> ResourceManager::adopt(ResourceRecord* record, uint64_t pathKey) {
+	auto& keys = record->m_pathKeys;
+	if (std::find(keys.begin(), keys.end(), pathKey) == keys.end()) {
+		keys.push_back(pathKey);
+		m_byPath[pathKey] = record;
+	}
+	return ResourceHandle<T>(static_cast<Resource<T>*>(record));
+}
+
+template <typename T, typename Load>
+ResourceHandle<T> ResourceManager::acquire(ResourceType type, const std::string& fileName, uint64_t options, Load&& load) {
+	uint64_t pathKey = hashString(normalizePath(fileName), options);
+	auto byPath = m_byPath.find(pathKey);
+	if (byPath != m_byPath.end()) {
+		m_counters.pathHits++;
+		return ResourceHandle<T>(static_cast<Resource<T>*>(byPath->second));
+	}
+
+	// a new path, the worker hashes its bytes and collect looks for copies
+	auto record = std::make_unique<Resource<T>>();
+	record->m_name = fileName;
+	record->m_type = type;
+	record->m_options = options;
+	record->m_lastUsed = m_frame;
+	record->m_asset = load();
+
+	ResourceRecord* ptr = record.get();
+	m_records.push_back(std::move(record));
+	m_counters.loads++;
+
+	return adopt<T>(ptr, pathKey);
+}
+
+ResourceHandle<Mesh> ResourceManager::loadMesh(const std::string& fileName, uint32_t flags, VertexFormat format) {
+	return acquire<Mesh>(ResourceType::Mesh, fileName, optionsKey(ResourceType::Mesh, flags, uint32_t(format)), [&]() {
+		return m_loader->loadMesh(fileName, flags, format);
+	});
+}
+
+ResourceHandle<Mesh> ResourceManager::importMesh(const std::string& fileName, uint32_t flags, VertexFormat format) {
+	return acquire<Mesh>(ResourceType::Mesh, fileName, optionsKey(ResourceType::Mesh, flags, uint32_t(format) | ImportedMesh), [&]() {
+		return m_loader->importMesh(fileName, flags, format);
+	});
+}
+
+ResourceHandle<Texture> ResourceManager::loadTexture(const std::string& fileName, TextureUsage usage, uint32_t flags) {
+	return acquire<Texture>(ResourceType::Texture, fileName, optionsKey(ResourceType::Texture, flags, uint32_t(usage)), [&]() {
+		return m_loader->loadTexture(fileName, usage, flags);
+	});
+}
+
+ResourceHandle<ShaderProgram> ResourceManager::loadProgram(const std::string& name, const std::string& source, const std::string& vertexPrelude) {
+	uint64_t contentKey = hashString(source, hashString(vertexPrelude, optionsKey(ResourceType::Shader, 0, 0)));
+	auto byContent = m_byContent.find(contentKey);
+	if (byContent != m_byContent.end()) {
+		m_counters.contentHits++;
+		return ResourceHandle<ShaderProgram>(static_cast<Resource<ShaderProgram>*>(byContent->second));
+	}
+
+	auto record = std::make_unique<Resource<ShaderProgram>>();
+	record->m_name = name;
+	record->m_type = ResourceType::Shader;
+	record->m_contentKey = contentKey;
+	record->m_contentChecked = true;
+	record->m_lastUsed = m_frame;
+	record->m_asset = std::make_shared<Asset<ShaderProgram>>();
+
+	ShaderProgram& program = record->m_asset->get();
+	program.create();
+	program.setVertexPrelude(vertexPrelude);
+	program.addProgram(source, name);
+	program.submit();
+	record->m_asset->finish(AssetState::Ready);
+
+	ResourceRecord* ptr = record.get();
+	m_records.push_back(std::move(record));
+	m_byContent[contentKey] = ptr;
+	m_counters.loads++;
+
+	return ResourceHandle<ShaderProgram>(static_cast<Resource<ShaderProgram>*>(ptr));
+}
+
+void ResourceManager::dedupe(ResourceRecord* record) {
+	record->m_contentChecked = true;
+	uint64_t hash = record->contentHash();
+	if (hash == 0 || record->state() != AssetState::Ready) return;
+
+	uint64_t contentKey = hashBytes(&hash, sizeof(hash), record->m_options);
+	auto byContent = m_byContent.find(contentKey);
+	if (byContent == m_byContent.end()) {
+		record->m_contentKey = contentKey;
+		m_byContent[contentKey] = record;
+		return;
+	}
+
+	ResourceRecord* target = byContent->second;
+	LOG(INFO) << record->name() << ": same content as " << target->name() << "\n";
+	record->share(target, m_loader ? m_loader->textureStreamer() : nullptr);
+	record->m_alias = target;
+	target->addRef();
+	m_counters.contentHits++;
+}
+
+void ResourceManager::collect() {
+	m_frame++;
+
+	for (auto& record : m_records) {
+		if (!record->m_contentChecked && record->state() != AssetState::Pending) dedupe(record.get());
+	}
+
+	std::vector<ResourceRecord*> unused;
+	uint64_t cached = 0;
+	for (auto& record : m_records) {
+		if (record->refCount() > 0) {
+			record->m_lastUsed = m_frame;
+			continue;
+		}
+		// the loader still writes into pending assets
+		if (record->state() == AssetState::Pending) continue;
+
+		unused.push_back(record.get());
+		cached += record->memorySize();
+	}
+	if (cached <= m_cacheBudget) return;
+
+	std::sort(unused.begin(), unused.end(), [](const ResourceRecord* a, const ResourceRecord* b) {
+		return a->m_lastUsed < b->m_lastUsed;
+	});
+	for (ResourceRecord* record : unused) {
+		if (cached <= m_cacheBudget) break;
+		cached -= record->memorySize();
+		evict(record);
+	}
+}
+
+size_t ResourceManager::unloadUnused() {
+	std::vector<ResourceRecord*> unused;
+	for (auto& record : m_records) {
+		if (record->refCount() == 0 && record->state() != AssetState::Pending) unused.push_back(record.get());
+	}
+	for (ResourceRecord* record : unused) evict(record);
+	return unused.size();
+}
+
+void ResourceManager::evict(ResourceRecord* record) {
+	LOG(INFO) << "Unloading " << record->name() << " (" << record->memorySize() / 1024 << " KB)\n";
+
+	// an alias only gives back its reference, the target owns the value
+	if (record->m_alias) record->m_alias->release();
+	else record->destroy(m_loader ? m_loader->textureStreamer() : nullptr);
+	for (uint64_t key : record->m_pathKeys) m_byPath.erase(key);
+	if (record->m_contentKey) m_byContent.erase(record->m_contentKey);
+
+	auto pos = std::find_if(m_records.begin(), m_records.end(), [record](const auto& r) { return r.get() == record; });
+	m_records.erase(pos);
+	m_counters.evictions++;
+}
+
+void ResourceManager::destroy() {
+	TextureStreamer* streamer = m_loader ? m_loader->textureStreamer() : nullptr;
+	for (auto& record : m_records) {
+		if (!record->m_alias) record->destroy(streamer);
+	}
+	m_records.clear();
+	m_byPath.clear();
+	m_byContent.clear();
+}
+
+ResourceStats ResourceManager::stats() {
+	ResourceStats stats = m_counters;
+	for (auto& record : m_records) {
+		size_t bytes = record->memorySize();
+		size_t type = size_t(record->type());
+		stats.count[type]++;
+		stats.bytes[type] += bytes;
+		if (record->refCount() == 0) {
+			stats.unreferenced++;
+			stats.unreferencedBytes += bytes;
+		}
+	}
+	return stats;
+}
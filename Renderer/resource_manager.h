@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "asset_loader.h"
+#include "shader_program.h"
+
+enum class ResourceType {
+	Mesh = 0,
+	Texture,
+	Shader,
+	Count
+};
+
+constexpr size_t ResourceTypeCount = size_t(ResourceType::Count);
+
+// Base of every managed resource. The intrusive count only tracks handles: the
+// manager owns the resource and keeps it cached once unreferenced, so a new
+// request revives it, until unloadUnused or the cache budget evicts it. A
+// resource found to have the same content as another one once loaded becomes
+// an alias of it, and holds a reference to it.
+class ResourceRecord {
+	friend class ResourceManager;
+	template <typename T> friend class ResourceHandle;
+public:
+	virtual ~ResourceRecord() = default;
+
+	const std::string& name() const { return m_name; }
+	ResourceType type() const { return m_type; }
+	uint32_t refCount() const { return m_refs.load(std::memory_order_acquire); }
+
+protected:
+	virtual AssetState state() const = 0;
+	virtual size_t memorySize() = 0;
+	virtual void destroy(TextureStreamer* streamer) = 0;
+	virtual uint64_t contentHash() const = 0;
+	// Destroys the own value and uses target's from now on.
+	virtual void share(ResourceRecord* target, TextureStreamer* streamer) = 0;
+
+	bool aliased() const { return m_alias != nullptr; }
+
+private:
+	std::atomic<uint32_t> m_refs{ 0 };
+	std::string m_name;
+	ResourceType m_type{ ResourceType::Mesh };
+	std::vector<uint64_t> m_pathKeys; // every path that resolved to this resource
+	uint64_t m_options{ 0 };
+	uint64_t m_contentKey{ 0 }; // set once loaded, 0 for aliases
+	bool m_contentChecked{ false };
+	ResourceRecord* m_alias{ nullptr };
+	uint64_t m_lastUsed{ 0 }; // last collect that saw it referenced
+
+	void addRef() { m_refs.fetch_add(1, std::memory_order_relaxed); }
+	void release() { m_refs.fetch_sub(1, std::memory_order_acq_rel); }
+};
+
+template <typename T>
+class Resource : public ResourceRecord {
+	friend class ResourceManager;
+	template <typename U> friend class ResourceHandle;
+protected:
+	AssetState state() const override { return m_asset->state(); }
+
+	size_t memorySize() override {
+		if (aliased() || !m_asset->ready()) return 0;
+		if constexpr (std::is_same_v<T, Mesh> || std::is_same_v<T, Texture>) return m_asset->get().memorySize();
+		else return 0;
+	}
+
+	void destroy(TextureStreamer* streamer) override {
+		if (!m_asset->ready()) return;
+		if constexpr (std::is_same_v<T, Texture>) {
+			if (streamer) streamer->remove(m_asset->get());
+		}
+		m_asset->get().destroy();
+	}
+
+	uint64_t contentHash() const override { return m_asset->contentHash(); }
+
+	void share(ResourceRecord* target, TextureStreamer* streamer) override {
+		destroy(streamer);
+		m_asset = static_cast<Resource<T>*>(target)->m_asset;
+	}
+
+private:
+	AssetHandle<T> m_asset;
+};
+
+// Counted reference to a managed resource, used like an AssetHandle.
+template <typename T>
+class ResourceHandle {
+public:
+	ResourceHandle() = default;
+	explicit ResourceHandle(Resource<T>* resource) : m_resource(resource) { if (m_resource) m_resource->addRef(); }
+	~ResourceHandle() { if (m_resource) m_resource->release(); }
+
+	ResourceHandle(const ResourceHandle& other) : ResourceHandle(other.m_resource) {}
+	ResourceHandle(ResourceHandle&& other) noexcept : m_resource(other.m_resource) { other.m_resource = nullptr; }
+
+	ResourceHandle& operator =(ResourceHandle other) noexcept {
+		std::swap(m_resource, other.m_resource);
+		return *this;
+	}
+
+	Asset<T>* operator->() const { return m_resource->m_asset.get(); }
+	Asset<T>& operator*() const { return *m_resource->m_asset; }
+	explicit operator bool() const { return m_resource != nullptr; }
+
+	const Resource<T>* resource() const { return m_resource; }
+
+private:
+	Resource<T>* m_resource{ nullptr };
+};
+
+struct ResourceStats {
+	uint32_t count[ResourceTypeCount]{};
+	uint64_t bytes[ResourceTypeCount]{};
+	uint32_t unreferenced{ 0 };
+	uint64_t unreferencedBytes{ 0 };
+
+	uint32_t loads{ 0 }; // requests that started a load
+	uint32_t pathHits{ 0 }; // requests served by an existing resource
+	uint32_t contentHits{ 0 }; // loads that turned out to be a copy of another resource
+	uint32_t evictions{ 0 };
+};
+
+// Maps paths and content hashes to shared Mesh/Texture/ShaderProgram resources,
+// so the same file with the same options is only loaded once. The same bytes
+// under another path are only known once the worker has hashed them, collect
+// then makes the later resource an alias and frees its copy. Meshes and
+// textures load through the AssetLoader.
+// Handles may be copied on any thread, everything else is GL thread only.
+class ResourceManager {
+public:
+	void create(AssetLoader* loader) { m_loader = loader; }
+	void destroy(); // destroys every resource, referenced or not
+
+	ResourceHandle<Mesh> loadMesh(const std::string& fileName, uint32_t flags = MeshDefaultFlags, VertexFormat format = VertexFormat::Full);
+	ResourceHandle<Mesh> importMesh(const std::string& fileName, uint32_t flags = MeshDefaultFlags, VertexFormat format = VertexFormat::Full);
+	ResourceHandle<Texture> loadTexture(const std::string& fileName, TextureUsage usage = TextureUsage::Diffuse, uint32_t flags = TextureDefaultFlags);
+
+	// Effect source as taken by ShaderProgram::addProgram, keyed by content.
+	ResourceHandle<ShaderProgram> loadProgram(const std::string& name, const std::string& source, const std::string& vertexPrelude = "");
+
+	// Bytes of unreferenced resources kept around for reuse.
+	void setCacheBudget(uint64_t bytes) { m_cacheBudget = bytes; }
+
+	// Once per frame. Merges resources that finished loading with the same
+	// content, then evicts the least recently used unreferenced resources
+	// while the cache is over budget.
+	void collect();
+
+	// Destroys every unreferenced resource now. Returns how many went.
+	size_t unloadUnused();
+
+	ResourceStats stats();
+
+private:
+	AssetLoader* m_loader{ nullptr };
+	std::vector<std::unique_ptr<ResourceRecord>> m_records;
+	std::unordered_map<uint64_t, ResourceRecord*> m_byPath, m_byContent;
+	uint64_t m_cacheBudget{ 64ull * 1024 * 1024 };
+	uint64_t m_frame{ 0 };
+	ResourceStats m_counters{};
+
+	template <typename T, typename Load>
+	ResourceHandle<T> acquire(ResourceType type, const std::string& fileName, uint64_t options, Load&& load);
+
+	template <typename T>
+	ResourceHandle<T> adopt(ResourceRecord* record, uint64_t pathKey);
+
+	void dedupe(ResourceRecord* record);
+	void evict(ResourceRecord* record);
+};
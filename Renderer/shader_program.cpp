@@ -1,6 +1,12 @@
 #include "shader_program.h"
 
-#include "parser_tools.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "effect_parser.h"
+#include "program_cache.h"
+#include "hash.h"
 
 void ShaderProgram::create() {
 	m_program = glCreateProgram();
@@ -11,95 +17,128 @@ void ShaderProgram::addShader(const std::string& source, ShaderType type) {
 		LOG(ERROR) << "Cannot add a new shader to an invalid program.\n";
 		return;
 	}
+	m_stages.push_back({ GLenum(type), withPrelude(source, GLenum(type)), {} });
+}
+
+void ShaderProgram::addProgram(const std::string& source, const std::string& name) {
+	if (!valid()) {
+		LOG(ERROR) << "Cannot add a new shader to an invalid program.\n";
+		return;
+	}
+
+	Effect effect;
+	if (!parseEffect(source, effect, name)) return;
 
-	GLuint shader = createShader(source, (GLenum)type);
-	if (shader) {
-		glAttachShader(m_program, shader);
-		m_shaders.push_back(shader);
+	for (const EffectStage& stage : effect.stages) {
+		m_stages.push_back({ GLenum(stage.type), withPrelude(stage.source, GLenum(stage.type)), effect.files });
 	}
 }
 
-void ShaderProgram::addProgram(const std::string& source) {
-	Scanner sc(source);
-
-	std::string region = "";
-
-	while (sc.hasNext()) {
-		char c = sc.peek();
-		if (::isalpha(c)) {
-			std::string id = sc.scanWhileMatch([](char c) { return ::isalpha(c) || c == '_'; });
-			std::transform(id.begin(), id.end(), id.begin(), ::tolower);
-			region = id;
-		} else if (c == '{') {
-			sc.scan();
-			int bracketCount = 1;
-
-			std::string src = "";
-
-			while (bracketCount > 0) {
-				src += sc.scan();
-
-				if (sc.peek() == '{')
-					bracketCount++;
-				else if (sc.peek() == '}')
-					bracketCount--;
-			}
-
-			if (sc.peek() == '}') sc.scan();
-
-			// trim start (remote leading spaces)
-			size_t start = src.find_first_not_of(" \n\r\t\f\v");
-			src = (start == std::string::npos) ? "" : src.substr(start);
-
-			if (region == "vertex_shader") {
-				addShader(src, ShaderType::VertexShader);
-			} else if (region == "fragment_shader") {
-				addShader(src, ShaderType::FragmentShader);
-			} else if (region == "geometry_shader") {
-				addShader(src, ShaderType::GeometryShader);
-			} else if (region == "compute_shader") {
-				addShader(src, ShaderType::ComputeShader);
-			} else {
-				LOG(WARNING) << "Unknown shader region.\n";
-			}
-			region = "";
-		} else {
-			sc.scan();
+// GL_KHR_parallel_shader_compile (or the ARB one, same enum), which glad core
+// does not define.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static bool parallelCompileSupported() {
+	static int supported = -1;
+	if (supported < 0) {
+		supported = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count && !supported; i++) {
+			auto ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+			supported = ext && (!strcmp(ext, "GL_KHR_parallel_shader_compile") || !strcmp(ext, "GL_ARB_parallel_shader_compile"));
 		}
 	}
+	return supported > 0;
 }
 
 void ShaderProgram::link() {
+	submit();
+	finish();
+}
+
+void ShaderProgram::submit() {
 	if (!valid()) {
 		LOG(ERROR) << "Cannot link an invalid program.\n";
 		return;
 	}
 
-	glLinkProgram(m_program);
+	m_submitTime = std::chrono::high_resolution_clock::now();
+
+	// every stage source with its prelude, and the driver
+	ProgramCache& cache = programCache();
+	m_cacheKey = cache.driverKey();
+	for (const Stage& stage : m_stages) m_cacheKey = hashString(stage.source, hashBytes(&stage.type, sizeof(stage.type), m_cacheKey));
+
+	m_fromCache = cache.load(m_program, m_cacheKey);
+	if (!m_fromCache) {
+		for (const Stage& stage : m_stages) {
+			GLuint shader = glCreateShader(stage.type);
+			const char* src = stage.source.c_str();
+			glShaderSource(shader, 1, &src, nullptr);
+			glCompileShader(shader);
+			glAttachShader(m_program, shader);
+			m_shaders.push_back(shader);
+		}
+
+		cache.prepare(m_program);
+		glLinkProgram(m_program);
+	}
+	m_pending = true;
+}
+
+bool ShaderProgram::ready() {
+	if (!m_pending) return true;
+	if (!parallelCompileSupported()) return true;
+
+	GLint done = GL_FALSE;
+	glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+bool ShaderProgram::finish() {
+	if (!m_pending) return valid();
+	m_pending = false;
 
 	GLint status;
 	glGetProgramiv(m_program, GL_LINK_STATUS, &status);
 	if (status != GL_TRUE) {
+		// only now that it failed, find out which stage did
+		for (size_t i = 0; i < m_shaders.size(); i++) {
+			logCompileErrors(m_shaders[i], m_stages[i].files.empty() ? nullptr : &m_stages[i].files);
+		}
 		glDeleteProgram(m_program);
+		glState().deleted(GL_PROGRAM, m_program);
 		m_program = 0;
-		return;
+		m_stages.clear();
+		m_shaders.clear();
+		return false;
 	}
 
+	ProgramCache& cache = programCache();
+	if (!m_fromCache) cache.store(m_program, m_cacheKey);
+	cache.record(m_fromCache, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_submitTime).count());
+	m_stages.clear();
+
 	/*for (auto s : m_shaders) {
 		glDetachShader(m_program, s);
 		glDeleteShader(s);
 	}*/
 	m_shaders.clear();
+	return true;
 }
 
 void ShaderProgram::destroy() {
 	for (auto& [k, buf] : m_uniformBuffers) {
 		buf.destroy();
 	}
-	if (valid()) { glDeleteProgram(m_program); m_program = 0; }
+	if (valid()) { glDeleteProgram(m_program); glState().deleted(GL_PROGRAM, m_program); m_program = 0; }
 }
 
 ShaderProgram::Uniform ShaderProgram::operator[](const std::string& name) {
+	resolve();
 	auto pos = m_uniforms.find(name);
 	if (pos == m_uniforms.end()) {
 		GLint loc = glGetUniformLocation(m_program, name.c_str());
@@ -110,7 +149,16 @@ ShaderProgram::Uniform ShaderProgram::operator[](const std::string& name) {
 	return m_uniforms[name];
 }
 
+bool ShaderProgram::uniformBlock(const std::string& name, uint32_t index) {
+	resolve();
+	GLuint block = glGetUniformBlockIndex(m_program, name.c_str());
+	if (block == GL_INVALID_INDEX) return false;
+	glUniformBlockBinding(m_program, block, index);
+	return true;
+}
+
 std::optional<GLuint> ShaderProgram::attribute(const std::string& name) {
+	resolve();
 	auto pos = m_attributes.find(name);
 	if (pos == m_attributes.end()) {
 		GLint loc = glGetAttribLocation(m_program, name.c_str());
@@ -121,24 +169,35 @@ std::optional<GLuint> ShaderProgram::attribute(const std::string& name) {
 	return m_attributes[name];
 }
 
-GLuint ShaderProgram::createShader(const std::string& source, GLenum type) {
-	GLuint shader = glCreateShader(type);
-
-	const char* src = source.c_str();
-	glShaderSource(shader, 1, &src, nullptr);
-	glCompileShader(shader);
+std::string ShaderProgram::withPrelude(const std::string& source, GLenum type) const {
+	std::string prelude = m_defines;
+	if (type == GL_VERTEX_SHADER) prelude += m_vertexPrelude;
+	if (prelude.empty()) return source;
+
+	std::string full = source;
+	size_t at = 0, version = full.find("#version");
+	if (version != std::string::npos) {
+		at = full.find('\n', version);
+		if (at == std::string::npos) {
+			full += '\n';
+			at = full.size();
+		} else {
+			at++;
+		}
+	}
+	// back to the numbering of the source after the prelude
+	size_t line = std::count(full.begin(), full.begin() + at, '\n') + 1;
+	full.insert(at, prelude + "\n#line " + std::to_string(line) + " 0\n");
+	return full;
+}
 
+void ShaderProgram::logCompileErrors(GLuint shader, const std::vector<std::string>* files) {
 	GLint status;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-	if (status != GL_TRUE) {
-		std::string buf; buf.resize(1024);
-		glGetShaderInfoLog(shader, buf.size(), nullptr, &buf[0]);
+	if (status == GL_TRUE) return;
 
-		LOG(ERROR) << buf << "\n";
-
-		glDeleteShader(shader);
-		return 0;
-	}
+	std::string buf; buf.resize(1024);
+	glGetShaderInfoLog(shader, buf.size(), nullptr, &buf[0]);
 
-	return shader;
+	LOG(ERROR) << (files ? mapShaderLog(buf.c_str(), *files) : buf) << "\n";
 }
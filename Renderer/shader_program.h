@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -7,6 +8,7 @@
 #include <optional>
 
 #include "glad.h"
+#include "gl_state.h"
 #include "linalg.h"
 #include "aixlog.hpp"
 
@@ -45,18 +47,44 @@ public:
 	~ShaderProgram() = default;
 
 	void create();
+
+	// Inserted right after the #version line of every vertex shader added afterwards.
+	void setVertexPrelude(const std::string& prelude) { m_vertexPrelude = prelude; }
+	// Inserted after the #version line of every stage added afterwards, before the vertex prelude.
+	void setDefines(const std::string& defines) { m_defines = defines; }
+
+	// Stages are compiled by link, unless the program binary cache has the program.
 	void addShader(const std::string& source, ShaderType type);
-	void addProgram(const std::string& source);
+	// Effect source with one region per stage, see parseEffect. name is what
+	// compiler errors are reported against.
+	void addProgram(const std::string& source, const std::string& name = "effect");
+	// Compiles and links, blocking until done. Same as submit() and finish().
 	void link();
 
+	// Starts compiling and linking without waiting for the driver, so programs
+	// submitted together can build in parallel (KHR_parallel_shader_compile).
+	// Nothing is checked until finish, which bind(), uniform and attribute
+	// lookups call on their own the first time they need the program.
+	void submit();
+	// False while the driver is still at it, finish() would block. Always true
+	// without KHR_parallel_shader_compile.
+	bool ready();
+	// Waits for the program, logs errors and stores it in the binary cache.
+	bool finish();
+	bool pending() const { return m_pending; }
+
 	void destroy();
 	bool valid() const { return m_program > 0; }
 
-	void bind() { glUseProgram(m_program); }
+	void bind() { resolve(); glState().useProgram(m_program); }
 
 	Uniform operator[](const std::string& name);
 	std::optional<GLuint> attribute(const std::string& name);
 
+	// Points a uniform block at a binding point, for data bound there with
+	// glState().bindBufferRange. False if the program has no such block.
+	bool uniformBlock(const std::string& name, uint32_t index);
+
 	template <typename T>
 	void uniformBuffer(const std::string& name, T data, uint32_t index = 0) {
 		auto& buf = uniformBufferCreate<T>(name, index);
@@ -78,43 +106,60 @@ public:
 	}
 
 private:
+	struct Stage {
+		GLenum type;
+		std::string source; // with the prelude
+		std::vector<std::string> files; // source string names for the compiler log
+	};
+
 	GLuint m_program{ 0 };
+	std::vector<Stage> m_stages{};
+	bool m_pending{ false }, m_fromCache{ false };
+	uint64_t m_cacheKey{ 0 };
+	std::chrono::high_resolution_clock::time_point m_submitTime{};
 	std::vector<GLuint> m_shaders{};
+	std::string m_vertexPrelude{}, m_defines{};
 
 	std::map<std::string, Uniform> m_uniforms{};
 	std::map<std::string, Buffer> m_uniformBuffers{};
 	std::map<std::string, GLuint> m_attributes{};
 
-	GLuint createShader(const std::string& source, GLenum type);
+	std::string withPrelude(const std::string& source, GLenum type) const;
+	void logCompileErrors(GLuint shader, const std::vector<std::string>* files);
+	void resolve() { if (m_pending) finish(); }
 
 	template <typename T>
 	Buffer& uniformBufferCreate(const std::string& name, uint32_t index = 0) {
-		if (m_uniformBuffers.find(name) == m_uniformBuffers.end()) {
+		resolve();
+		auto pos = m_uniformBuffers.find(name);
+		if (pos == m_uniformBuffers.end()) {
 			uint32_t ubi = glGetUniformBlockIndex(m_program, name.c_str());
 			Buffer buf = Buffer();
 			buf.create(BufferType::UniformBuffer, BufferUsage::StreamDraw, sizeof(T));
 
 			glUniformBlockBinding(m_program, ubi, index);
-			glBindBufferBase(GL_UNIFORM_BUFFER, index, buf.object());
-
-			m_uniformBuffers[name] = buf;
+			pos = m_uniformBuffers.emplace(name, buf).first;
 		}
-		return m_uniformBuffers[name];
+		// the binding point is shared with every other program using it
+		glState().bindBufferBase(GL_UNIFORM_BUFFER, index, pos->second.object());
+		return pos->second;
 	}
 
 	template <typename T>
 	Buffer& uniformBufferCreateArray(const std::string& name, size_t count, uint32_t index = 0) {
-		if (m_uniformBuffers.find(name) == m_uniformBuffers.end()) {
+		resolve();
+		auto pos = m_uniformBuffers.find(name);
+		if (pos == m_uniformBuffers.end()) {
 			uint32_t ubi = glGetUniformBlockIndex(m_program, name.c_str());
 			Buffer buf = Buffer();
 			buf.create(BufferType::UniformBuffer, BufferUsage::StreamDraw, sizeof(T) * count);
 
 			glUniformBlockBinding(m_program, ubi, index);
-			glBindBufferBase(GL_UNIFORM_BUFFER, index, buf.object());
-
-			m_uniformBuffers[name] = buf;
+			pos = m_uniformBuffers.emplace(name, buf).first;
 		}
-		return m_uniformBuffers[name];
+		// the binding point is shared with every other program using it
+		glState().bindBufferBase(GL_UNIFORM_BUFFER, index, pos->second.object());
+		return pos->second;
 	}
 
 };
@@ -0,0 +1,72 @@
+#include "shader_variants.h"
+
+static const char* FeatureDefines[ShaderFeatureCount] = {
+	"INSTANCED",
+	"HAS_BONES",
+	"HAS_DIFFUSE_MAP",
+	"HAS_SPECULAR_MAP",
+	"HAS_NORMAL_MAP",
+	"HAS_EMISSION_MAP"
+};
+
+std::string shaderFeatureDefines(uint32_t features) {
+	std::string defines;
+	for (uint32_t i = 0; i < ShaderFeatureCount; i++) {
+		if (features & (1u << i)) {
+			defines += "#define ";
+			defines += FeatureDefines[i];
+			defines += '\n';
+		}
+	}
+	return defines;
+}
+
+void ShaderVariants::create(const std::string& vertexSource, const std::string& fragmentSource, Setup setup, const std::string& name) {
+	m_vertexSource = vertexSource;
+	m_fragmentSource = fragmentSource;
+	m_name = name;
+	m_setup = std::move(setup);
+}
+
+void ShaderVariants::destroy() {
+	for (auto& [key, v] : m_variants) {
+		if (v.program.valid()) v.program.destroy();
+	}
+	m_variants.clear();
+}
+
+ShaderVariants::Variant& ShaderVariants::variant(VertexFormat format, uint32_t features) {
+	if (!vertexFormatInfo(format).skinned) features &= ~ShaderHasBones;
+
+	uint32_t key = features | (uint32_t(format) << 16);
+	auto pos = m_variants.find(key);
+	if (pos != m_variants.end()) return pos->second;
+
+	Variant& v = m_variants[key];
+	ShaderProgram& program = v.program;
+	program.create();
+	program.setDefines(shaderFeatureDefines(features));
+	program.setVertexPrelude(vertexFormatPrelude(format));
+	if (m_fragmentSource.empty()) {
+		program.addProgram(m_vertexSource, m_name);
+	} else {
+		program.addShader(m_vertexSource, ShaderType::VertexShader);
+		program.addShader(m_fragmentSource, ShaderType::FragmentShader);
+	}
+	program.submit();
+	return v;
+}
+
+ShaderProgram& ShaderVariants::get(VertexFormat format, uint32_t features) {
+	return variant(format, features).program;
+}
+
+ShaderProgram& ShaderVariants::bind(VertexFormat format, uint32_t features) {
+	Variant& v = variant(format, features);
+	v.program.bind();
+	if (!v.setUp) {
+		if (m_setup) m_setup(v.program);
+		v.setUp = true;
+	}
+	return v.program;
+}
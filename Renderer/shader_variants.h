@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "shader_program.h"
+#include "vertex_format.h"
+
+// Each bit is a #define in every stage of a variant.
+enum ShaderFeature : uint32_t {
+	ShaderInstanced = 1 << 0, // INSTANCED
+	ShaderHasBones = 1 << 1, // HAS_BONES, only kept for skinned vertex formats
+	ShaderDiffuseMap = 1 << 2, // HAS_DIFFUSE_MAP
+	ShaderSpecularMap = 1 << 3, // HAS_SPECULAR_MAP
+	ShaderNormalMap = 1 << 4, // HAS_NORMAL_MAP
+	ShaderEmissionMap = 1 << 5, // HAS_EMISSION_MAP
+	ShaderFeatureCount = 6
+};
+
+std::string shaderFeatureDefines(uint32_t features);
+
+// One source compiled into a program per vertex format and feature mask, on
+// first use. Variants go through the program binary cache like any program.
+class ShaderVariants {
+public:
+	// Called once per variant, bound, the first time it is used. For uniforms
+	// that never change such as sampler units.
+	using Setup = std::function<void(ShaderProgram&)>;
+
+	// A vertex/fragment pair, or an effect when fragmentSource is empty.
+	void create(const std::string& vertexSource, const std::string& fragmentSource, Setup setup = nullptr, const std::string& name = "effect");
+	void destroy();
+
+	// Submits the variant if it does not exist yet, without waiting for it.
+	ShaderProgram& get(VertexFormat format, uint32_t features);
+	// Binds the variant, resolving and setting it up on first use. Only waits
+	// for the driver if the variant is still compiling, get() it ahead of time
+	// to avoid that.
+	ShaderProgram& bind(VertexFormat format, uint32_t features);
+
+	size_t size() const { return m_variants.size(); }
+
+private:
+	struct Variant {
+		ShaderProgram program;
+		bool setUp{ false };
+	};
+
+	std::string m_vertexSource, m_fragmentSource, m_name;
+	Setup m_setup;
+	std::unordered_map<uint32_t, Variant> m_variants;
+
+	Variant& variant(VertexFormat format, uint32_t features);
+};
@@ -1,11 +1,11 @@
 #pragma once
 
-constexpr auto DefaultVert =
-#include "default.vert"
+constexpr auto VertexInputSrc =
+#include "vertex_input.glsl"
 ;
 
-constexpr auto DefaultInstancedVert =
-#include "default_instanced.vert"
+constexpr auto DefaultVert =
+#include "default.vert"
 ;
 
 constexpr auto QuadVert =
@@ -30,8 +30,4 @@ constexpr auto LightPassFrag =
 
 constexpr auto ShadowSrc =
 #include "shadow.glsl"
-;
-
-constexpr auto ShadowInstSrc =
-#include "shadow_instanced.glsl"
 ;
\ No newline at end of file
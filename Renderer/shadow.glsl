@@ -2,16 +2,23 @@ R""(
 
 vertex_shader {
 	#version 330 core
-	layout (location = 0) in vec3 vPosition;
-	layout (location = 4) in vec4 vWeights;
-	layout (location = 5) in uvec4 vJointIDs;
 
+#ifdef INSTANCED
+	layout (location = 6) in mat4 iModel;
+#else
 	uniform mat4 uModel;
+#endif
+
 	uniform mat4 uView;
 	uniform mat4 uProjection;
 
 	void main() {
-		gl_Position = uProjection * uView * uModel * vec4(vPosition, 1.0);
+#ifdef INSTANCED
+		mat4 model = iModel;
+#else
+		mat4 model = uModel;
+#endif
+		gl_Position = uProjection * uView * model * vec4(vertexPosition(), 1.0);
 	}
 }
 
@@ -20,4 +27,4 @@ fragment_shader {
 	void main() { }
 }
 
-)""
\ No newline at end of file
+)""
@@ -8,7 +8,10 @@ using namespace linalg::aliases;
 #include <string>
 
 struct Joint {
-	float4x4 transform, offset, correctionMatrix;
+	// local transform, the one it had when loaded, the inverse bind matrix and
+	// the transform of whatever sits above the skeleton's root
+	float4x4 transform{ linalg::identity }, restTransform{ linalg::identity };
+	float4x4 offset{ linalg::identity }, correctionMatrix{ linalg::identity };
 
 	int parent{ -1 };
 	std::vector<int> children;
@@ -22,6 +25,7 @@ public:
 	Joint& getJoint(int id) { return m_joints[id]; }
 	int getJointID(const std::string& name) { return m_jointNames[name]; }
 	size_t jointCount() const { return m_joints.size(); }
+	const std::map<std::string, int>& jointNames() const { return m_jointNames; }
 
 	float4x4 jointTransform(int id);
 
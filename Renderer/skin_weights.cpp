@@ -0,0 +1,67 @@
+#include "skin_weights.h"
+
+#include <algorithm>
+
+// Vertices with up to this many influences pick their top four with an
+// insertion pass in registers, busier ones partially sort their CSR range.
+constexpr uint32_t MaxInsertionInfluences = 8;
+
+struct JointWeight {
+	int32_t joint;
+	float weight;
+};
+
+// Heavier first, ties go to the lower joint so the result does not depend on input order.
+static bool heavier(const JointWeight& a, const JointWeight& b) {
+	return a.weight > b.weight || (a.weight == b.weight && a.joint < b.joint);
+}
+
+SkinWeightStats SkinWeightBuilder::apply(Vertex* vertices) const {
+	SkinWeightStats stats{};
+	if (m_influences.empty()) return stats;
+
+	// count, prefix sum, scatter
+	std::vector<uint32_t> offsets(m_vertexCount + 1, 0);
+	for (const Influence& in : m_influences) offsets[in.vertex + 1]++;
+	for (size_t i = 0; i < m_vertexCount; i++) offsets[i + 1] += offsets[i];
+
+	std::vector<JointWeight> weights(m_influences.size());
+	std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+	for (const Influence& in : m_influences) weights[cursor[in.vertex]++] = { in.joint, in.weight };
+
+	for (size_t v = 0; v < m_vertexCount; v++) {
+		JointWeight* begin = weights.data() + offsets[v];
+		uint32_t n = offsets[v + 1] - offsets[v];
+		if (n == 0) continue;
+
+		JointWeight top[4]{ { -1, 0.0f }, { -1, 0.0f }, { -1, 0.0f }, { -1, 0.0f } };
+		uint32_t kept = std::min(n, 4u);
+		if (n <= MaxInsertionInfluences) {
+			for (uint32_t i = 0; i < n; i++) {
+				JointWeight w = begin[i];
+				uint32_t j = std::min(i, 4u);
+				if (j == 4 && !heavier(w, top[3])) continue;
+				if (j == 4) j = 3;
+				for (; j > 0 && heavier(w, top[j - 1]); j--) top[j] = top[j - 1];
+				top[j] = w;
+			}
+		} else {
+			std::partial_sort(begin, begin + 4, begin + n, heavier);
+			std::copy(begin, begin + 4, top);
+		}
+
+		float sum = 0.0f;
+		for (uint32_t i = 0; i < kept; i++) sum += top[i].weight;
+
+		Vertex& vert = vertices[v];
+		for (uint32_t i = 0; i < 4; i++) {
+			vert.jointIDs[i] = top[i].joint;
+			vert.jointWeights[i] = i < kept ? top[i].weight / sum : 0.0f;
+		}
+
+		stats.skinned++;
+		if (n > 4) stats.truncated++;
+		stats.maxInfluences = std::max<size_t>(stats.maxInfluences, n);
+	}
+	return stats;
+}
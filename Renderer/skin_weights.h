@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+struct SkinWeightStats {
+	size_t skinned{ 0 }; // vertices with at least one influence
+	size_t truncated{ 0 }; // vertices that had more than four
+	size_t maxInfluences{ 0 };
+};
+
+// Gathers joint influences in any order and writes the four strongest of each
+// vertex, renormalized to sum to one, into Vertex::jointIDs/jointWeights.
+// Influences are bucketed by vertex with a counting sort (CSR), so apply runs
+// in O(vertices + influences) with no allocation per vertex.
+class SkinWeightBuilder {
+public:
+	explicit SkinWeightBuilder(size_t vertexCount) : m_vertexCount(vertexCount) {}
+
+	void reserve(size_t influences) { m_influences.reserve(influences); }
+
+	// Influences with no weight, a negative joint or an out of range vertex are dropped.
+	void add(uint32_t vertex, int32_t joint, float weight) {
+		if (vertex < m_vertexCount && joint >= 0 && weight > 0.0f) m_influences.push_back({ vertex, joint, weight });
+	}
+
+	// Vertices without influences are left as they are.
+	SkinWeightStats apply(Vertex* vertices) const;
+
+private:
+	struct Influence {
+		uint32_t vertex;
+		int32_t joint;
+		float weight;
+	};
+
+	size_t m_vertexCount;
+	std::vector<Influence> m_influences;
+};
@@ -0,0 +1,115 @@
+#include "stream_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Long enough to never trip on a slow frame, it only bounds a lost fence.
+constexpr GLuint64 FenceTimeout = 1000000000ull;
+
+void StreamAllocator::create(size_t bufferSize) {
+	m_bufferSize = bufferSize;
+	m_persistent = GLAD_GL_VERSION_4_4;
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0) m_uniformAlignment = size_t(alignment);
+
+	// one buffer per frame up front, more only if a frame needs them
+	for (auto& frame : m_frames) addBlock(frame, m_bufferSize);
+}
+
+void StreamAllocator::destroy() {
+	for (auto& frame : m_frames) {
+		if (frame.fence) {
+			glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceTimeout);
+			glDeleteSync(frame.fence);
+			frame.fence = nullptr;
+		}
+		for (auto& block : frame.blocks) {
+			if (block->mapped) {
+				block->buffer.bind();
+				block->buffer.unmap();
+			}
+			block->buffer.destroy();
+		}
+		frame.blocks.clear();
+		frame.current = 0;
+	}
+}
+
+StreamAllocator::Block& StreamAllocator::addBlock(Frame& frame, size_t size) {
+	auto block = std::make_unique<Block>();
+	block->buffer.create(BufferType::ArrayBuffer, BufferUsage::StreamDraw);
+	block->size = size;
+	block->id = m_nextId++;
+	if (m_persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		block->buffer.storage(size, flags);
+		block->mapped = static_cast<uint8_t*>(block->buffer.mapRange(0, size, flags));
+	} else {
+		block->buffer.allocate(size);
+	}
+
+	m_total.buffers++;
+	frame.blocks.push_back(std::move(block));
+	return *frame.blocks.back();
+}
+
+StreamAllocation StreamAllocator::write(const void* data, size_t size, size_t alignment) {
+	Frame& frame = m_frames[m_frame];
+
+	// the first block of the frame with room left, a new one if none has
+	Block* block = nullptr;
+	size_t offset = 0;
+	for (; frame.current < frame.blocks.size(); frame.current++) {
+		Block& b = *frame.blocks[frame.current];
+		offset = (b.head + alignment - 1) / alignment * alignment;
+		if (offset + size <= b.size) {
+			block = &b;
+			break;
+		}
+	}
+	if (!block) {
+		block = &addBlock(frame, std::max(size, m_bufferSize));
+		frame.current = frame.blocks.size() - 1;
+		offset = 0;
+	}
+
+	if (block->mapped) {
+		std::memcpy(block->mapped + offset, data, size);
+	} else {
+		// the frame's fence already says the GPU is done with this range
+		void* dst = block->buffer.mapRange(offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		std::memcpy(dst, data, size);
+		block->buffer.unmap();
+	}
+	block->head = offset + size;
+
+	m_frameStats.bytes += size;
+	m_total.bytes += size;
+	return { &block->buffer, block->id, offset };
+}
+
+void StreamAllocator::endFrame() {
+	Frame& done = m_frames[m_frame];
+	done.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	m_frame = (m_frame + 1) % FramesInFlight;
+	Frame& next = m_frames[m_frame];
+	if (next.fence) {
+		GLenum status = glClientWaitSync(next.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			m_frameStats.waits++;
+			m_total.waits++;
+			glClientWaitSync(next.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceTimeout);
+		}
+		glDeleteSync(next.fence);
+		next.fence = nullptr;
+	}
+	for (auto& block : next.blocks) block->head = 0;
+	next.current = 0;
+
+	m_frameStats.buffers = m_total.buffers;
+	m_lastFrame = m_frameStats;
+	m_frameStats = StreamAllocatorStats{};
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "buffer.h"
+
+// Where a write landed. Valid until the allocator's frame comes around again.
+struct StreamAllocation {
+	Buffer* buffer{ nullptr };
+	uint32_t bufferId{ 0 }; // unique per buffer, GL can reuse names
+	size_t offset{ 0 };
+
+	bool valid() const { return buffer != nullptr; }
+};
+
+struct StreamAllocatorStats {
+	uint64_t bytes{ 0 };
+	uint32_t waits{ 0 }; // frames that had to wait for the GPU to release their buffers
+	uint32_t buffers{ 0 }; // created so far, over all frames
+};
+
+// Linear allocator for data written every frame: instances, uniform blocks,
+// bone palettes. Each of the FramesInFlight frames has its own buffers and a
+// fence, so a frame's memory is only reused after the GPU is done with it and
+// writes never sync with the driver. Buffers are persistently mapped with GL
+// 4.4, otherwise every write is an unsynchronized map, which the fences make
+// safe as well. A frame that runs out of room gets another buffer.
+class StreamAllocator {
+public:
+	static constexpr uint32_t FramesInFlight = 3;
+
+	void create(size_t bufferSize = 4 * 1024 * 1024);
+	void destroy();
+
+	// alignment does not have to be a power of two (instances use their size).
+	StreamAllocation write(const void* data, size_t size, size_t alignment = 16);
+
+	// After the last draw of the frame. Fences it and waits for the oldest one.
+	void endFrame();
+
+	// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, queried once by create.
+	size_t uniformAlignment() const { return m_uniformAlignment; }
+	bool persistent() const { return m_persistent; }
+
+	// Counted since the last endFrame, and since create.
+	const StreamAllocatorStats& lastFrame() const { return m_lastFrame; }
+	const StreamAllocatorStats& total() const { return m_total; }
+
+private:
+	struct Block {
+		Buffer buffer{};
+		uint32_t id{ 0 };
+		uint8_t* mapped{ nullptr };
+		size_t size{ 0 }, head{ 0 };
+	};
+	struct Frame {
+		std::vector<std::unique_ptr<Block>> blocks; // stable addresses for StreamAllocation::buffer
+		size_t current{ 0 };
+		GLsync fence{ nullptr };
+	};
+
+	Frame m_frames[FramesInFlight];
+	uint32_t m_frame{ 0 }, m_nextId{ 1 };
+	size_t m_bufferSize{ 0 }, m_uniformAlignment{ 256 };
+	bool m_persistent{ false };
+
+	StreamAllocatorStats m_frameStats{}, m_lastFrame{}, m_total{};
+
+	Block& addBlock(Frame& frame, size_t size);
+};
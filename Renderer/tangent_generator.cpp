@@ -0,0 +1,349 @@
+#include "tangent_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TANGENT_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// Meshes with fewer triangles than this are done on the calling thread.
+constexpr size_t MinParallelTriangles = 32 * 1024;
+
+// Every thread sums into 32 bytes per vertex, more threads than this cost more
+// memory and reduction time than they save.
+constexpr size_t MaxThreads = 8;
+
+// Orientation of a triangle in uv space.
+enum : uint8_t {
+	OrientFlipped = 0, // negative uv area, bitangent sign -1
+	OrientPreserving = 1,
+	OrientAny = 2 // degenerate, adds nothing and follows whatever its vertices get
+};
+
+// Four triangles, one array per component so each SSE lane is a triangle.
+struct alignas(16) TriangleBatch {
+	float p[3][3][4]; // [corner][axis][lane]
+	float n[3][3][4];
+	float uv[3][2][4];
+};
+
+// Unit tangent projected onto each corner's normal and its angle weight.
+struct alignas(16) CornerBatch {
+	float t[3][4][4]; // [corner][x, y, z, weight][lane]
+	float area[4]; // signed uv area, its sign is the orientation
+};
+
+// Tangent sum of one vertex and orientation, w is the total weight.
+struct alignas(16) TangentSum {
+	float v[4]{ 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+static void loadBatch(const Vertex* vertices, const uint32_t* tri, size_t count, TriangleBatch& b) {
+	for (size_t l = 0; l < 4; l++) {
+		// pad with the last triangle, padded lanes are never accumulated
+		const uint32_t* t = tri + std::min(l, count - 1) * 3;
+		for (int c = 0; c < 3; c++) {
+			const Vertex& v = vertices[t[c]];
+			for (int k = 0; k < 3; k++) {
+				b.p[c][k][l] = v.position[k];
+				b.n[c][k][l] = v.normal[k];
+			}
+			b.uv[c][0][l] = v.texCoord.x;
+			b.uv[c][1][l] = v.texCoord.y;
+		}
+	}
+}
+
+#ifdef TANGENT_GENERATOR_SSE2
+struct Vec3x4 {
+	__m128 x, y, z;
+};
+
+static Vec3x4 load3(const float src[3][4]) {
+	return { _mm_load_ps(src[0]), _mm_load_ps(src[1]), _mm_load_ps(src[2]) };
+}
+
+static Vec3x4 sub3(const Vec3x4& a, const Vec3x4& b) {
+	return { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+}
+
+static __m128 dot3(const Vec3x4& a, const Vec3x4& b) {
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+// rsqrt refined with one Newton step, good to about 1e-7 relative.
+static __m128 rsqrt4(__m128 x) {
+	__m128 r = _mm_rsqrt_ps(x);
+	__m128 rx = _mm_mul_ps(_mm_mul_ps(r, r), x);
+	return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r), _mm_sub_ps(_mm_set1_ps(3.0f), rx));
+}
+
+// v - n * dot(n, v)
+static Vec3x4 project(const Vec3x4& v, const Vec3x4& n) {
+	__m128 d = dot3(n, v);
+	return {
+		_mm_sub_ps(v.x, _mm_mul_ps(n.x, d)),
+		_mm_sub_ps(v.y, _mm_mul_ps(n.y, d)),
+		_mm_sub_ps(v.z, _mm_mul_ps(n.z, d))
+	};
+}
+
+// project(v, n) normalized. Zero where that is too short, with valid cleared.
+static Vec3x4 projectNormalize(const Vec3x4& v, const Vec3x4& n, __m128& valid) {
+	Vec3x4 r = project(v, n);
+	__m128 len2 = dot3(r, r);
+	__m128 ok = _mm_cmpgt_ps(len2, _mm_set1_ps(1e-20f));
+	__m128 inv = _mm_and_ps(rsqrt4(_mm_max_ps(len2, _mm_set1_ps(1e-20f))), ok);
+	valid = _mm_and_ps(valid, ok);
+	return { _mm_mul_ps(r.x, inv), _mm_mul_ps(r.y, inv), _mm_mul_ps(r.z, inv) };
+}
+
+// Abramowitz & Stegun 4.4.45, within 7e-5 rad.
+static __m128 acos4(__m128 x) {
+	__m128 a = _mm_min_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), x), _mm_set1_ps(1.0f));
+	__m128 p = _mm_set1_ps(-0.0187293f);
+	p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0742610f));
+	p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(-0.2121144f));
+	p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(1.5707288f));
+	__m128 r = _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a)));
+
+	// pi - r for negative x
+	__m128 neg = _mm_cmplt_ps(x, _mm_setzero_ps());
+	return _mm_or_ps(_mm_and_ps(neg, _mm_sub_ps(_mm_set1_ps(3.14159265f), r)), _mm_andnot_ps(neg, r));
+}
+
+static void computeCorners(const TriangleBatch& b, CornerBatch& out) {
+	Vec3x4 p[3] = { load3(b.p[0]), load3(b.p[1]), load3(b.p[2]) };
+	Vec3x4 e1 = sub3(p[1], p[0]), e2 = sub3(p[2], p[0]);
+
+	__m128 d1x = _mm_sub_ps(_mm_load_ps(b.uv[1][0]), _mm_load_ps(b.uv[0][0]));
+	__m128 d1y = _mm_sub_ps(_mm_load_ps(b.uv[1][1]), _mm_load_ps(b.uv[0][1]));
+	__m128 d2x = _mm_sub_ps(_mm_load_ps(b.uv[2][0]), _mm_load_ps(b.uv[0][0]));
+	__m128 d2y = _mm_sub_ps(_mm_load_ps(b.uv[2][1]), _mm_load_ps(b.uv[0][1]));
+	__m128 area = _mm_sub_ps(_mm_mul_ps(d1x, d2y), _mm_mul_ps(d1y, d2x));
+	_mm_store_ps(out.area, area);
+
+	// face tangent, flipped along with the uv winding so it always points along +u
+	__m128 flip = _mm_and_ps(area, _mm_set1_ps(-0.0f));
+	Vec3x4 os = {
+		_mm_xor_ps(_mm_sub_ps(_mm_mul_ps(d2y, e1.x), _mm_mul_ps(d1y, e2.x)), flip),
+		_mm_xor_ps(_mm_sub_ps(_mm_mul_ps(d2y, e1.y), _mm_mul_ps(d1y, e2.y)), flip),
+		_mm_xor_ps(_mm_sub_ps(_mm_mul_ps(d2y, e1.z), _mm_mul_ps(d1y, e2.z)), flip)
+	};
+
+	// no area in uv or in position space
+	Vec3x4 cr = {
+		_mm_sub_ps(_mm_mul_ps(e1.y, e2.z), _mm_mul_ps(e1.z, e2.y)),
+		_mm_sub_ps(_mm_mul_ps(e1.z, e2.x), _mm_mul_ps(e1.x, e2.z)),
+		_mm_sub_ps(_mm_mul_ps(e1.x, e2.y), _mm_mul_ps(e1.y, e2.x))
+	};
+	__m128 faceValid = _mm_and_ps(
+		_mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), area), _mm_set1_ps(1e-20f)),
+		_mm_cmpgt_ps(dot3(cr, cr), _mm_set1_ps(1e-30f))
+	);
+
+	for (int c = 0; c < 3; c++) {
+		Vec3x4 n = load3(b.n[c]);
+		__m128 valid = faceValid;
+		Vec3x4 t = projectNormalize(os, n, valid);
+
+		// angle between the edges leaving the corner, in the normal's plane
+		Vec3x4 a = project(sub3(p[(c + 1) % 3], p[c]), n);
+		Vec3x4 e = project(sub3(p[(c + 2) % 3], p[c]), n);
+		__m128 len2 = _mm_mul_ps(dot3(a, a), dot3(e, e));
+		valid = _mm_and_ps(valid, _mm_cmpgt_ps(len2, _mm_set1_ps(1e-30f)));
+		__m128 cosine = _mm_mul_ps(dot3(a, e), rsqrt4(_mm_max_ps(len2, _mm_set1_ps(1e-30f))));
+		cosine = _mm_max_ps(_mm_min_ps(cosine, _mm_set1_ps(1.0f)), _mm_set1_ps(-1.0f));
+		__m128 weight = _mm_and_ps(acos4(cosine), valid);
+
+		_mm_store_ps(out.t[c][0], t.x);
+		_mm_store_ps(out.t[c][1], t.y);
+		_mm_store_ps(out.t[c][2], t.z);
+		_mm_store_ps(out.t[c][3], weight);
+	}
+}
+#else
+static bool projectNormalize(float3& v, float3 n) {
+	v -= n * linalg::dot(n, v);
+	float len2 = linalg::length2(v);
+	if (len2 <= 1e-20f) return false;
+	v /= std::sqrt(len2);
+	return true;
+}
+
+static void computeCorners(const TriangleBatch& b, CornerBatch& out) {
+	for (int l = 0; l < 4; l++) {
+		float3 p[3], n[3];
+		float2 uv[3];
+		for (int c = 0; c < 3; c++) {
+			p[c] = { b.p[c][0][l], b.p[c][1][l], b.p[c][2][l] };
+			n[c] = { b.n[c][0][l], b.n[c][1][l], b.n[c][2][l] };
+			uv[c] = { b.uv[c][0][l], b.uv[c][1][l] };
+		}
+
+		float3 e1 = p[1] - p[0], e2 = p[2] - p[0];
+		float2 d1 = uv[1] - uv[0], d2 = uv[2] - uv[0];
+		float area = d1.x * d2.y - d1.y * d2.x;
+		out.area[l] = area;
+
+		float3 os = (d2.y * e1 - d1.y * e2) * (area < 0.0f ? -1.0f : 1.0f);
+		bool faceValid = std::abs(area) > 1e-20f && linalg::length2(linalg::cross(e1, e2)) > 1e-30f;
+
+		for (int c = 0; c < 3; c++) {
+			float3 t = os, a = p[(c + 1) % 3] - p[c], e = p[(c + 2) % 3] - p[c];
+			bool valid = faceValid;
+			valid = projectNormalize(t, n[c]) && valid;
+			valid = projectNormalize(a, n[c]) && valid;
+			valid = projectNormalize(e, n[c]) && valid;
+
+			float weight = valid ? std::acos(std::clamp(linalg::dot(a, e), -1.0f, 1.0f)) : 0.0f;
+			for (int k = 0; k < 3; k++) out.t[c][k][l] = valid ? t[k] : 0.0f;
+			out.t[c][3][l] = weight;
+		}
+	}
+}
+#endif
+
+// Sums triangles [begin, end) into sums, two entries per vertex (flipped, preserving).
+static void accumulate(
+	const Vertex* vertices, const uint32_t* indices, size_t begin, size_t end,
+	TangentSum* sums, uint8_t* orient
+) {
+	TriangleBatch batch;
+	CornerBatch corners;
+	for (size_t tri = begin; tri < end; tri += 4) {
+		size_t count = std::min<size_t>(4, end - tri);
+		const uint32_t* idx = indices + tri * 3;
+		loadBatch(vertices, idx, count, batch);
+		computeCorners(batch, corners);
+
+		for (size_t l = 0; l < count; l++) {
+			bool used = false;
+			size_t side = corners.area[l] > 0.0f ? OrientPreserving : OrientFlipped;
+			for (int c = 0; c < 3; c++) {
+				float w = corners.t[c][3][l];
+				if (w <= 0.0f) continue;
+
+				float* s = sums[size_t(idx[l * 3 + c]) * 2 + side].v;
+				s[0] += corners.t[c][0][l] * w;
+				s[1] += corners.t[c][1][l] * w;
+				s[2] += corners.t[c][2][l] * w;
+				s[3] += w;
+				used = true;
+			}
+			orient[tri + l] = used ? uint8_t(side) : uint8_t(OrientAny);
+		}
+	}
+}
+
+// Any unit vector orthogonal to n.
+static float3 orthogonal(float3 n) {
+	float3 axis = std::abs(n.x) < 0.9f ? float3{ 1.0f, 0.0f, 0.0f } : float3{ 0.0f, 1.0f, 0.0f };
+	float3 t = axis - n * linalg::dot(n, axis);
+	float len2 = linalg::length2(t);
+	return len2 > 1e-12f ? t / std::sqrt(len2) : axis;
+}
+
+static bool resolve(const TangentSum& sum, float3 n, float sign, float4& out) {
+	float3 t{ sum.v[0], sum.v[1], sum.v[2] };
+	t -= n * linalg::dot(n, t);
+	float len2 = linalg::length2(t);
+	if (sum.v[3] <= 0.0f || len2 <= 1e-20f) return false;
+	out = float4{ t / std::sqrt(len2), sign };
+	return true;
+}
+
+TangentStats generateTangents(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t threadCount) {
+	TangentStats stats{};
+	const size_t triCount = indices.size() / 3, vertCount = vertices.size();
+	if (vertCount == 0) return stats;
+
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+	size_t chunkCount = std::clamp<size_t>(triCount / MinParallelTriangles, 1, std::min<size_t>(threadCount, MaxThreads));
+
+	// every chunk sums into its own buffer, chunk 0 into the one that is kept
+	std::vector<std::vector<TangentSum>> sums(chunkCount);
+	std::vector<uint8_t> orient(triCount);
+	{
+		auto fn = [&](size_t i) {
+			sums[i].resize(vertCount * 2);
+			accumulate(
+				vertices.data(), indices.data(), triCount * i / chunkCount, triCount * (i + 1) / chunkCount,
+				sums[i].data(), orient.data()
+			);
+		};
+
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < chunkCount; i++) workers.emplace_back(fn, i);
+		fn(0);
+		for (auto& w : workers) w.join();
+	}
+
+	// reduce in chunk order and resolve, split[v] is 1 + the orientation kept by v
+	// when the other one needs a copy of it
+	std::vector<uint8_t> split(vertCount, 0);
+	std::vector<size_t> fallbacks(chunkCount, 0);
+	{
+		auto fn = [&](size_t i) {
+			size_t begin = vertCount * i / chunkCount, end = vertCount * (i + 1) / chunkCount;
+			TangentSum* total = sums[0].data();
+			for (size_t c = 1; c < chunkCount; c++) {
+				const TangentSum* part = sums[c].data();
+				for (size_t j = begin * 2; j < end * 2; j++) {
+					for (int k = 0; k < 4; k++) total[j].v[k] += part[j].v[k];
+				}
+			}
+
+			for (size_t v = begin; v < end; v++) {
+				Vertex& vert = vertices[v];
+				const TangentSum& flipped = total[v * 2 + OrientFlipped];
+				const TangentSum& preserving = total[v * 2 + OrientPreserving];
+				bool keepPreserving = preserving.v[3] >= flipped.v[3];
+
+				if (!resolve(keepPreserving ? preserving : flipped, vert.normal, keepPreserving ? 1.0f : -1.0f, vert.tangent)) {
+					vert.tangent = float4{ orthogonal(vert.normal), 1.0f };
+					fallbacks[i]++;
+				}
+				if (flipped.v[3] > 0.0f && preserving.v[3] > 0.0f) {
+					split[v] = uint8_t(1 + (keepPreserving ? OrientPreserving : OrientFlipped));
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < chunkCount; i++) workers.emplace_back(fn, i);
+		fn(0);
+		for (auto& w : workers) w.join();
+	}
+	for (size_t f : fallbacks) stats.fallback += f;
+	for (uint8_t o : orient) stats.degenerate += o == OrientAny;
+
+	// copies of mirrored seam vertices for the orientation they did not keep
+	std::vector<uint32_t> copies(vertCount, 0);
+	for (size_t v = 0; v < vertCount; v++) {
+		if (!split[v]) continue;
+
+		bool preserving = split[v] - 1 == OrientPreserving;
+		Vertex copy = vertices[v];
+		if (!resolve(sums[0][v * 2 + (preserving ? OrientFlipped : OrientPreserving)], copy.normal, preserving ? -1.0f : 1.0f, copy.tangent)) {
+			copy.tangent = float4{ orthogonal(copy.normal), preserving ? -1.0f : 1.0f };
+		}
+		copies[v] = uint32_t(vertices.size());
+		vertices.push_back(copy);
+		stats.split++;
+	}
+	if (stats.split > 0) {
+		for (size_t tri = 0; tri < triCount; tri++) {
+			if (orient[tri] == OrientAny) continue;
+			for (int c = 0; c < 3; c++) {
+				uint32_t& i = indices[tri * 3 + c];
+				if (split[i] && split[i] - 1 != orient[tri]) i = copies[i];
+			}
+		}
+	}
+
+	return stats;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+struct TangentStats {
+	size_t degenerate{ 0 }; // triangles with no area in position or uv space
+	size_t fallback{ 0 }; // vertices that got an arbitrary tangent orthogonal to the normal
+	size_t split{ 0 }; // vertices duplicated because they were used with both handedness
+};
+
+// MikkTSpace-compatible per-vertex tangents: the face tangents of every corner
+// are projected onto the vertex normal, weighted by the corner angle and summed
+// per vertex and handedness, and tangent.w holds the bitangent sign. A vertex
+// shared by mirrored and unmirrored triangles is split in two, so vertices and
+// indices may change. Vertices are told apart by index, where MikkTSpace first
+// merges identical ones, so unwelded meshes get flat tangents. Triangles are
+// split over threadCount threads (0 = hardware concurrency), each summing into
+// its own buffer. Deterministic for a given thread count.
+TangentStats generateTangents(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t threadCount = 0);
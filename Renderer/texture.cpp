@@ -1,5 +1,21 @@
 #include "texture.h"
 
+#include <algorithm>
+#include <cstring>
+
+bool s3tcSupported() {
+	static const bool supported = []() {
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+			auto ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+			if (ext && !strcmp(ext, "GL_EXT_texture_compression_s3tc")) return true;
+		}
+		return false;
+	}();
+	return supported;
+}
+
 void Texture::create(TextureTarget target) {
 	m_target = target;
 	glGenTextures(1, &m_object);
@@ -18,6 +34,17 @@ void Texture::setFilter(TextureFilter minFilter, TextureFilter magFilter) {
 
 void Texture::update(TextureFormat format, const void* pixels, uint32_t width, uint32_t height, uint32_t depth) {
 	auto [internalFormat, fmt, type] = getTextureFormat(format);
+	if (isCompressed(format)) {
+		if (m_target == TextureTarget::Texture2D) {
+			GLsizei size = GLsizei(compressedSize(format, width, height));
+			glCompressedTexImage2D((GLenum)m_target, 0, internalFormat, width, height, 0, size, pixels);
+		}
+		m_width = width;
+		m_height = height;
+		m_format = format;
+		return;
+	}
+
 	switch (m_target) {
 		case TextureTarget::Texture1D: glTexImage1D((GLenum)m_target, 0, internalFormat, width, 0, fmt, type, pixels); break;
 		case TextureTarget::Texture2D: glTexImage2D((GLenum)m_target, 0, internalFormat, width, height, 0, fmt, type, pixels); break;
@@ -28,6 +55,104 @@ void Texture::update(TextureFormat format, const void* pixels, uint32_t width, u
 	}
 	m_width = width;
 	m_height = height;
+	m_format = format;
+}
+
+void Texture::allocate(TextureFormat format, uint32_t width, uint32_t height, uint32_t levels) {
+	auto [internalFormat, fmt, type] = getTextureFormat(format);
+	if (GLAD_GL_VERSION_4_2) {
+		glTexStorage2D((GLenum)m_target, levels, internalFormat, width, height);
+	} else {
+		for (uint32_t level = 0; level < levels; level++) {
+			uint32_t w = std::max(width >> level, 1u), h = std::max(height >> level, 1u);
+			if (isCompressed(format)) {
+				GLsizei size = GLsizei(compressedSize(format, w, h));
+				glCompressedTexImage2D((GLenum)m_target, level, internalFormat, w, h, 0, size, nullptr);
+			} else {
+				glTexImage2D((GLenum)m_target, level, internalFormat, w, h, 0, fmt, type, nullptr);
+			}
+		}
+		setLevelRange(0, levels - 1);
+	}
+	m_width = width;
+	m_height = height;
+	m_levels = levels;
+	m_format = format;
+}
+
+void Texture::updateRegion(
+	TextureFormat format, const void* pixels,
+	uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+	uint32_t level
+) {
+	auto [internalFormat, fmt, type] = getTextureFormat(format);
+	if (isCompressed(format)) {
+		GLsizei size = GLsizei(compressedSize(format, width, height));
+		glCompressedTexSubImage2D((GLenum)m_target, level, x, y, width, height, internalFormat, size, pixels);
+		return;
+	}
+	glTexSubImage2D((GLenum)m_target, level, x, y, width, height, fmt, type, pixels);
+}
+
+void Texture::reserve(TextureFormat format, uint32_t width, uint32_t height, uint32_t levels) {
+	m_format = format;
+	m_width = width;
+	m_height = height;
+	m_levels = levels;
+}
+
+void Texture::updateLevel(TextureFormat format, const void* pixels, uint32_t level) {
+	auto [internalFormat, fmt, type] = getTextureFormat(format);
+	uint32_t w = std::max(m_width >> level, 1u), h = std::max(m_height >> level, 1u);
+	if (isCompressed(format)) {
+		GLsizei size = GLsizei(compressedSize(format, w, h));
+		glCompressedTexImage2D((GLenum)m_target, level, internalFormat, w, h, 0, size, pixels);
+	} else {
+		glTexImage2D((GLenum)m_target, level, internalFormat, w, h, 0, fmt, type, pixels);
+	}
+}
+
+void Texture::releaseLevel(TextureFormat format, uint32_t level) {
+	// a zero sized image frees the level's storage
+	auto [internalFormat, fmt, type] = getTextureFormat(format);
+	if (isCompressed(format)) {
+		glCompressedTexImage2D((GLenum)m_target, level, internalFormat, 0, 0, 0, 0, nullptr);
+	} else {
+		glTexImage2D((GLenum)m_target, level, internalFormat, 0, 0, 0, fmt, type, nullptr);
+	}
+}
+
+static size_t texelSize(TextureFormat format) {
+	switch (format) {
+		case TextureFormat::R: return 1;
+		case TextureFormat::RG:
+		case TextureFormat::Rf: return 2;
+		case TextureFormat::RGB: return 3;
+		case TextureFormat::RGf:
+		case TextureFormat::RGBA:
+		case TextureFormat::Depthf:
+		case TextureFormat::DepthStencil: return 4;
+		case TextureFormat::RGBf: return 6;
+		case TextureFormat::RGBAf: return 8;
+		default: return 0;
+	}
+}
+
+size_t Texture::memorySize() const {
+	if (!valid()) return 0;
+
+	size_t total = 0;
+	for (uint32_t level = 0; level < m_levels; level++) {
+		uint32_t w = std::max(m_width >> level, 1u), h = std::max(m_height >> level, 1u);
+		total += isCompressed(m_format) ? compressedSize(m_format, w, h) : size_t(w) * h * texelSize(m_format);
+	}
+	return total;
+}
+
+uint32_t Texture::mipCount(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) levels++;
+	return levels;
 }
 
 void Texture::updateCubemapFace(uint8_t* pixels, uint32_t width, uint32_t height, TextureFormat format, CubemapFace face) {
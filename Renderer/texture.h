@@ -1,8 +1,10 @@
 #pragma once
 
 #include <tuple>
+#include <algorithm>
 
 #include "glad.h"
+#include "gl_state.h"
 #include "data_type.h"
 
 enum class TextureTarget {
@@ -47,9 +49,57 @@ enum class TextureFormat {
 	RGBf,
 	RGBAf,
 	Depthf,
-	DepthStencil
+	DepthStencil,
+	// block compressed, 4x4 texel blocks
+	BC1, // RGB, 8 bytes per block
+	BC3, // RGBA, 16
+	BC4, // R, 8
+	BC5, // RG, 16
+	BC7 // RGBA, 16 (GL 4.2)
 };
 
+// S3TC is an extension that glad core does not define.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+inline bool isCompressed(TextureFormat format) {
+	return format >= TextureFormat::BC1;
+}
+
+// GL_EXT_texture_compression_s3tc, read from the extension string once. The
+// first call has to be on the GL thread, AssetLoader::create makes it before
+// any worker asks.
+bool s3tcSupported();
+
+// BC1 and BC3 need S3TC, BC7 needs GL 4.2.
+inline bool textureFormatSupported(TextureFormat format) {
+	switch (format) {
+		case TextureFormat::BC1:
+		case TextureFormat::BC3: return s3tcSupported();
+		case TextureFormat::BC7: return GLAD_GL_VERSION_4_2;
+		default: return true;
+	}
+}
+
+// Bytes per 4x4 block, 0 for uncompressed formats.
+inline uint32_t blockSize(TextureFormat format) {
+	switch (format) {
+		case TextureFormat::BC1:
+		case TextureFormat::BC4: return 8;
+		case TextureFormat::BC3:
+		case TextureFormat::BC5:
+		case TextureFormat::BC7: return 16;
+		default: return 0;
+	}
+}
+
+// Storage size of one compressed image.
+inline size_t compressedSize(TextureFormat format, uint32_t width, uint32_t height) {
+	return size_t((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
 static std::tuple<GLint, GLenum, GLenum> getTextureFormat(TextureFormat format) {
 	GLenum ifmt;
 	GLint fmt;
@@ -65,6 +115,11 @@ static std::tuple<GLint, GLenum, GLenum> getTextureFormat(TextureFormat format)
 		case TextureFormat::RGBAf: ifmt = GL_RGBA16F; fmt = GL_RGBA; type = GL_FLOAT; break;
 		case TextureFormat::Depthf: ifmt = GL_DEPTH_COMPONENT24; fmt = GL_DEPTH_COMPONENT; type = GL_FLOAT; break;
 		case TextureFormat::DepthStencil: ifmt = GL_DEPTH24_STENCIL8; fmt = GL_DEPTH_STENCIL; type = GL_FLOAT; break;
+		case TextureFormat::BC1: ifmt = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; fmt = GL_RGB; type = GL_UNSIGNED_BYTE; break;
+		case TextureFormat::BC3: ifmt = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; fmt = GL_RGBA; type = GL_UNSIGNED_BYTE; break;
+		case TextureFormat::BC4: ifmt = GL_COMPRESSED_RED_RGTC1; fmt = GL_RED; type = GL_UNSIGNED_BYTE; break;
+		case TextureFormat::BC5: ifmt = GL_COMPRESSED_RG_RGTC2; fmt = GL_RG; type = GL_UNSIGNED_BYTE; break;
+		case TextureFormat::BC7: ifmt = GL_COMPRESSED_RGBA_BPTC_UNORM; fmt = GL_RGBA; type = GL_UNSIGNED_BYTE; break;
 	}
 	return { ifmt, fmt, type };
 }
@@ -91,6 +146,31 @@ public:
 		uint32_t width, uint32_t height = 0, uint32_t depth = 0
 	);
 
+	// Allocates levels mips of a 2D texture without uploading anything.
+	void allocate(TextureFormat format, uint32_t width, uint32_t height, uint32_t levels = 1);
+
+	// Sub-rectangle of one mip level. With a GL_PIXEL_UNPACK_BUFFER bound,
+	// pixels is an offset into that buffer. Compressed formats take whole
+	// blocks, x and y must be multiples of 4.
+	void updateRegion(
+		TextureFormat format,
+		const void* pixels,
+		uint32_t x, uint32_t y,
+		uint32_t width, uint32_t height,
+		uint32_t level = 0
+	);
+
+	static uint32_t mipCount(uint32_t width, uint32_t height);
+
+	// Records the size of a mutable 2D texture whose levels are specified one
+	// at a time with updateLevel. Nothing is allocated.
+	void reserve(TextureFormat format, uint32_t width, uint32_t height, uint32_t levels);
+
+	// Specifies one whole level of a reserved texture, or drops its storage.
+	// Only the levels inside the level range have to exist.
+	void updateLevel(TextureFormat format, const void* pixels, uint32_t level);
+	void releaseLevel(TextureFormat format, uint32_t level);
+
 	void updateCubemapFace(
 		uint8_t* pixels,
 		uint32_t width, uint32_t height,
@@ -100,14 +180,27 @@ public:
 
 	void generateMipmaps() { glGenerateMipmap((GLenum)m_target); }
 
-	void destroy() { if (valid()) { glDeleteTextures(1, &m_object); m_object = 0; } }
+	// Mip levels that can be sampled (and that generateMipmaps fills).
+	void setLevelRange(uint32_t baseLevel, uint32_t maxLevel) {
+		glTexParameteri((GLenum)m_target, GL_TEXTURE_BASE_LEVEL, baseLevel);
+		glTexParameteri((GLenum)m_target, GL_TEXTURE_MAX_LEVEL, maxLevel);
+	}
+
+	void destroy() { if (valid()) { glDeleteTextures(1, &m_object); glState().deleted(GL_TEXTURE, m_object); m_object = 0; } }
 	bool valid() const { return m_object > 0; }
 
 	uint32_t width() const { return m_width; }
 	uint32_t height() const { return m_height; }
+	uint32_t levels() const { return m_levels; }
+	TextureFormat format() const { return m_format; }
+
+	// Bytes of all levels of a 2D texture as allocated, without driver padding.
+	size_t memorySize() const;
 
-	void bind(uint32_t slot = 0) const { glActiveTexture(GL_TEXTURE0 + slot); glBindTexture((GLenum)m_target, m_object); }
-	void unbind() { glBindTexture((GLenum)m_target, 0); }
+	void bind(uint32_t slot = 0) const { glState().bindTexture(slot, (GLenum)m_target, m_object); }
+	// For sampling, the texture cannot be updated after this without bind.
+	void bindUnit(uint32_t slot) const { glState().bindTextureUnit(slot, (GLenum)m_target, m_object); }
+	void unbind() { glState().bindTexture(glState().activeUnit(), (GLenum)m_target, 0); }
 
 	GLuint object() const { return m_object; }
 
@@ -116,4 +209,6 @@ private:
 
 	TextureTarget m_target;
 	uint32_t m_width, m_height;
+	uint32_t m_levels{ 1 };
+	TextureFormat m_format{ TextureFormat::RGBA };
 };
\ No newline at end of file
@@ -0,0 +1,421 @@
+#include "texture_compressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_COMPRESSOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// Images with fewer blocks than this are encoded on the calling thread.
+constexpr uint32_t MinParallelBlocks = 1024;
+
+// 4x4 texels, one array per channel so four texels fit an SSE register.
+struct alignas(16) ColorBlock {
+	float c[4][16];
+};
+
+// BC7 4-bit index weights, out of 64.
+static const float BC7Weights[16] = {
+	0.0f / 64, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+	34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 64.0f / 64
+};
+
+static const float BC1Weights[4] = { 0.0f, 1.0f / 3, 2.0f / 3, 1.0f };
+
+TextureFormat compressedFormatFor(TextureUsage usage, bool hasAlpha, bool highQuality) {
+	switch (usage) {
+		case TextureUsage::Normals: return TextureFormat::BC5;
+		case TextureUsage::Specular:
+		case TextureUsage::Emission: return TextureFormat::BC4;
+		default: break;
+	}
+	if (!hasAlpha && !highQuality && s3tcSupported()) return TextureFormat::BC1;
+	if (GLAD_GL_VERSION_4_2) return TextureFormat::BC7;
+	return s3tcSupported() ? TextureFormat::BC3 : TextureFormat::RGBA;
+}
+
+bool hasAlpha(const uint8_t* rgba, uint32_t width, uint32_t height) {
+	size_t count = size_t(width) * height;
+	for (size_t i = 0; i < count; i++) {
+		if (rgba[i * 4 + 3] != 255) return true;
+	}
+	return false;
+}
+
+static void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, ColorBlock& block) {
+	for (uint32_t y = 0; y < 4; y++) {
+		uint32_t sy = std::min(by * 4 + y, height - 1);
+		for (uint32_t x = 0; x < 4; x++) {
+			uint32_t sx = std::min(bx * 4 + x, width - 1);
+			const uint8_t* p = rgba + (size_t(sy) * width + sx) * 4;
+			for (int c = 0; c < 4; c++) block.c[c][y * 4 + x] = p[c];
+		}
+	}
+}
+
+// t[i] = dot(texel[i] - origin, axis) over the first channels.
+static void project(const ColorBlock& block, int channels, const float origin[4], const float axis[4], float t[16]) {
+#ifdef TEXTURE_COMPRESSOR_SSE2
+	for (int i = 0; i < 16; i += 4) {
+		__m128 sum = _mm_setzero_ps();
+		for (int c = 0; c < channels; c++) {
+			__m128 v = _mm_sub_ps(_mm_load_ps(&block.c[c][i]), _mm_set1_ps(origin[c]));
+			sum = _mm_add_ps(sum, _mm_mul_ps(v, _mm_set1_ps(axis[c])));
+		}
+		_mm_storeu_ps(&t[i], sum);
+	}
+#else
+	for (int i = 0; i < 16; i++) {
+		float sum = 0.0f;
+		for (int c = 0; c < channels; c++) sum += (block.c[c][i] - origin[c]) * axis[c];
+		t[i] = sum;
+	}
+#endif
+}
+
+// Endpoints along the principal axis of the texels, from a few power iterations.
+static void principalEndpoints(const ColorBlock& block, int channels, float e0[4], float e1[4]) {
+	float mean[4]{}, lo[4], hi[4];
+	for (int c = 0; c < channels; c++) {
+		lo[c] = hi[c] = block.c[c][0];
+		for (int i = 0; i < 16; i++) {
+			mean[c] += block.c[c][i];
+			lo[c] = std::min(lo[c], block.c[c][i]);
+			hi[c] = std::max(hi[c], block.c[c][i]);
+		}
+		mean[c] /= 16.0f;
+	}
+
+	float cov[4][4]{};
+	for (int i = 0; i < 16; i++) {
+		for (int a = 0; a < channels; a++) {
+			for (int b = a; b < channels; b++) {
+				cov[a][b] += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+			}
+		}
+	}
+	for (int a = 0; a < channels; a++) {
+		for (int b = 0; b < a; b++) cov[a][b] = cov[b][a];
+	}
+
+	float axis[4]{};
+	for (int c = 0; c < channels; c++) axis[c] = hi[c] - lo[c];
+	for (int iter = 0; iter < 8; iter++) {
+		float next[4]{}, len = 0.0f;
+		for (int a = 0; a < channels; a++) {
+			for (int b = 0; b < channels; b++) next[a] += cov[a][b] * axis[b];
+			len = std::max(len, std::abs(next[a]));
+		}
+		if (len < 1e-6f) break;
+		for (int c = 0; c < channels; c++) axis[c] = next[c] / len;
+	}
+
+	float len2 = 0.0f;
+	for (int c = 0; c < channels; c++) len2 += axis[c] * axis[c];
+	if (len2 < 1e-12f) {
+		// flat block
+		for (int c = 0; c < channels; c++) e0[c] = e1[c] = mean[c];
+		return;
+	}
+	float inv = 1.0f / std::sqrt(len2);
+	for (int c = 0; c < channels; c++) axis[c] *= inv;
+
+	float t[16];
+	project(block, channels, mean, axis, t);
+	float tmin = *std::min_element(t, t + 16), tmax = *std::max_element(t, t + 16);
+
+	// pull the ends in a little, the interpolated points do most of the work
+	float inset = (tmax - tmin) / 32.0f;
+	tmin += inset;
+	tmax -= inset;
+	for (int c = 0; c < channels; c++) {
+		e0[c] = std::clamp(mean[c] + axis[c] * tmin, 0.0f, 255.0f);
+		e1[c] = std::clamp(mean[c] + axis[c] * tmax, 0.0f, 255.0f);
+	}
+}
+
+// Picks the palette entry nearest to each texel along e0 -> e1. Returns the squared error.
+static float fitIndices(
+	const ColorBlock& block, int channels,
+	const float e0[4], const float e1[4],
+	const float* weights, int count,
+	uint8_t indices[16]
+) {
+	float d[4]{}, dd = 0.0f;
+	for (int c = 0; c < channels; c++) {
+		d[c] = e1[c] - e0[c];
+		dd += d[c] * d[c];
+	}
+
+	float t[16];
+	if (dd > 1e-6f) {
+		project(block, channels, e0, d, t);
+		for (int i = 0; i < 16; i++) t[i] /= dd;
+	} else {
+		std::fill_n(t, 16, 0.0f);
+	}
+
+	float error = 0.0f;
+	int steps = count - 1;
+	for (int i = 0; i < 16; i++) {
+		int k = std::clamp(int(t[i] * steps + 0.5f), 0, steps);
+		// the weights are only close to uniform, check the neighbours
+		if (k > 0 && std::abs(weights[k - 1] - t[i]) < std::abs(weights[k] - t[i])) k--;
+		else if (k < steps && std::abs(weights[k + 1] - t[i]) < std::abs(weights[k] - t[i])) k++;
+		indices[i] = uint8_t(k);
+
+		for (int c = 0; c < channels; c++) {
+			float diff = e0[c] + d[c] * weights[k] - block.c[c][i];
+			error += diff * diff;
+		}
+	}
+	return error;
+}
+
+// Least squares endpoints for fixed interpolation weights.
+static bool refineEndpoints(
+	const ColorBlock& block, int channels,
+	const uint8_t indices[16], const float* weights,
+	float e0[4], float e1[4]
+) {
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f, x[4]{}, y[4]{};
+	for (int i = 0; i < 16; i++) {
+		float w = weights[indices[i]], iw = 1.0f - w;
+		aa += iw * iw;
+		ab += iw * w;
+		bb += w * w;
+		for (int c = 0; c < channels; c++) {
+			x[c] += iw * block.c[c][i];
+			y[c] += w * block.c[c][i];
+		}
+	}
+
+	float det = aa * bb - ab * ab;
+	if (std::abs(det) < 1e-6f) return false;
+
+	float inv = 1.0f / det;
+	for (int c = 0; c < channels; c++) {
+		e0[c] = std::clamp((bb * x[c] - ab * y[c]) * inv, 0.0f, 255.0f);
+		e1[c] = std::clamp((aa * y[c] - ab * x[c]) * inv, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+static uint16_t to565(const float c[4]) {
+	uint32_t r = uint32_t(std::lround(c[0] * 31.0f / 255.0f));
+	uint32_t g = uint32_t(std::lround(c[1] * 63.0f / 255.0f));
+	uint32_t b = uint32_t(std::lround(c[2] * 31.0f / 255.0f));
+	return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static void from565(uint16_t v, float c[4]) {
+	uint32_t r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = float((r << 3) | (r >> 2));
+	c[1] = float((g << 2) | (g >> 4));
+	c[2] = float((b << 3) | (b >> 2));
+}
+
+// BC1 colour block, always in four colour mode (also the BC3 colour half).
+static void encodeColorBlock(const ColorBlock& block, uint8_t* out) {
+	float e0[4], e1[4];
+	principalEndpoints(block, 3, e0, e1);
+
+	uint16_t best0 = 0, best1 = 0;
+	uint8_t bestIndices[16]{};
+	float bestError = -1.0f;
+
+	for (int pass = 0; pass < 2; pass++) {
+		uint16_t c0 = to565(e1), c1 = to565(e0);
+		if (c0 < c1) std::swap(c0, c1);
+
+		float p0[4], p1[4];
+		from565(c0, p0);
+		from565(c1, p1);
+
+		uint8_t indices[16];
+		float error = fitIndices(block, 3, p0, p1, BC1Weights, 4, indices);
+		if (bestError < 0.0f || error < bestError) {
+			bestError = error;
+			best0 = c0;
+			best1 = c1;
+			std::copy_n(indices, 16, bestIndices);
+		}
+
+		if (pass == 0 && !refineEndpoints(block, 3, indices, BC1Weights, p0, p1)) break;
+		std::copy_n(p0, 3, e1);
+		std::copy_n(p1, 3, e0);
+	}
+
+	// palette order is c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+	static const uint32_t remap[4] = { 0, 2, 3, 1 };
+	uint32_t bits = 0;
+	if (best0 != best1) {
+		for (int i = 0; i < 16; i++) bits |= remap[bestIndices[i]] << (i * 2);
+	}
+
+	std::memcpy(out, &best0, 2);
+	std::memcpy(out + 2, &best1, 2);
+	std::memcpy(out + 4, &bits, 4);
+}
+
+// One channel, eight interpolated values.
+static void encodeChannelBlock(const ColorBlock& block, int channel, uint8_t* out) {
+	const float* v = block.c[channel];
+	float lo = *std::min_element(v, v + 16), hi = *std::max_element(v, v + 16);
+
+	uint8_t r0 = uint8_t(std::lround(hi)), r1 = uint8_t(std::lround(lo));
+	out[0] = r0;
+	out[1] = r1;
+
+	uint64_t bits = 0;
+	if (r0 > r1) {
+		// palette order is r0, r1, then 6/7 r0 + 1/7 r1 down to 1/7 r0 + 6/7 r1
+		static const uint64_t remap[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+		float scale = 7.0f / float(r0 - r1);
+		for (int i = 0; i < 16; i++) {
+			int k = std::clamp(int((float(r0) - v[i]) * scale + 0.5f), 0, 7);
+			bits |= remap[k] << (i * 3);
+		}
+	}
+	for (int i = 0; i < 6; i++) out[2 + i] = uint8_t(bits >> (i * 8));
+}
+
+// 7 bit endpoint plus a shared low bit, picked per endpoint.
+static void quantizeBC7(const float e[4], uint32_t q[4], uint32_t& pbit, float decoded[4]) {
+	float bestError = -1.0f;
+	for (uint32_t p = 0; p < 2; p++) {
+		uint32_t cand[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; c++) {
+			cand[c] = uint32_t(std::clamp(std::lround((e[c] - float(p)) / 2.0f), 0l, 127l));
+			float diff = float((cand[c] << 1) | p) - e[c];
+			error += diff * diff;
+		}
+		if (bestError < 0.0f || error < bestError) {
+			bestError = error;
+			pbit = p;
+			std::copy_n(cand, 4, q);
+		}
+	}
+	for (int c = 0; c < 4; c++) decoded[c] = float((q[c] << 1) | pbit);
+}
+
+struct BitWriter {
+	uint8_t* out;
+	uint32_t pos{ 0 };
+
+	void write(uint32_t value, uint32_t count) {
+		for (uint32_t i = 0; i < count; i++, pos++) {
+			if ((value >> i) & 1) out[pos >> 3] |= uint8_t(1u << (pos & 7));
+		}
+	}
+};
+
+// BC7 mode 6 only: one subset, RGBA 7.7.7.7 endpoints with p-bits, 4 bit indices.
+// Fast and good on smooth content, the partitioned modes are left out.
+static void encodeBC7Block(const ColorBlock& block, uint8_t* out) {
+	float e0[4], e1[4];
+	principalEndpoints(block, 4, e0, e1);
+
+	uint32_t best[2][4]{}, bestP[2]{};
+	uint8_t bestIndices[16]{};
+	float bestError = -1.0f;
+
+	for (int pass = 0; pass < 2; pass++) {
+		uint32_t q0[4], q1[4], p0, p1;
+		float d0[4], d1[4];
+		quantizeBC7(e0, q0, p0, d0);
+		quantizeBC7(e1, q1, p1, d1);
+
+		uint8_t indices[16];
+		float error = fitIndices(block, 4, d0, d1, BC7Weights, 16, indices);
+		if (bestError < 0.0f || error < bestError) {
+			bestError = error;
+			std::copy_n(q0, 4, best[0]);
+			std::copy_n(q1, 4, best[1]);
+			bestP[0] = p0;
+			bestP[1] = p1;
+			std::copy_n(indices, 16, bestIndices);
+		}
+
+		if (pass == 0 && !refineEndpoints(block, 4, indices, BC7Weights, e0, e1)) break;
+	}
+
+	// the first index has an implicit zero top bit
+	if (bestIndices[0] & 8) {
+		std::swap(best[0], best[1]);
+		std::swap(bestP[0], bestP[1]);
+		for (auto& i : bestIndices) i = uint8_t(15 - i);
+	}
+
+	std::memset(out, 0, 16);
+	BitWriter bits{ out };
+	bits.write(1u << 6, 7);
+	for (int c = 0; c < 4; c++) {
+		bits.write(best[0][c], 7);
+		bits.write(best[1][c], 7);
+	}
+	bits.write(bestP[0], 1);
+	bits.write(bestP[1], 1);
+	bits.write(bestIndices[0], 3);
+	for (int i = 1; i < 16; i++) bits.write(bestIndices[i], 4);
+}
+
+static void encodeBlock(const ColorBlock& block, TextureFormat format, uint8_t* out) {
+	switch (format) {
+		case TextureFormat::BC1:
+			encodeColorBlock(block, out);
+			break;
+		case TextureFormat::BC3:
+			encodeChannelBlock(block, 3, out);
+			encodeColorBlock(block, out + 8);
+			break;
+		case TextureFormat::BC4:
+			encodeChannelBlock(block, 0, out);
+			break;
+		case TextureFormat::BC5:
+			encodeChannelBlock(block, 0, out);
+			encodeChannelBlock(block, 1, out + 8);
+			break;
+		case TextureFormat::BC7:
+			encodeBC7Block(block, out);
+			break;
+		default: break;
+	}
+}
+
+void compressImage(
+	const uint8_t* rgba, uint32_t width, uint32_t height,
+	TextureFormat format, uint8_t* out,
+	uint32_t threadCount
+) {
+	uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t stride = blockSize(format);
+	if (stride == 0 || blocksX == 0 || blocksY == 0) return;
+
+	auto encodeRows = [&](uint32_t begin, uint32_t end) {
+		ColorBlock block;
+		for (uint32_t by = begin; by < end; by++) {
+			uint8_t* row = out + size_t(by) * blocksX * stride;
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				loadBlock(rgba, width, height, bx, by, block);
+				encodeBlock(block, format, row + bx * stride);
+			}
+		}
+	};
+
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t chunkCount = std::clamp(blocksX * blocksY / MinParallelBlocks, 1u, std::min(threadCount, blocksY));
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < chunkCount; i++) {
+		workers.emplace_back(encodeRows, blocksY * i / chunkCount, blocksY * (i + 1) / chunkCount);
+	}
+	encodeRows(0, blocksY / chunkCount);
+	for (auto& w : workers) w.join();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include "texture.h"
+
+// What a texture is sampled as, in Material::Slot order.
+enum class TextureUsage {
+	Diffuse = 0,
+	Specular,
+	Normals,
+	Emission
+};
+
+enum TextureProcessFlags {
+	TextureMipmaps = 1,
+	TextureCompress = 2,
+	TextureUseCache = 4, // read/write a .rtex next to the source
+	TextureHighQuality = 8, // BC7 for opaque diffuse too
+	TextureBoxMips = 16, // box filtered mips instead of Kaiser
+	TextureStreamed = 32 // residency handled by the loader's TextureStreamer
+};
+
+constexpr uint32_t TextureDefaultFlags = TextureMipmaps | TextureCompress | TextureUseCache;
+
+// Diffuse: BC1 when opaque, BC7 with alpha (BC3 without GL 4.2). Without S3TC
+// BC7 for both, or RGBA (left uncompressed) when neither is there.
+// Normals: BC5, the shader rebuilds z. Specular and emission: BC4, only red is sampled.
+TextureFormat compressedFormatFor(TextureUsage usage, bool hasAlpha, bool highQuality = false);
+
+bool hasAlpha(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+// Encodes an RGBA8 image into compressedSize(format, width, height) bytes at out.
+// Rows of blocks are split over threadCount threads (0 = hardware concurrency),
+// partial edge blocks repeat the last row/column.
+void compressImage(
+	const uint8_t* rgba, uint32_t width, uint32_t height,
+	TextureFormat format, uint8_t* out,
+	uint32_t threadCount = 0
+);
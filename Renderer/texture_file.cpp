@@ -0,0 +1,91 @@
+#include "texture_file.h"
+
+#include <fstream>
+
+#include "aixlog.hpp"
+
+static size_t alignUp(size_t v, size_t a) { return (v + a - 1) & ~(a - 1); }
+
+// Only what the loader writes: RGBA8 or one of the block compressed formats.
+static bool formatValid(uint32_t format) {
+	return format == uint32_t(TextureFormat::RGBA) ||
+		(format >= uint32_t(TextureFormat::BC1) && format <= uint32_t(TextureFormat::BC7));
+}
+
+bool TextureFile::open(const std::string& fileName, uint64_t sourceHash, uint32_t flags) {
+	close();
+	if (!m_file.open(fileName)) return false;
+
+	auto header = reinterpret_cast<const TextureFileHeader*>(m_file.data());
+	bool valid = m_file.size() >= sizeof(TextureFileHeader) &&
+		header->magic == TextureFileMagic &&
+		header->version == TextureFileVersion &&
+		header->sourceHash == sourceHash &&
+		header->flags == flags &&
+		header->levelCount > 0 &&
+		header->fileSize == m_file.size() &&
+		formatValid(header->format) &&
+		// the level table sits between the header and the data block
+		header->levelOffset >= sizeof(TextureFileHeader) &&
+		header->levelOffset % alignof(TextureFileLevel) == 0 &&
+		header->levelOffset <= header->dataOffset &&
+		header->dataOffset <= header->fileSize &&
+		header->levelCount <= (header->dataOffset - header->levelOffset) / sizeof(TextureFileLevel);
+
+	if (valid) {
+		// every level has to lie inside the data block
+		auto levels = reinterpret_cast<const TextureFileLevel*>(m_file.data() + header->levelOffset);
+		uint64_t dataSize = header->fileSize - header->dataOffset;
+		for (uint32_t i = 0; i < header->levelCount && valid; i++) {
+			valid = levels[i].offset <= dataSize && levels[i].size <= dataSize - levels[i].offset;
+		}
+	}
+
+	if (!valid) {
+		m_file.close();
+		return false;
+	}
+
+	m_header = header;
+	return true;
+}
+
+bool TextureFile::write(
+	const std::string& fileName,
+	uint64_t sourceHash, uint32_t flags,
+	TextureFormat format, uint32_t width, uint32_t height,
+	const TextureFileLevel* levels, size_t levelCount,
+	const uint8_t* data, size_t dataSize
+) {
+	TextureFileHeader header{};
+	header.magic = TextureFileMagic;
+	header.version = TextureFileVersion;
+	header.sourceHash = sourceHash;
+	header.flags = flags;
+	header.format = uint32_t(format);
+	header.width = width;
+	header.height = height;
+	header.levelCount = uint32_t(levelCount);
+	header.levelOffset = alignUp(sizeof(TextureFileHeader), 16);
+	header.dataOffset = alignUp(header.levelOffset + levelCount * sizeof(TextureFileLevel), 16);
+	header.fileSize = header.dataOffset + dataSize;
+
+	std::ofstream fp{ fileName, std::ios::binary | std::ios::trunc };
+	if (!fp.good()) {
+		LOG(WARNING) << "Could not write texture cache " << fileName << "\n";
+		return false;
+	}
+
+	auto pad = [&](uint64_t to) {
+		static const char zeros[16]{};
+		fp.write(zeros, std::streamsize(to - uint64_t(fp.tellp())));
+	};
+
+	fp.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	pad(header.levelOffset);
+	fp.write(reinterpret_cast<const char*>(levels), std::streamsize(levelCount * sizeof(TextureFileLevel)));
+	pad(header.dataOffset);
+	fp.write(reinterpret_cast<const char*>(data), std::streamsize(dataSize));
+
+	return fp.good();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+
+#include "texture.h"
+#include "mapped_file.h"
+
+constexpr uint32_t TextureFileMagic = 0x58455452; // "RTEX"
+constexpr uint32_t TextureFileVersion = 2;
+
+struct TextureFileHeader {
+	uint32_t magic, version;
+	uint64_t sourceHash;
+	uint32_t flags, format;
+	uint32_t width, height, levelCount, reserved;
+	uint64_t levelOffset, dataOffset, fileSize;
+};
+
+struct TextureFileLevel {
+	uint64_t offset, size; // relative to the data block
+	uint32_t width, height;
+};
+
+// Processed texture with its whole mip chain (.rtex), stored in the format it
+// is uploaded in so a warm load is a single mmap + copy into the staging ring.
+class TextureFile {
+public:
+	bool open(const std::string& fileName, uint64_t sourceHash, uint32_t flags);
+	void close() { m_file.close(); m_header = nullptr; }
+
+	static bool write(
+		const std::string& fileName,
+		uint64_t sourceHash, uint32_t flags,
+		TextureFormat format, uint32_t width, uint32_t height,
+		const TextureFileLevel* levels, size_t levelCount,
+		const uint8_t* data, size_t dataSize
+	);
+
+	TextureFormat format() const { return TextureFormat(m_header->format); }
+	uint32_t width() const { return m_header->width; }
+	uint32_t height() const { return m_header->height; }
+
+	const TextureFileLevel* levels() const { return reinterpret_cast<const TextureFileLevel*>(m_file.data() + m_header->levelOffset); }
+	size_t levelCount() const { return m_header->levelCount; }
+
+	const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(m_file.data() + m_header->dataOffset); }
+	size_t dataSize() const { return m_header->fileSize - m_header->dataOffset; }
+
+private:
+	MappedFile m_file;
+	const TextureFileHeader* m_header{ nullptr };
+};
@@ -0,0 +1,162 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+void TextureStreamer::add(Texture& texture, std::shared_ptr<const ImageData> image, uint32_t tailSize) {
+	uint32_t last = uint32_t(image->levels.size()) - 1;
+
+	Entry e{};
+	e.tail = last;
+	for (uint32_t i = 0; i <= last; i++) {
+		const PixelRegion& r = image->levels[i];
+		if (std::max(r.width, r.height) <= tailSize) {
+			e.tail = i;
+			break;
+		}
+	}
+
+	const PixelRegion& base = image->levels[0];
+	texture.create(TextureTarget::Texture2D);
+	texture.bind();
+	texture.reserve(image->format, base.width, base.height, last + 1);
+	for (uint32_t i = e.tail; i <= last; i++) {
+		texture.updateLevel(image->format, image->pixels.data() + image->levels[i].offset, i);
+		m_stats.residentBytes += image->levelSize(i);
+	}
+	texture.setLevelRange(e.tail, last);
+
+	e.texture = texture;
+	e.image = std::move(image);
+	e.resident = e.wanted = e.tail;
+	e.lastRequest = m_frame;
+	m_entries[texture.object()] = std::move(e);
+	m_stats.textures++;
+}
+
+void TextureStreamer::remove(const Texture& texture) {
+	auto it = m_entries.find(texture.object());
+	if (it == m_entries.end()) return;
+
+	const Entry& e = it->second;
+	for (uint32_t i = e.resident; i < e.image->levels.size(); i++) {
+		m_stats.residentBytes -= e.image->levelSize(i);
+	}
+	m_entries.erase(it);
+	m_stats.textures--;
+}
+
+void TextureStreamer::request(const Texture& texture, float level) {
+	auto it = m_entries.find(texture.object());
+	if (it == m_entries.end()) return;
+
+	Entry& e = it->second;
+	uint32_t wanted = uint32_t(std::clamp(std::floor(level), 0.0f, float(e.tail)));
+	if (e.lastRequest != m_frame) {
+		e.wanted = wanted;
+		e.lastRequest = m_frame;
+	} else {
+		e.wanted = std::min(e.wanted, wanted);
+	}
+}
+
+uint32_t TextureStreamer::target(const Entry& e) const {
+	// the last request stands until it times out
+	return m_frame - e.lastRequest > m_requestTimeout ? e.tail : e.wanted;
+}
+
+void TextureStreamer::update() {
+	// budget may have been lowered
+	makeRoom(0, nullptr);
+
+	std::vector<Entry*> missing;
+	for (auto& [object, e] : m_entries) {
+		if (e.resident > target(e)) missing.push_back(&e);
+	}
+
+	// furthest from what they need first, then the most recently drawn
+	std::sort(missing.begin(), missing.end(), [this](const Entry* a, const Entry* b) {
+		uint32_t da = a->resident - target(*a), db = b->resident - target(*b);
+		if (da != db) return da > db;
+		return a->lastRequest > b->lastRequest;
+	});
+
+	uint64_t uploaded = 0;
+	for (Entry* e : missing) {
+		while (e->resident > target(*e)) {
+			size_t size = e->image->levelSize(e->resident - 1);
+			// one level per frame always goes through, however large
+			if (uploaded > 0 && uploaded + size > m_uploadBudget) break;
+			if (!makeRoom(size, e)) {
+				m_stats.starved++;
+				break;
+			}
+			streamIn(*e);
+			uploaded += size;
+		}
+		if (uploaded >= m_uploadBudget) break;
+	}
+
+	m_frame++;
+}
+
+void TextureStreamer::streamIn(Entry& e) {
+	uint32_t level = e.resident - 1, last = uint32_t(e.image->levels.size()) - 1;
+	size_t size = e.image->levelSize(level);
+
+	e.texture.bind();
+	e.texture.updateLevel(e.image->format, e.image->pixels.data() + e.image->levels[level].offset, level);
+	e.texture.setLevelRange(level, last);
+	e.resident = level;
+
+	m_stats.residentBytes += size;
+	m_stats.uploadedBytes += size;
+	m_stats.levelsIn++;
+}
+
+void TextureStreamer::evict(Entry& e) {
+	uint32_t level = e.resident, last = uint32_t(e.image->levels.size()) - 1;
+	size_t size = e.image->levelSize(level);
+
+	// stop sampling the level before dropping its storage
+	e.texture.bind();
+	e.texture.setLevelRange(level + 1, last);
+	e.texture.releaseLevel(e.image->format, level);
+	e.resident = level + 1;
+
+	m_stats.residentBytes -= size;
+	m_stats.evictedBytes += size;
+	m_stats.levelsOut++;
+}
+
+bool TextureStreamer::makeRoom(uint64_t bytes, const Entry* keep) {
+	while (m_stats.residentBytes + bytes > m_budget) {
+		Entry* victim = nullptr;
+		bool victimExcess = false;
+		for (auto& [object, e] : m_entries) {
+			if (&e == keep || e.resident >= e.tail) continue;
+
+			// levels finer than needed go first, then the least recently drawn;
+			// a texture is never evicted for one drawn less recently than itself
+			bool excess = e.resident < target(e);
+			if (!excess && keep && e.lastRequest >= keep->lastRequest) continue;
+
+			if (!victim || (excess && !victimExcess) ||
+				(excess == victimExcess && e.lastRequest < victim->lastRequest)) {
+				victim = &e;
+				victimExcess = excess;
+			}
+		}
+		if (!victim) return false;
+		evict(*victim);
+	}
+	return true;
+}
+
+void TextureStreamer::resetStats() {
+	TextureStreamStats stats{};
+	stats.textures = m_stats.textures;
+	stats.residentBytes = m_stats.residentBytes;
+	m_stats = stats;
+}
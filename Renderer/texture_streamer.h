@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include "texture.h"
+#include "pixel_upload_ring.h"
+
+struct TextureStreamStats {
+	uint32_t textures{ 0 };
+	uint64_t residentBytes{ 0 };
+	uint64_t uploadedBytes{ 0 }, evictedBytes{ 0 };
+	uint32_t levelsIn{ 0 }, levelsOut{ 0 };
+	uint32_t starved{ 0 }; // levels wanted but not loaded for lack of budget
+};
+
+// Keeps the CPU copy of every registered mip chain and decides which levels
+// are resident in GL from the levels requested while drawing. Residency is set
+// with GL_TEXTURE_BASE_LEVEL/MAX_LEVEL on mutable textures, and dropped levels
+// are respecified empty so the driver can free them. The resident total never
+// exceeds the budget, except for the always resident small tail of each chain.
+class TextureStreamer {
+public:
+	// VRAM ceiling for streamed textures and upload limit per update.
+	void setBudget(uint64_t bytes) { m_budget = bytes; }
+	void setUploadBudget(uint64_t bytesPerFrame) { m_uploadBudget = bytesPerFrame; }
+	uint64_t budget() const { return m_budget; }
+
+	// Frames without a request before a texture falls back to its tail.
+	void setRequestTimeout(uint32_t frames) { m_requestTimeout = frames; }
+
+	// GL thread. Creates the texture with only the levels up to tailSize texels resident.
+	void add(Texture& texture, std::shared_ptr<const ImageData> image, uint32_t tailSize = 64);
+	void remove(const Texture& texture);
+
+	// Finest level wanted for this frame, the smallest request wins.
+	void request(const Texture& texture, float level);
+
+	// GL thread, once per frame once the frame's requests are in.
+	void update();
+
+	const TextureStreamStats& stats() const { return m_stats; }
+	void resetStats();
+
+private:
+	struct Entry {
+		Texture texture{};
+		std::shared_ptr<const ImageData> image;
+		uint32_t resident{ 0 }; // finest resident level (the base level)
+		uint32_t tail{ 0 }; // finest level of the always resident tail, levels >= tail stay
+		uint32_t wanted{ 0 };
+		uint64_t lastRequest{ 0 };
+	};
+
+	std::unordered_map<GLuint, Entry> m_entries;
+	uint64_t m_budget{ 256ull * 1024 * 1024 }, m_uploadBudget{ 4ull * 1024 * 1024 };
+	uint32_t m_requestTimeout{ 120 };
+	uint64_t m_frame{ 0 };
+	TextureStreamStats m_stats{};
+
+	uint32_t target(const Entry& e) const;
+	void streamIn(Entry& e);
+	void evict(Entry& e);
+	bool makeRoom(uint64_t bytes, const Entry* keep);
+};
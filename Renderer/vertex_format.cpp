@@ -0,0 +1,254 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mesh.h"
+#include "shaders.hpp"
+
+static BufferLayoutEntry StaticLayout[] = {
+	{ 3, DataType::Float, false },  // vPosition
+	{ 2, DataType::Short, true },  // vNormal (octahedral)
+	{ 2, DataType::Short, true },  // vTangent (octahedral, sign in y)
+	{ 2, DataType::Float, false },  // vTexCoord
+};
+
+static BufferLayoutEntry QuantizedLayout[] = {
+	{ 4, DataType::UShort, true },  // vPosition
+	{ 2, DataType::Short, true },  // vNormal (octahedral)
+	{ 2, DataType::Short, true },  // vTangent (octahedral, sign in y)
+	{ 2, DataType::UShort, true },  // vTexCoord
+};
+
+static BufferLayoutEntry QuantizedSkinnedLayout[] = {
+	{ 4, DataType::UShort, true },  // vPosition
+	{ 2, DataType::Short, true },  // vNormal (octahedral)
+	{ 2, DataType::Short, true },  // vTangent (octahedral, sign in y)
+	{ 2, DataType::UShort, true },  // vTexCoord
+	{ 4, DataType::UByte, true },  // vWeights
+	{ 4, DataType::UByte, false },  // vJointIDs
+};
+
+static const VertexFormatInfo FormatInfos[] = {
+	{ "full", sizeof(Vertex), VertexLayout, 6, "#define VERTEX_SKINNED\n", true },
+	{ "static", sizeof(StaticVertex), StaticLayout, 4, "#define VERTEX_OCT_ENCODED\n", false },
+	{ "quantized", sizeof(QuantizedVertex), QuantizedLayout, 4, "#define VERTEX_OCT_ENCODED\n#define VERTEX_QUANTIZED\n", false },
+	{
+		"quantized_skinned", sizeof(QuantizedSkinnedVertex), QuantizedSkinnedLayout, 6,
+		"#define VERTEX_OCT_ENCODED\n#define VERTEX_QUANTIZED\n#define VERTEX_SKINNED\n#define VERTEX_PACKED_JOINTS\n", true
+	},
+};
+
+const VertexFormatInfo& vertexFormatInfo(VertexFormat format) {
+	return FormatInfos[size_t(format)];
+}
+
+std::string vertexFormatPrelude(VertexFormat format) {
+	return std::string(vertexFormatInfo(format).defines) + VertexInputSrc;
+}
+
+static int16_t packSnorm16(float v) {
+	return int16_t(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+
+static float unpackSnorm16(int16_t v) {
+	return std::max(float(v) / 32767.0f, -1.0f);
+}
+
+static uint16_t packUnorm16(float v) {
+	return uint16_t(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+}
+
+// Octahedral mapping, see "A Survey of Efficient Representations for Independent Unit Vectors".
+static float2 octEncode(float3 n) {
+	float len = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (len <= 0.0f) return float2{ 0.0f };
+	n /= len;
+
+	float2 e{ n.x, n.y };
+	if (n.z < 0.0f) {
+		e.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		e.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return e;
+}
+
+static float3 octDecode(float2 e) {
+	float3 n{ e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y) };
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return linalg::normalize(n);
+}
+
+static void packNormal(float3 n, int16_t out[2]) {
+	float2 e = octEncode(n);
+	out[0] = packSnorm16(e.x);
+	out[1] = packSnorm16(e.y);
+}
+
+static float3 unpackNormal(const int16_t in[2]) {
+	return octDecode(float2{ unpackSnorm16(in[0]), unpackSnorm16(in[1]) });
+}
+
+// Octahedral too, with the bitangent sign in the sign of y: y is remapped to
+// [0, 1] first, which costs it one bit.
+static void packTangent(float4 t, int16_t out[2]) {
+	float2 e = octEncode(t.xyz());
+	float y = std::max(e.y * 0.5f + 0.5f, 1.0f / 32767.0f);
+	out[0] = packSnorm16(e.x);
+	out[1] = packSnorm16(t.w < 0.0f ? -y : y);
+}
+
+static float4 unpackTangent(const int16_t in[2]) {
+	float y = unpackSnorm16(in[1]);
+	float3 t = octDecode(float2{ unpackSnorm16(in[0]), std::abs(y) * 2.0f - 1.0f });
+	return float4{ t, y < 0.0f ? -1.0f : 1.0f };
+}
+
+// Rounds weights to unorm8 while keeping their sum at exactly 255.
+static void packWeights(const Vertex& v, uint8_t ids[4], uint8_t weights[4]) {
+	float sum = 0.0f;
+	for (int i = 0; i < 4; i++) {
+		if (v.jointIDs[i] >= 0) sum += std::max(v.jointWeights[i], 0.0f);
+	}
+
+	int total = 0, largest = 0;
+	for (int i = 0; i < 4; i++) {
+		bool used = v.jointIDs[i] >= 0 && sum > 0.0f;
+		ids[i] = used ? uint8_t(std::min(v.jointIDs[i], 255)) : 0;
+		weights[i] = used ? uint8_t(std::lround(std::max(v.jointWeights[i], 0.0f) / sum * 255.0f)) : 0;
+		total += weights[i];
+		if (weights[i] > weights[largest]) largest = i;
+	}
+	if (total > 0) weights[largest] = uint8_t(weights[largest] + 255 - total);
+}
+
+VertexQuantization computeQuantization(const Vertex* vertices, size_t count) {
+	VertexQuantization q{};
+	if (count == 0) return q;
+
+	float3 pmin = vertices[0].position, pmax = pmin;
+	float2 tmin = vertices[0].texCoord, tmax = tmin;
+	for (size_t i = 1; i < count; i++) {
+		pmin = linalg::min(pmin, vertices[i].position);
+		pmax = linalg::max(pmax, vertices[i].position);
+		tmin = linalg::min(tmin, vertices[i].texCoord);
+		tmax = linalg::max(tmax, vertices[i].texCoord);
+	}
+
+	// shared scale on all axes keeps the quantization grid uniform
+	float extent = std::max(linalg::maxelem(pmax - pmin), 1e-6f);
+	q.positionOffset = pmin;
+	q.positionScale = float3{ extent };
+	q.texCoordOffset = tmin;
+	q.texCoordScale = linalg::max(tmax - tmin, float2{ 1e-6f });
+	return q;
+}
+
+template <typename V>
+static void packCommon(const Vertex& src, V& dst, const VertexQuantization& q) {
+	float3 p = (src.position - q.positionOffset) / q.positionScale;
+	float2 t = (src.texCoord - q.texCoordOffset) / q.texCoordScale;
+	for (int k = 0; k < 3; k++) dst.position[k] = packUnorm16(p[k]);
+	dst.position[3] = 0;
+	for (int k = 0; k < 2; k++) dst.texCoord[k] = packUnorm16(t[k]);
+	packNormal(src.normal, dst.normal);
+	packTangent(src.tangent, dst.tangent);
+}
+
+std::vector<uint8_t> packVertices(const Vertex* vertices, size_t count, VertexFormat format, const VertexQuantization& quant) {
+	std::vector<uint8_t> out(count * vertexFormatInfo(format).stride);
+
+	switch (format) {
+		case VertexFormat::Full:
+			std::copy_n(reinterpret_cast<const uint8_t*>(vertices), out.size(), out.data());
+			break;
+		case VertexFormat::Static: {
+			auto dst = reinterpret_cast<StaticVertex*>(out.data());
+			for (size_t i = 0; i < count; i++) {
+				dst[i].position = vertices[i].position;
+				dst[i].texCoord = vertices[i].texCoord;
+				packNormal(vertices[i].normal, dst[i].normal);
+				packTangent(vertices[i].tangent, dst[i].tangent);
+			}
+		} break;
+		case VertexFormat::Quantized: {
+			auto dst = reinterpret_cast<QuantizedVertex*>(out.data());
+			for (size_t i = 0; i < count; i++) packCommon(vertices[i], dst[i], quant);
+		} break;
+		case VertexFormat::QuantizedSkinned: {
+			auto dst = reinterpret_cast<QuantizedSkinnedVertex*>(out.data());
+			for (size_t i = 0; i < count; i++) {
+				packCommon(vertices[i], dst[i], quant);
+				packWeights(vertices[i], dst[i].jointIDs, dst[i].jointWeights);
+			}
+		} break;
+		default: break;
+	}
+	return out;
+}
+
+static float angleBetween(float3 a, float3 b) {
+	if (linalg::length2(a) <= 0.0f) return 0.0f;
+	float d = std::clamp(linalg::dot(linalg::normalize(a), b), -1.0f, 1.0f);
+	return std::acos(d) * 57.29578f;
+}
+
+VertexFormatError measureVertexFormatError(const Vertex* vertices, size_t count, VertexFormat format, const VertexQuantization& quant) {
+	VertexFormatError err{};
+	if (format == VertexFormat::Full || count == 0) return err;
+
+	auto packed = packVertices(vertices, count, format, quant);
+	const size_t stride = vertexFormatInfo(format).stride;
+
+	float3 pmin = vertices[0].position, pmax = pmin;
+	for (size_t i = 1; i < count; i++) {
+		pmin = linalg::min(pmin, vertices[i].position);
+		pmax = linalg::max(pmax, vertices[i].position);
+	}
+	float extent = std::max(linalg::maxelem(pmax - pmin), 1e-6f);
+
+	for (size_t i = 0; i < count; i++) {
+		const Vertex& src = vertices[i];
+		const uint8_t* p = packed.data() + i * stride;
+
+		float3 position;
+		float2 texCoord;
+		float3 normal;
+		float4 tangent;
+		if (format == VertexFormat::Static) {
+			auto v = reinterpret_cast<const StaticVertex*>(p);
+			position = v->position;
+			texCoord = v->texCoord;
+			normal = unpackNormal(v->normal);
+			tangent = unpackTangent(v->tangent);
+		} else {
+			// QuantizedVertex is a prefix of QuantizedSkinnedVertex
+			auto v = reinterpret_cast<const QuantizedVertex*>(p);
+			for (int k = 0; k < 3; k++) position[k] = quant.positionOffset[k] + v->position[k] / 65535.0f * quant.positionScale[k];
+			for (int k = 0; k < 2; k++) texCoord[k] = quant.texCoordOffset[k] + v->texCoord[k] / 65535.0f * quant.texCoordScale[k];
+			normal = unpackNormal(v->normal);
+			tangent = unpackTangent(v->tangent);
+		}
+
+		err.position = std::max(err.position, linalg::maxelem(linalg::abs(position - src.position)) / extent);
+		err.texCoord = std::max(err.texCoord, linalg::maxelem(linalg::abs(texCoord - src.texCoord)));
+		err.normal = std::max(err.normal, angleBetween(src.normal, normal));
+		float tangentError = (src.tangent.w < 0.0f) == (tangent.w < 0.0f) ? angleBetween(src.tangent.xyz(), tangent.xyz()) : 180.0f;
+		err.tangent = std::max(err.tangent, tangentError);
+
+		if (format == VertexFormat::QuantizedSkinned) {
+			auto v = reinterpret_cast<const QuantizedSkinnedVertex*>(p);
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++) {
+				if (src.jointIDs[k] >= 0) sum += std::max(src.jointWeights[k], 0.0f);
+			}
+			for (int k = 0; k < 4; k++) {
+				float expected = src.jointIDs[k] >= 0 && sum > 0.0f ? std::max(src.jointWeights[k], 0.0f) / sum : 0.0f;
+				err.weight = std::max(err.weight, std::abs(v->jointWeights[k] / 255.0f - expected));
+			}
+		}
+	}
+	return err;
+}
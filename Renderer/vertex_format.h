@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+
+struct Vertex;
+
+// GPU-side vertex layouts. Full is the plain Vertex struct, the others are
+// packed at upload time and decoded in the vertex shader (see vertex_input.glsl).
+enum class VertexFormat : uint32_t {
+	Full = 0, // 80 bytes, float everything
+	Static, // 28 bytes, float position/uv, octahedral normal/tangent, no skinning
+	Quantized, // 20 bytes, unorm16 position/uv, octahedral normal/tangent, no skinning
+	QuantizedSkinned, // 28 bytes, Quantized + uint8 joint ids and unorm8 weights
+	Count
+};
+
+constexpr size_t VertexFormatCount = size_t(VertexFormat::Count);
+
+struct StaticVertex {
+	float3 position;
+	int16_t normal[2], tangent[2];
+	float2 texCoord;
+};
+
+struct QuantizedVertex {
+	uint16_t position[4]; // w is padding
+	int16_t normal[2], tangent[2];
+	uint16_t texCoord[2];
+};
+
+struct QuantizedSkinnedVertex {
+	uint16_t position[4];
+	int16_t normal[2], tangent[2];
+	uint16_t texCoord[2];
+	uint8_t jointWeights[4];
+	uint8_t jointIDs[4];
+};
+
+// Per-mesh ranges used to dequantize positions and texture coordinates:
+// value = offset + packed * scale
+struct VertexQuantization {
+	float3 positionOffset{ 0.0f }, positionScale{ 1.0f };
+	float2 texCoordOffset{ 0.0f }, texCoordScale{ 1.0f };
+};
+
+struct VertexFormatInfo {
+	const char* name;
+	size_t stride;
+	BufferLayoutEntry* layout;
+	size_t layoutSize;
+	const char* defines; // shader variant defines, see vertexFormatPrelude
+	bool skinned;
+};
+
+// Maximum decoding error of a packed format over a set of vertices.
+struct VertexFormatError {
+	float position{ 0.0f }; // relative to the mesh extent
+	float normal{ 0.0f }, tangent{ 0.0f }; // in degrees
+	float texCoord{ 0.0f };
+	float weight{ 0.0f };
+};
+
+const VertexFormatInfo& vertexFormatInfo(VertexFormat format);
+
+// Defines followed by the vertex inputs/decoders, to be placed right after #version.
+std::string vertexFormatPrelude(VertexFormat format);
+
+VertexQuantization computeQuantization(const Vertex* vertices, size_t count);
+
+std::vector<uint8_t> packVertices(const Vertex* vertices, size_t count, VertexFormat format, const VertexQuantization& quant);
+
+VertexFormatError measureVertexFormatError(const Vertex* vertices, size_t count, VertexFormat format, const VertexQuantization& quant);
@@ -0,0 +1,74 @@
+R""(
+layout (location = 0) in vec3 vPosition;
+#ifdef VERTEX_OCT_ENCODED
+layout (location = 1) in vec2 vNormal;
+layout (location = 2) in vec2 vTangent;
+#else
+layout (location = 1) in vec3 vNormal;
+layout (location = 2) in vec4 vTangent;
+#endif
+layout (location = 3) in vec2 vTexCoord;
+
+#ifdef VERTEX_SKINNED
+layout (location = 4) in vec4 vWeights;
+#ifdef VERTEX_PACKED_JOINTS
+layout (location = 5) in uvec4 vJointIDs;
+#else
+layout (location = 5) in ivec4 vJointIDs;
+#endif
+#endif
+
+#ifdef VERTEX_QUANTIZED
+uniform vec3 uPositionOffset;
+uniform vec3 uPositionScale;
+uniform vec4 uTexCoordTransform; // offset.xy, scale.zw
+#endif
+
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+vec3 vertexPosition() {
+#ifdef VERTEX_QUANTIZED
+	return uPositionOffset + vPosition * uPositionScale;
+#else
+	return vPosition;
+#endif
+}
+
+vec3 vertexNormal() {
+#ifdef VERTEX_OCT_ENCODED
+	return octDecode(vNormal);
+#else
+	return vNormal;
+#endif
+}
+
+// w is the bitangent sign
+vec4 vertexTangent() {
+#ifdef VERTEX_OCT_ENCODED
+	// y was remapped to [0, 1] and carries the sign
+	vec2 e = vec2(vTangent.x, abs(vTangent.y) * 2.0 - 1.0);
+	return vec4(octDecode(e), vTangent.y < 0.0 ? -1.0 : 1.0);
+#else
+	return vTangent;
+#endif
+}
+
+vec2 vertexTexCoord() {
+#ifdef VERTEX_QUANTIZED
+	return uTexCoordTransform.xy + vTexCoord * uTexCoordTransform.zw;
+#else
+	return vTexCoord;
+#endif
+}
+
+#ifdef VERTEX_SKINNED
+vec4 vertexWeights() { return vWeights; }
+ivec4 vertexJointIDs() { return ivec4(vJointIDs); }
+#endif
+)""
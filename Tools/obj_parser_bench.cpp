@@ -0,0 +1,159 @@
+// Compares parseObj against the character-by-character OBJ reader it replaced.
+// Not part of Renderer.vcxproj; build it next to the renderer sources, e.g.
+//   g++ -std=c++20 -O2 -I../Renderer obj_parser_bench.cpp ../Renderer/obj_parser.cpp ../Renderer/mapped_file.cpp
+// and run it with one or more .obj files.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "obj_parser.h"
+#include "mapped_file.h"
+
+using Filter = std::function<bool(char)>;
+
+static bool whiteSpace(char c) { return !::isspace(c); }
+static bool newLine(char c) { return c != '\n'; }
+static bool digit(char c) { return ::isdigit(c); }
+
+// The reader Mesh::load used before, with its output in an ObjData.
+static bool parseObjLegacy(const std::string& fileName, ObjData& out) {
+	std::ifstream fp{ fileName };
+	if (!fp.good()) return false;
+
+	auto readChar = [&]() {
+		char c = '\0';
+		fp.get(c);
+		return c;
+	};
+
+	auto readString = [&](const Filter& filter = whiteSpace) {
+		std::string ret = "";
+		while (!fp.eof() && filter(fp.peek())) {
+			ret += readChar();
+		}
+		return ret;
+	};
+
+	auto readFloat = [&](const Filter& filter = whiteSpace) {
+		return std::stof(readString(filter));
+	};
+
+	auto readInt = [&](const Filter& filter = whiteSpace) {
+		return std::stoi(readString(filter));
+	};
+
+	auto readIndices = [&]() {
+		int3 vtn{ -1, -1, -1 };
+		vtn[0] = readInt(digit) - 1;
+		readChar();
+		if (fp.peek() == '/') {
+			vtn[1] = -1;
+		} else {
+			vtn[1] = readInt(digit) - 1;
+		}
+
+		if (fp.peek() == '/') {
+			readChar();
+			vtn[2] = readInt(digit) - 1;
+		}
+		readChar();
+		return vtn;
+	};
+
+	while (!fp.eof()) {
+		char c = readChar();
+		if (c == '#' || c == 's' || c == 'o') {
+			readString(newLine); readChar();
+		} else if (c == 'v') {
+			char sub = readChar();
+			if (!::isspace(sub))
+				readChar();
+			if (sub == 't') {
+				float s = readFloat(); readChar();
+				float t = readFloat(); readChar();
+				out.texCoords.push_back(float2{ s, t });
+			} else if (sub == 'n') {
+				float x = readFloat(); readChar();
+				float y = readFloat(); readChar();
+				float z = readFloat(); readChar();
+				out.normals.push_back(float3{ x, y, z });
+			} else {
+				float x = readFloat(); readChar();
+				float y = readFloat(); readChar();
+				float z = readFloat(); readChar();
+				out.positions.push_back(float3{ x, y, z });
+			}
+		} else if (c == 'f') {
+			readChar();
+			out.faces.push_back(readIndices());
+			out.faces.push_back(readIndices());
+			out.faces.push_back(readIndices());
+		} else {
+			readChar();
+		}
+	}
+	return true;
+}
+
+template <typename F>
+static double bestOf(int runs, F&& f) {
+	double best = 1e30;
+	for (int i = 0; i < runs; i++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		f();
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+static bool sameData(const ObjData& a, const ObjData& b) {
+	return a.positions == b.positions && a.normals == b.normals
+		&& a.texCoords == b.texCoords && a.faces == b.faces;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " <file.obj>...\n";
+		return 1;
+	}
+
+	const int runs = 5;
+	bool ok = true;
+	for (int i = 1; i < argc; i++) {
+		std::string fileName = argv[i];
+		MappedFile file;
+		if (!file.open(fileName)) {
+			std::cerr << fileName << ": cannot open\n";
+			ok = false;
+			continue;
+		}
+		double megabytes = double(file.size()) / (1024.0 * 1024.0);
+
+		ObjData legacy, single, threaded;
+		double legacyMs = bestOf(runs, [&] { legacy = {}; parseObjLegacy(fileName, legacy); });
+		double singleMs = bestOf(runs, [&] { single = {}; parseObj(file.data(), file.size(), single, 1); });
+		double threadedMs = bestOf(runs, [&] { threaded = {}; parseObj(file.data(), file.size(), threaded); });
+
+		std::cout << fileName << " (" << megabytes << " MB, " << single.faces.size() / 3 << " triangles)\n";
+		std::cout << "  legacy:   " << legacyMs << " ms (" << megabytes / legacyMs * 1000.0 << " MB/s)\n";
+		std::cout << "  1 thread: " << singleMs << " ms (" << megabytes / singleMs * 1000.0 << " MB/s)\n";
+		std::cout << "  threaded: " << threadedMs << " ms (" << megabytes / threadedMs * 1000.0 << " MB/s)\n";
+
+		if (!sameData(single, threaded)) {
+			std::cout << "  MISMATCH between 1 thread and threaded output\n";
+			ok = false;
+		}
+		// the legacy reader only knows triangles, so only compare when it read the same faces
+		if (legacy.faces.size() == single.faces.size() && !sameData(legacy, single)) {
+			std::cout << "  MISMATCH against the legacy reader\n";
+			ok = false;
+		}
+	}
+	return ok ? 0 : 1;
+}